@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// 任务参数是执行它的工作线程序号，任务可以用它来索引每个线程私有的资源（命令池、管线缓存等）
+typedef std::function<void(uint32_t workerIndex)> LittleTask;
+
+// 固定线程数的任务池。任务按提交顺序被空闲的线程取走执行
+class LittleThreadPool
+{
+public:
+    // threadCount为0时使用 硬件线程数 - 1，把一个核留给主线程
+    bool Initialize(uint32_t threadCount = 0);
+    bool Destroy();
+
+    void Submit(LittleTask task);
+    // 阻塞直到所有已提交的任务都执行完毕
+    void WaitIdle();
+    uint32_t GetThreadCount() const { return (uint32_t)threads.size(); }
+
+protected:
+    std::vector<std::thread> threads;
+    std::deque<LittleTask> tasks;
+    std::mutex taskMutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable allDone;
+    // 排队中和正在执行的任务总数
+    uint32_t pendingCount = 0;
+    bool stopping = false;
+
+protected:
+    void workerMain(uint32_t workerIndex);
+};
\ No newline at end of file
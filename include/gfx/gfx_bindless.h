@@ -0,0 +1,86 @@
+#pragma once
+#include "gfx/volk.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+
+class LittleGFXDevice;
+
+// 无绑定描述符堆在管线布局中占用的集合编号。放在0号集合，切换管线时它总能保持绑定
+#define LITTLE_GFX_BINDLESS_SET 0
+// 各个数组期望的容量，实际容量还会被设备的update-after-bind上限截断
+#define LITTLE_GFX_BINDLESS_SAMPLED_IMAGES 65536
+#define LITTLE_GFX_BINDLESS_STORAGE_BUFFERS 65536
+#define LITTLE_GFX_BINDLESS_SAMPLERS 2048
+#define LITTLE_GFX_BINDLESS_INVALID_INDEX UINT32_MAX
+
+// 每种资源对应堆里的一个绑定，枚举值就是binding编号：
+// layout(set = 0, binding = 0) uniform texture2D textures[];
+// layout(set = 0, binding = 1) buffer Buffers { ... } buffers[];
+// layout(set = 0, binding = 2) uniform sampler samplers[];
+enum class LittleGFXBindlessType
+{
+    SampledImage,
+    StorageBuffer,
+    Sampler,
+    Count
+};
+
+// 全局的无绑定描述符堆。所有纹理、存储缓冲和采样器都写进同一个描述符集的大数组里，
+// 着色器用整数下标访问它们，每帧只需要绑定一次这个集合，材质切换不再需要分配和更新描述符集。
+// 集合使用UPDATE_AFTER_BIND，绑定之后仍然可以写入新的槽位；释放的槽位要等到引用它的帧执行完毕才会被复用
+class LittleGFXBindlessHeap
+{
+    friend class LittleGFXDevice;
+
+public:
+    // 返回资源在对应数组里的下标，数组已满时返回LITTLE_GFX_BINDLESS_INVALID_INDEX
+    uint32_t AddSampledImage(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    uint32_t AddSampler(VkSampler sampler);
+    // 槽位在这一帧提交的命令执行完毕之后才会被回收，这一帧内仍然可以使用它
+    void Remove(LittleGFXBindlessType type, uint32_t index);
+    // 设备不支持描述符索引时为false，此时所有接口都不可用
+    bool IsEnabled() const { return descriptorSet != VK_NULL_HANDLE; }
+    VkDescriptorSetLayout GetSetLayout() const { return setLayout; }
+    VkDescriptorSet GetDescriptorSet() const { return descriptorSet; }
+    // 把堆绑定到LITTLE_GFX_BINDLESS_SET上，layout必须包含这个集合（由着色器缓存生成的布局会自动包含）
+    void Bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout) const;
+    uint32_t GetCapacity(LittleGFXBindlessType type) const { return slots[(uint32_t)type].capacity; }
+    uint32_t GetUsedCount(LittleGFXBindlessType type);
+
+protected:
+    // 一个数组的槽位分配器：先用空闲链表，再向后推进水位线
+    struct SlotAllocator {
+        uint32_t capacity = 0;
+        uint32_t highWater = 0;
+        std::vector<uint32_t> freeSlots;
+        uint32_t usedCount = 0;
+    };
+    struct RetiredSlot {
+        LittleGFXBindlessType type;
+        uint32_t index;
+        // graphics queue时间线到达这个值之后槽位可以复用
+        uint64_t timelineValue;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    // 多个线程同时写同一个描述符集需要外部同步
+    std::mutex heapMutex;
+    SlotAllocator slots[(uint32_t)LittleGFXBindlessType::Count];
+    // 这一帧内释放的槽位，endFrame时打上这一帧的时间线值
+    std::vector<RetiredSlot> pendingSlots;
+    std::deque<RetiredSlot> retiredSlots;
+
+protected:
+    bool initialize(LittleGFXDevice* device);
+    void destroy();
+    // 回收时间线已经完成的槽位
+    void beginFrame();
+    void endFrame(uint64_t timelineValue);
+    uint32_t allocateSlot(LittleGFXBindlessType type);
+    void write(LittleGFXBindlessType type, uint32_t index, const VkDescriptorImageInfo* imageInfo,
+        const VkDescriptorBufferInfo* bufferInfo);
+};
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include "gfx/volk.h"
+#include <vector>
+#include <atomic>
+
+class LittleGFXDevice;
+class LittleGFXQueue;
+
+// 初始预留的录制线程槽位数，更大的线程池用ReserveThreads扩充。主线程（渲染线程）使用0，线程池的工作线程使用workerIndex + 1
+#define LITTLE_GFX_COMMAND_RESERVED_THREADS 64
+#define LITTLE_GFX_COMMAND_MAIN_THREAD 0
+
+// 每线程、每帧的命令缓冲分配器。VkCommandPool需要外部同步，所以每个录制线程在每个帧分区里
+// 都有自己的TRANSIENT命令池，多个线程同时录制时互不加锁。分配出的命令缓冲只在当前帧内有效，
+// 从不单独释放：分区在它最后一次被使用的帧执行完毕之后用vkResetCommandPool整体重置，
+// 命令缓冲留在池里下一次直接复用
+class LittleGFXCommandAllocator
+{
+    friend class LittleGFXDevice;
+
+public:
+    // 分配一个主命令缓冲并以ONE_TIME_SUBMIT开始录制，调用者负责vkEndCommandBuffer和提交。
+    // 同一个threadIndex同一时刻只能被一个线程使用
+    VkCommandBuffer AllocatePrimary(uint32_t threadIndex, LittleGFXQueue* queue);
+    // 分配一个次级命令缓冲并按inheritance开始录制，在渲染通道内录制时flags要带上RENDER_PASS_CONTINUE
+    VkCommandBuffer AllocateSecondary(uint32_t threadIndex, LittleGFXQueue* queue,
+        const VkCommandBufferInheritanceInfo& inheritance,
+        VkCommandBufferUsageFlags flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    // 保证threadIndex小于threadCount的线程都有槽位。只能在没有线程录制时调用，比如设置线程池的时候
+    void ReserveThreads(uint32_t threadCount);
+    // 当前创建的命令池总数
+    uint32_t GetPoolCount() const { return poolCount.load(std::memory_order_relaxed); }
+
+protected:
+    // 一个线程在一个分区里对某个队列族使用的命令池，命令缓冲按需追加
+    struct FamilyPool {
+        uint32_t familyIndex = UINT32_MAX;
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> commandBuffers[2];
+        uint32_t usedCount[2] = { 0, 0 };
+    };
+    struct Partition {
+        // 下标是线程序号，每个线程只访问自己的那一项，所以不需要加锁
+        std::vector<std::vector<FamilyPool>> threads;
+        // 最后一次使用这个分区的帧在graphics queue时间线上的值
+        uint64_t timelineValue = 0;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::vector<Partition> partitions;
+    // 只在beginFrame里推进，那时不应该有线程在录制
+    uint32_t currentPartition = 0;
+    std::atomic<uint32_t> poolCount{ 0 };
+
+protected:
+    // 分区数和描述符分配器一样等于设备的framesInFlight
+    bool initialize(LittleGFXDevice* device, uint32_t partitionCount);
+    void destroy();
+    // 切换到下一个分区，必要时等待它上一次的使用完成，然后重置它的所有池
+    void beginFrame();
+    void endFrame(uint64_t timelineValue);
+    // 从threadIndex在当前分区里的池中取一个level级别的命令缓冲，池不存在时创建
+    VkCommandBuffer acquire(uint32_t threadIndex, LittleGFXQueue* queue, VkCommandBufferLevel level);
+};
\ No newline at end of file
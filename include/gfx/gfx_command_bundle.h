@@ -0,0 +1,102 @@
+#pragma once
+#include "gfx/volk.h"
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+class LittleGFXDevice;
+
+// 连续这么多帧没有被执行过的bundle会被回收，输入变化之后旧键对应的bundle靠它释放
+#define LITTLE_GFX_BUNDLE_EVICT_FRAMES 120
+
+// bundle依赖的输入组成的键。录制函数里用到的、可能变化的东西都要放进来，
+// 任何一项变化都会得到一个新键，从而重新录制
+class LittleGFXBundleKey
+{
+public:
+    LittleGFXBundleKey& Pipeline(VkPipeline pipeline);
+    LittleGFXBundleKey& Viewport(const VkViewport& viewport, const VkRect2D& scissor);
+    // 通过推送常量传给着色器的无绑定堆下标
+    LittleGFXBundleKey& Bindless(const uint32_t* indices, uint32_t count);
+    // 其他的输入，比如顶点缓冲的句柄和内容的版本号
+    LittleGFXBundleKey& Value(const void* data, size_t size);
+    template<typename T>
+    LittleGFXBundleKey& Value(const T& value)
+    {
+        return Value((const void*)&value, sizeof(T));
+    }
+    const std::string& GetBytes() const { return bytes; }
+
+protected:
+    std::string bytes;
+};
+
+// 录制bundle内容的函数。只能引用跨帧持久存在的对象，不能使用环形分配器和每帧的描述符集
+typedef std::function<void(VkCommandBuffer cmd)> LittleGFXBundleRecordFunc;
+
+struct LittleGFXBundleStats {
+    // 当前帧直接复用的次数和重新录制的次数
+    uint32_t hitCount = 0;
+    uint32_t recordCount = 0;
+    // 当前缓存的bundle总数
+    uint32_t bundleCount = 0;
+};
+
+// 静态内容（不变的场景几何、界面框架等）的次级命令缓冲缓存。每帧都录制相同命令的内容只录制一次，
+// 按它依赖的输入作为键缓存下来，之后每帧用vkCmdExecuteCommands重放，直到键变化或者被显式失效。
+// bundle以SIMULTANEOUS_USE录制，可以同时出现在多个在途的帧里；被替换的bundle要等到最后一次使用它的帧
+// 执行完毕才会释放
+class LittleGFXCommandBundleCache
+{
+    friend class LittleGFXDevice;
+
+public:
+    // 取键对应的bundle，没有时调用record录制一个，失败时返回VK_NULL_HANDLE。
+    // inheritance描述bundle在哪里执行，其中的渲染通道、子通道和帧缓冲会被自动加进键里，pNext里的内容
+    // （比如动态渲染的附件格式）需要调用者自己加进key；在渲染通道内执行时flags要带上RENDER_PASS_CONTINUE。
+    // 录制在缓存的锁里进行，录制函数不能再访问这个缓存
+    VkCommandBuffer Get(const LittleGFXBundleKey& key, const VkCommandBufferInheritanceInfo& inheritance,
+        const LittleGFXBundleRecordFunc& record, VkCommandBufferUsageFlags flags = 0);
+    // Get之后在cmd里执行它。在渲染通道内执行时，通道要以SECONDARY_COMMAND_BUFFERS的内容方式开始
+    bool Execute(VkCommandBuffer cmd, const LittleGFXBundleKey& key, const VkCommandBufferInheritanceInfo& inheritance,
+        const LittleGFXBundleRecordFunc& record, VkCommandBufferUsageFlags flags = 0);
+    // 内容依赖的东西变了但键里体现不出来时（比如缓冲里的数据被原地更新）手动失效，下次使用时重新录制
+    void Invalidate(const LittleGFXBundleKey& key);
+    // 比如交换链重建、管线热重载之后
+    void InvalidateAll();
+    const LittleGFXBundleStats& GetStats() const { return stats; }
+
+protected:
+    struct Bundle {
+        // 调用者给的键，Invalidate按它查找
+        std::string key;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        // 最后一次使用它的帧，以及那一帧在graphics queue时间线上的值，那一帧还没有提交时为UINT64_MAX
+        uint64_t lastUsedFrame = 0;
+        uint64_t lastUsedValue = 0;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    // 录制和释放都要求命令池外部同步
+    std::mutex bundleMutex;
+    // bundle要跨帧存在，所以不用每帧重置的命令分配器，而是自己的命令池，单独释放
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    // 以调用者的键加上继承信息组成的字节串为键
+    std::unordered_map<std::string, std::unique_ptr<Bundle>> bundles;
+    // 这一帧用过的bundle，endFrame时打上这一帧的时间线值
+    std::vector<Bundle*> frameBundles;
+    // 被替换或回收、等待最后一次使用它的帧执行完毕的bundle
+    std::vector<std::unique_ptr<Bundle>> retiredBundles;
+    uint64_t frameIndex = 0;
+    LittleGFXBundleStats stats;
+
+protected:
+    bool initialize(LittleGFXDevice* device);
+    void destroy();
+    // 释放已经执行完的退役bundle，回收长时间没有使用的bundle
+    void beginFrame();
+    void endFrame(uint64_t timelineValue);
+    void retire(std::unique_ptr<Bundle> bundle);
+};
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+#include "gfx/gfx_memory.h"
+#include <functional>
+
+// 默认每帧最多搬运的字节数，传输队列上的拷贝因此不会明显挤占带宽
+#define LITTLE_GFX_DEFRAG_FRAME_BUDGET (8ull * 1024 * 1024)
+
+// 资源被搬运之后调用。拥有者需要把自己持有的句柄和分配换成新的，并重写引用它的描述符
+// 旧的句柄由碎片整理器在GPU不再使用之后销毁，拥有者不要再去销毁它
+// 回调在渲染线程上、录制这一帧之前执行，并且处于碎片整理器的锁内，不能在回调里取消登记
+typedef std::function<void(VkBuffer newBuffer, VkImage newImage, const LittleGFXAllocation& newAllocation)> LittleGFXMovePatchCallback;
+
+typedef uint32_t LittleGFXMovableHandle;
+#define LITTLE_GFX_INVALID_MOVABLE_HANDLE UINT32_MAX
+
+struct LittleGFXDefragStats {
+    // 累计搬运的资源数和字节数
+    uint64_t movedCount = 0;
+    uint64_t movedBytes = 0;
+    // 累计还给驱动的VkDeviceMemory块数
+    uint64_t freedBlocks = 0;
+};
+
+// 增量碎片整理。每帧在字节预算内，把占用率最低的块里登记过的资源搬到更满的块里，
+// 拷贝在传输队列上执行（带队列族所有权转移），搬完之后通过回调修补拥有者的句柄，
+// 块被搬空之后就把它的VkDeviceMemory还给驱动。只有只读的资源（纹理、静态网格）适合登记
+class LittleGFXDefragmenter
+{
+    friend class LittleGFXDevice;
+
+public:
+    // 资源必须是EXCLUSIVE共享模式，并且带有TRANSFER_SRC和TRANSFER_DST用途
+    // 资源会按照createInfo重新创建，所以其中的pNext链不会被保留
+    LittleGFXMovableHandle RegisterBuffer(VkBuffer buffer, const VkBufferCreateInfo& createInfo,
+        const LittleGFXAllocation& allocation, LittleGFXMovePatchCallback patch);
+    // layout是图像在两帧之间所处的布局，搬运之后新图像也会处于这个布局，不能是UNDEFINED或PREINITIALIZED
+    LittleGFXMovableHandle RegisterImage(VkImage image, const VkImageCreateInfo& createInfo, VkImageLayout layout,
+        const LittleGFXAllocation& allocation, LittleGFXMovePatchCallback patch);
+    // 拥有者销毁资源之前必须先取消登记
+    void Unregister(LittleGFXMovableHandle handle);
+    // 0表示暂停碎片整理
+    void SetFrameBudget(VkDeviceSize bytes) { frameBudget = bytes; }
+    const LittleGFXDefragStats& GetStats() const { return stats; }
+
+protected:
+    struct Entry {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImage image = VK_NULL_HANDLE;
+        VkBufferCreateInfo bufferInfo = {};
+        VkImageCreateInfo imageInfo = {};
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        LittleGFXAllocation allocation;
+        LittleGFXMovePatchCallback patch;
+        bool alive = false;
+    };
+    // 一次搬运。旧资源在graphicsValue完成之后销毁
+    struct Move {
+        LittleGFXMovableHandle handle;
+        VkBuffer oldBuffer = VK_NULL_HANDLE;
+        VkImage oldImage = VK_NULL_HANDLE;
+        LittleGFXAllocation oldAllocation;
+        VkBuffer newBuffer = VK_NULL_HANDLE;
+        VkImage newImage = VK_NULL_HANDLE;
+        LittleGFXAllocation newAllocation;
+        uint64_t graphicsValue = 0;
+    };
+    enum class BarrierPhase
+    {
+        // graphics queue把旧资源的所有权交给传输队列
+        SourceRelease,
+        // 传输队列获取旧资源，同时把新图像转换到TRANSFER_DST
+        SourceAcquire,
+        // 传输队列把新资源交还给graphics queue
+        DestinationRelease,
+        DestinationAcquire,
+        // 没有专用传输队列时，拷贝前后的普通屏障
+        LocalPreCopy,
+        LocalPostCopy
+    };
+    // 和上传服务一样，graphics那边完成之后命令池就可以复用
+    struct Submission {
+        VkCommandPool graphicsPool = VK_NULL_HANDLE;
+        VkCommandBuffer releaseCommands = VK_NULL_HANDLE;
+        VkCommandBuffer acquireCommands = VK_NULL_HANDLE;
+        VkCommandPool transferPool = VK_NULL_HANDLE;
+        VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+        uint64_t graphicsValue = 0;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::mutex defragMutex;
+    std::vector<Entry> entries;
+    std::vector<LittleGFXMovableHandle> freeHandles;
+    // 这一帧正在录制的搬运，以及已经提交、等待销毁旧资源的搬运
+    std::vector<Move> frameMoves;
+    std::vector<Move> inflightMoves;
+    std::vector<Submission> submissions;
+    VkDeviceSize frameBudget = LITTLE_GFX_DEFRAG_FRAME_BUDGET;
+    LittleGFXDefragStats stats;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    std::vector<VkImageCopy> imageCopies;
+
+protected:
+    bool initialize(LittleGFXDevice* device);
+    void destroy();
+    // 由设备在每帧开始时调用：回收完成的搬运，再在预算内开始新的搬运
+    void update();
+    void collectMoves(bool waitAll);
+    // 挑出占用率最低、并且里面的分配全部可以搬运的块
+    bool selectSourceBlock(uint32_t& outPool, uint32_t& outBlock);
+    bool createMove(LittleGFXMovableHandle handle, uint32_t sourceBlock, Move& outMove);
+    void recordCopies(VkCommandBuffer cmd);
+    void recordBarriers(VkCommandBuffer cmd, BarrierPhase phase);
+    Submission& acquireSubmission();
+    LittleGFXMovableHandle registerEntry(Entry& entry);
+};
\ No newline at end of file
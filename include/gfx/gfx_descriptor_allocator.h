@@ -0,0 +1,55 @@
+#pragma once
+#include "gfx/volk.h"
+#include <vector>
+#include <mutex>
+
+class LittleGFXDevice;
+
+// 每个描述符池最多分配的描述符集数量，各类描述符的容量按这个数乘以下面的比例
+#define LITTLE_GFX_DESCRIPTOR_POOL_SETS 256
+
+// 每帧重置的描述符集分配器。描述符集从按帧分区的描述符池中分配，分配出的集合只在当前帧内有效，
+// 从不单独释放：分区在它最后一次被使用的帧执行完毕之后用vkResetDescriptorPool整体重置。
+// 池用完时换到下一个池，池不够时创建新的，重置后的池回到空闲链表里给所有分区复用
+class LittleGFXDescriptorAllocator
+{
+    friend class LittleGFXDevice;
+
+public:
+    // 分配一个只在当前帧内有效的描述符集，失败时返回VK_NULL_HANDLE
+    VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+    // 一次分配多个描述符集，比逐个分配少很多次驱动调用
+    bool Allocate(const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* outSets);
+    // 当前创建的描述符池总数
+    uint32_t GetPoolCount();
+    // 当前帧已经分配的描述符集数量
+    uint32_t GetFrameSetCount() const { return frameSetCount; }
+
+protected:
+    struct Partition {
+        // 这个分区正在使用的池，最后一个是当前的池
+        std::vector<VkDescriptorPool> pools;
+        // 最后一次使用这个分区的帧在graphics queue时间线上的值
+        uint64_t timelineValue = 0;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::mutex allocatorMutex;
+    std::vector<Partition> partitions;
+    // 已经重置、可以被任何分区取用的池
+    std::vector<VkDescriptorPool> freePools;
+    uint32_t currentPartition = 0;
+    uint32_t poolCount = 0;
+    uint32_t frameSetCount = 0;
+    // 没有启用VK_KHR_acceleration_structure时池里不能出现这个扩展的描述符类型
+    bool accelerationStructureEnabled = false;
+
+protected:
+    // 分区数和环形分配器一样等于设备的framesInFlight
+    bool initialize(LittleGFXDevice* device, uint32_t partitionCount);
+    void destroy();
+    // 切换到下一个分区，必要时等待它上一次的使用完成，然后重置它的所有池
+    void beginFrame();
+    void endFrame(uint64_t timelineValue);
+    // 给当前分区换上一个新池，优先从空闲链表里取
+    VkDescriptorPool acquirePool();
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+#include "os/configure.h"
+#include "gfx/volk.h"
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <string>
+
+class LittleGFXDevice;
+struct LittleGFXPipelineLayout;
+
+// 一个描述符集布局对应的更新模板。模板读取的数据是按binding从小到大紧密排列的记录：
+// 图像和采样器类的描述符每个元素一个VkDescriptorImageInfo，缓冲类一个VkDescriptorBufferInfo，
+// 纹素缓冲一个VkBufferView，加速结构一个VkAccelerationStructureKHR，数组绑定连续排列它的所有元素。比如：
+// struct MaterialDescriptors {
+//     VkDescriptorBufferInfo constants;   // binding 0, uniform buffer
+//     VkDescriptorImageInfo albedo;       // binding 1, combined image sampler
+//     VkDescriptorImageInfo normal;       // binding 2, combined image sampler
+// };
+struct LittleGFXDescriptorTemplate {
+    // 没有任何绑定的集合（比如布局里用来占位的空集合）不能创建模板，此时为空，写入什么也不做
+    VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    // 模板读取的数据的总字节数
+    uint32_t dataSize = 0;
+    // 每个binding的记录在数据里的偏移，下标是binding编号，没有这个binding时为UINT32_MAX
+    std::vector<uint32_t> bindingOffsets;
+};
+
+// 用描述符更新模板写描述符集。一个集合只需要一次vkUpdateDescriptorSetWithTemplate调用，
+// 驱动直接从打包好的结构体里读取描述符，不需要每次绘制都组装VkWriteDescriptorSet数组
+class LittleGFXDescriptorWriter
+{
+    friend class LittleGFXDevice;
+
+public:
+    // 由反射出的管线布局的第set个集合生成模板，同一个集合布局只生成一次
+    const LittleGFXDescriptorTemplate* GetTemplate(const LittleGFXPipelineLayout* layout, uint32_t set);
+    const LittleGFXDescriptorTemplate* GetTemplate(VkDescriptorSetLayout setLayout,
+        const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+    void Write(VkDescriptorSet descriptorSet, const LittleGFXDescriptorTemplate* descriptorTemplate, const void* data);
+    template<typename T>
+    void Write(VkDescriptorSet descriptorSet, const LittleGFXDescriptorTemplate* descriptorTemplate, const T& data)
+    {
+        assert(sizeof(T) >= descriptorTemplate->dataSize && "descriptor data struct is smaller than the template!");
+        Write(descriptorSet, descriptorTemplate, (const void*)&data);
+    }
+    // 从每帧的描述符分配器里分配一个集合并写入，返回的集合只在当前帧内有效
+    VkDescriptorSet AllocateAndWrite(const LittleGFXDescriptorTemplate* descriptorTemplate, const void* data);
+    template<typename T>
+    VkDescriptorSet AllocateAndWrite(const LittleGFXDescriptorTemplate* descriptorTemplate, const T& data)
+    {
+        assert(sizeof(T) >= descriptorTemplate->dataSize && "descriptor data struct is smaller than the template!");
+        return AllocateAndWrite(descriptorTemplate, (const void*)&data);
+    }
+
+    // 把第set个集合的描述符直接录制进命令缓冲。布局的这个集合是push descriptor集合时不分配任何描述符集，
+    // 否则（设备不支持VK_KHR_push_descriptor等）退回到从每帧的分配器分配、写入再绑定，数据的格式两者相同
+    void Push(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, const LittleGFXPipelineLayout* layout, uint32_t set,
+        const void* data);
+    template<typename T>
+    void Push(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, const LittleGFXPipelineLayout* layout, uint32_t set,
+        const T& data)
+    {
+        Push(cmd, bindPoint, layout, set, (const void*)&data);
+    }
+
+protected:
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::mutex templateMutex;
+    std::unordered_map<VkDescriptorSetLayout, std::unique_ptr<LittleGFXDescriptorTemplate>> templates;
+    // push descriptor的模板绑定了管线布局、集合编号和绑定点，以这三者组成的字节串为键
+    std::unordered_map<std::string, std::unique_ptr<LittleGFXDescriptorTemplate>> pushTemplates;
+
+protected:
+    bool initialize(LittleGFXDevice* device);
+    void destroy();
+    const LittleGFXDescriptorTemplate* getPushTemplate(VkPipelineBindPoint bindPoint, const LittleGFXPipelineLayout* layout,
+        uint32_t set);
+    // 按binding顺序填写模板条目，返回数据的总字节数
+    static uint32_t buildEntries(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+        std::vector<VkDescriptorUpdateTemplateEntry>& outEntries, std::vector<uint32_t>& outBindingOffsets);
+};
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+#include "gfx/volk.h"
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+
+class LittleGFXDevice;
+
+// 伙伴算法的最小分配粒度
+#define LITTLE_GFX_MIN_ALLOCATION_SIZE 256
+// 默认的块大小，小显存的堆上会相应缩小
+#define LITTLE_GFX_DEFAULT_BLOCK_SIZE (64ull * 1024 * 1024)
+
+// 一次子分配的结果。资源绑定到memory的offset处
+struct LittleGFXAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    // 调用方请求的大小
+    VkDeviceSize size = 0;
+    // 内存是HOST_VISIBLE时，这是持久映射后对应offset处的地址。
+    // 内存不是HOST_COHERENT时，CPU写入之后要Flush，GPU写入之后CPU读取之前要Invalidate
+    void* mappedData = nullptr;
+    uint32_t memoryTypeIndex = 0;
+    // 以下字段由分配器内部使用
+    uint32_t poolIndex = 0;
+    uint32_t blockIndex = 0;
+    uint32_t order = 0;
+    bool dedicated = false;
+};
+
+struct LittleGFXMemoryStats {
+    // 向驱动申请的VkDeviceMemory总量
+    VkDeviceSize committedBytes = 0;
+    // 调用方实际请求的大小之和
+    VkDeviceSize usedBytes = 0;
+    // 按伙伴算法取整之后占掉的大小之和，和usedBytes的差就是内部碎片
+    VkDeviceSize allocatedBytes = 0;
+    // 所有块中空闲的总量，以及其中最大的一段连续空闲
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFreeRange = 0;
+    // 外部碎片：1 - 最大连续空闲/空闲总量，0表示空闲空间全部连续
+    float fragmentation = 0.f;
+    uint32_t blockCount = 0;
+    uint32_t dedicatedCount = 0;
+    // 还没有释放的独占分配，设备销毁时一起还给驱动
+    std::unordered_set<VkDeviceMemory> dedicatedMemories;
+    uint32_t allocationCount = 0;
+    // 按堆统计的committed和used，可以和预算对照
+    VkDeviceSize heapCommittedBytes[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize heapUsedBytes[VK_MAX_MEMORY_HEAPS] = {};
+};
+
+// 设备级的显存分配器。每种内存类型按大块向驱动申请VkDeviceMemory，再用伙伴算法切成子分配，
+// 这样VkDeviceMemory的数量不会触碰maxMemoryAllocationCount，分配和释放也只是CPU上的几次集合操作。
+// 线性资源（缓冲、LINEAR图像）和OPTIMAL图像放在不同的块里，因此永远不需要考虑bufferImageGranularity
+class LittleGFXMemoryAllocator
+{
+    friend class LittleGFXDevice;
+    friend class LittleGFXDefragmenter;
+
+public:
+    // required是必须满足的内存属性，preferred是尽量满足的内存属性
+    // linear表示资源是缓冲或者LINEAR图像
+    bool Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred, bool linear, LittleGFXAllocation& outAllocation);
+    void Free(LittleGFXAllocation& allocation);
+    // 让CPU通过mappedData写入的[offset, offset + size)对GPU可见，以及让GPU的写入对CPU可见。
+    // 偏移都相对于分配本身，HOST_COHERENT的内存上什么都不做
+    void Flush(const LittleGFXAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+    void Invalidate(const LittleGFXAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+    // 创建资源、分配内存并完成绑定
+    bool CreateBuffer(const VkBufferCreateInfo& bufferInfo, VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred, VkBuffer& outBuffer, LittleGFXAllocation& outAllocation);
+    bool CreateImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred, VkImage& outImage, LittleGFXAllocation& outAllocation);
+    void DestroyBuffer(VkBuffer buffer, LittleGFXAllocation& allocation);
+    void DestroyImage(VkImage image, LittleGFXAllocation& allocation);
+
+    LittleGFXMemoryStats GetStats();
+    uint32_t GetMemoryTypeHeap(uint32_t memoryTypeIndex) const;
+
+protected:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mappedData = nullptr;
+        VkDeviceSize size = 0;
+        VkDeviceSize allocatedBytes = 0;
+        uint32_t allocationCount = 0;
+        // freeLists[k]里存放大小为 minBlockSize << k 的空闲块的偏移
+        std::vector<std::unordered_set<VkDeviceSize>> freeLists;
+    };
+    struct Pool {
+        uint32_t memoryTypeIndex = 0;
+        VkDeviceSize blockSize = 0;
+        uint32_t maxOrder = 0;
+        // 为了让LittleGFXAllocation里的blockIndex保持有效，释放掉的块只置空不删除
+        std::vector<Block> blocks;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::mutex allocatorMutex;
+    // 每种内存类型两个池子：下标 type * 2 + (linear ? 1 : 0)
+    Pool pools[VK_MAX_MEMORY_TYPES * 2];
+    VkDeviceSize dedicatedBytes[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize dedicatedUsedBytes[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize usedBytes[VK_MAX_MEMORY_HEAPS] = {};
+    uint32_t dedicatedCount = 0;
+
+protected:
+    bool initialize(LittleGFXDevice* device);
+    void destroy();
+    bool selectMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, uint32_t& outTypeIndex) const;
+    // dedicatedBuffer/dedicatedImage不为空时表示驱动希望这个资源独占一块VkDeviceMemory
+    bool allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+        bool linear, VkBuffer dedicatedBuffer, VkImage dedicatedImage, LittleGFXAllocation& outAllocation);
+    bool allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex,
+        VkBuffer dedicatedBuffer, VkImage dedicatedImage, LittleGFXAllocation& outAllocation);
+    // excludeBlock不为UINT32_MAX时是碎片整理的搬运：只在其他已有的块里分配，并且优先选最满的块
+    bool allocateFromPool(Pool& pool, VkDeviceSize size, VkDeviceSize alignment,
+        LittleGFXAllocation& outAllocation, uint32_t excludeBlock = UINT32_MAX);
+    bool allocateForMove(uint32_t poolIndex, VkDeviceSize size, VkDeviceSize alignment,
+        uint32_t excludeBlock, LittleGFXAllocation& outAllocation);
+    // 把所有已经空了的块还给驱动，返回释放的块数
+    uint32_t trimEmptyBlocks();
+    bool createBlock(Pool& pool, uint32_t& outBlockIndex);
+    void destroyBlock(Block& block);
+    void* mapMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex);
+    // 把范围扩展到nonCoherentAtomSize的整数倍之后Flush或Invalidate
+    void syncMappedRange(const LittleGFXAllocation& allocation, VkDeviceSize offset, VkDeviceSize size, bool flush);
+};
\ No newline at end of file
@@ -1,27 +1,66 @@
 #pragma once
 #include "os/window.h"
 #include "gfx/volk.h"
+#include "gfx/gfx_memory.h"
+#include "gfx/gfx_ring_allocator.h"
+#include "gfx/gfx_upload.h"
+#include "gfx/gfx_residency.h"
+#include "gfx/gfx_defrag.h"
+#include "gfx/gfx_pipeline_cache.h"
+#include "gfx/gfx_pipeline_compiler.h"
+#include "gfx/gfx_shader_cache.h"
+#include "gfx/gfx_bindless.h"
+#include "gfx/gfx_descriptor_allocator.h"
+#include "gfx/gfx_descriptor_writer.h"
+#include "gfx/gfx_command_allocator.h"
+#include "gfx/gfx_command_bundle.h"
 #include <vector>
+#include <atomic>
+#include <mutex>
+
+// 默认的framesInFlight，即CPU最多可以领先GPU的帧数
+#define LITTLE_GFX_FRAMES_IN_FLIGHT 2
+
+class LittleGFXInstance;
+class LittleGFXDevice;
+class LittleGFXQueue;
 
 class LittleGFXAdapter
 {
     friend class LittleGFXWindow;
     friend class LittleGFXInstance;
     friend class LittleGFXDevice;
+    friend class LittleGFXMemoryAllocator;
+    friend class LittleGFXRingAllocator;
+    friend class LittleGFXResidencyManager;
+    friend class LittleGFXPipelineCache;
+    friend class LittleGFXBindlessHeap;
 
 protected:
     std::vector<const char*> deviceExtensions;
     std::vector<const char*> deviceLayers;
     VkPhysicalDevice vkPhysicalDevice;
-    int64_t gfxQueueIndex;
+    int64_t gfxQueueIndex = -1;
+    // 只支持计算（不支持图形）的队列族，通常对应硬件上的异步计算引擎，-1表示没有
+    int64_t computeQueueIndex = -1;
+    // 只支持传输（不支持图形和计算）的队列族，通常对应硬件上的DMA引擎，-1表示没有
+    int64_t transferQueueIndex = -1;
     uint32_t queueFamiliesCount;
+    std::vector<VkQueueFamilyProperties> queueFamilyProps;
     LittleGFXInstance* gfxInstance;
     VkPhysicalDeviceProperties2 vkPhysDeviceProps;
+    VkPhysicalDeviceMemoryProperties vkMemoryProps;
+    // Vulkan 1.2的特性，时间线信号量等都在这里面查询
+    VkPhysicalDeviceVulkan12Features vkFeatures12;
+    VkPhysicalDeviceSynchronization2FeaturesKHR vkSync2Features;
 
 protected:
     void queryProperties();
     void selectExtensionsAndLayers();
     void selectQueueIndices();
+    bool isExtensionEnabled(const char* extName) const;
+    // 在typeBits允许的内存类型中找到第一个满足flags的类型，找不到返回false
+    bool findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags, uint32_t& outTypeIndex) const;
 };
 
 class LittleGFXInstance
@@ -46,26 +85,271 @@ protected:
 protected:
     void selectExtensionsAndLayers(bool enableDebugLayer);
     void fetchAllAdapters();
+    bool isExtensionEnabled(const char* extName) const;
+};
+
+// 等待某个队列的时间线到达value，跨队列的依赖都用它来表达
+struct LittleGFXQueueWait {
+    LittleGFXQueue* queue = nullptr;
+    uint64_t value = 0;
+    // 本次提交中从哪个管线阶段开始需要等待
+    VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+};
+
+struct LittleGFXSubmitDesc {
+    const VkCommandBuffer* commandBuffers = nullptr;
+    uint32_t commandBufferCount = 0;
+    const LittleGFXQueueWait* waits = nullptr;
+    uint32_t waitCount = 0;
+    // 交换链的Acquire和Present只认二元信号量，所以这里仍然保留它们
+    const VkSemaphore* binaryWaits = nullptr;
+    const VkPipelineStageFlags* binaryWaitStages = nullptr;
+    uint32_t binaryWaitCount = 0;
+    const VkSemaphore* binarySignals = nullptr;
+    uint32_t binarySignalCount = 0;
+};
+
+// 提交次数的统计。enqueued是调用方请求提交的次数，也就是不做合批时vkQueueSubmit的次数
+struct LittleGFXSubmitStats {
+    uint64_t enqueued = 0;
+    // 合并之后实际产生的VkSubmitInfo2数量
+    uint64_t batches = 0;
+    // 实际调用vkQueueSubmit2(或vkQueueSubmit)的次数
+    uint64_t queueSubmits = 0;
+
+    LittleGFXSubmitStats& operator+=(const LittleGFXSubmitStats& other)
+    {
+        enqueued += other.enqueued;
+        batches += other.batches;
+        queueSubmits += other.queueSubmits;
+        return *this;
+    }
+};
+
+// 每个队列持有一个时间线信号量，每次提交都会signal一个单调递增的值
+// 这样既不需要为每次提交创建Fence，CPU查询进度也只是读一个计数器
+// 提交先进入队列上的合批器，Flush时用一次vkQueueSubmit2提交。等待相同的相邻提交合并成一个VkSubmitInfo2，
+// 等待不同的提交各自成批，不会因为合并而多等
+class LittleGFXQueue
+{
+    friend class LittleGFXDevice;
+    friend class LittleGFXWindow;
+    friend class LittleGFXUploadManager;
+    friend class LittleGFXDefragmenter;
+
+public:
+    VkQueue GetVkQueue() const { return vkQueue; }
+    uint32_t GetFamilyIndex() const { return familyIndex; }
+    VkQueueFlags GetFlags() const { return queueFlags; }
+    LittleGFXDevice* GetDevice() const { return gfxDevice; }
+    VkSemaphore GetTimelineSemaphore() const { return timelineSemaphore; }
+
+    // 把一批命令放进合批器，返回这批命令执行完毕时时间线会到达的值
+    // 命令要等到Flush之后才会真正提交给GPU
+    uint64_t Enqueue(const LittleGFXSubmitDesc& desc);
+    // 把合批器里积攒的所有命令一次提交
+    void Flush();
+    // 立即提交，等价于Enqueue之后Flush
+    uint64_t Submit(const LittleGFXSubmitDesc& desc);
+    VkResult Present(const VkPresentInfoKHR& presentInfo);
+    // 最近一次Enqueue/Submit会signal的值
+    uint64_t GetLastSubmittedValue() const { return lastSubmittedValue.load(std::memory_order_acquire); }
+    // 已经执行完毕的最大值。缓存值已经足够时不会调用驱动
+    uint64_t GetCompletedValue();
+    bool IsComplete(uint64_t value);
+    // 阻塞CPU直到时间线到达value，超时返回false。value还在合批器里时会先Flush
+    bool Wait(uint64_t value, uint64_t timeoutNs = UINT64_MAX);
+    // 取出自上次调用以来的提交统计并清零
+    LittleGFXSubmitStats TakeStats();
+
+protected:
+    // 合批器中的一个批次，对应一个VkSubmitInfo2。各个数组用下标引用下面的pending数组
+    struct PendingBatch {
+        uint32_t firstCommandBuffer;
+        uint32_t commandBufferCount;
+        uint32_t firstWait;
+        uint32_t waitCount;
+        uint32_t firstSignal;
+        uint32_t signalCount;
+        uint64_t signalValue;
+    };
+    struct PendingWait {
+        VkSemaphore semaphore;
+        uint64_t value;
+        VkPipelineStageFlags stageMask;
+    };
+    VkQueue vkQueue = VK_NULL_HANDLE;
+    uint32_t familyIndex = 0;
+    VkQueueFlags queueFlags = 0;
+    LittleGFXDevice* gfxDevice = nullptr;
+    VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+    std::atomic<uint64_t> lastSubmittedValue{ 0 };
+    std::atomic<uint64_t> flushedValue{ 0 };
+    std::atomic<uint64_t> completedValue{ 0 };
+    // VkQueue需要外部同步，专用队列不存在时多个角色会共用同一个VkQueue
+    std::mutex submitMutex;
+    std::vector<PendingBatch> pendingBatches;
+    std::vector<VkCommandBuffer> pendingCommandBuffers;
+    std::vector<PendingWait> pendingWaits;
+    std::vector<VkSemaphore> pendingBinarySignals;
+    // Enqueue时整理出的这次提交的等待
+    std::vector<PendingWait> enqueueWaits;
+    LittleGFXSubmitStats stats;
+    // 组装提交结构用的临时数组，复用它们避免每次Flush都分配内存
+    std::vector<VkSubmitInfo2KHR> submitInfos2;
+    std::vector<VkSemaphoreSubmitInfoKHR> semaphoreInfos;
+    std::vector<VkCommandBufferSubmitInfoKHR> commandBufferInfos;
+    std::vector<VkSubmitInfo> submitInfos;
+    std::vector<VkTimelineSemaphoreSubmitInfo> timelineInfos;
+    std::vector<VkSemaphore> semaphores;
+    std::vector<uint64_t> semaphoreValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+
+protected:
+    bool initialize(LittleGFXDevice* device, uint32_t familyIndex, VkQueueFlags flags);
+    void destroy();
+    void flushLocked();
+    // 批次的等待和enqueueWaits完全相同时，新的提交可以并入它而不会多等任何东西
+    bool hasSameWaits(const PendingBatch& batch) const;
+    void submitBatches2();
+    void submitBatchesLegacy();
 };
 
 class LittleGFXDevice
 {
     friend class LittleGFXWindow;
+    friend class LittleGFXQueue;
+    friend class LittleGFXMemoryAllocator;
+    friend class LittleGFXRingAllocator;
+    friend class LittleGFXUploadManager;
+    friend class LittleGFXResidencyManager;
+    friend class LittleGFXDefragmenter;
+    friend class LittleGFXPipelineCache;
+    friend class LittleGFXPipelineCompiler;
+    friend class LittleGFXShaderCache;
+    friend class LittleGFXBindlessHeap;
+    friend class LittleGFXDescriptorAllocator;
+    friend class LittleGFXDescriptorWriter;
+    friend class LittleGFXCommandAllocator;
+    friend class LittleGFXCommandBundleCache;
 
 public:
-    bool Initialize(LittleGFXAdapter* adapter);
+    // 按帧分区的分配器（环形分配器、描述符分配器、命令分配器）都按framesInFlight分区
+    bool Initialize(LittleGFXAdapter* adapter, uint32_t framesInFlight = LITTLE_GFX_FRAMES_IN_FLIGHT);
     bool Destroy();
 
+    LittleGFXQueue* GetGraphicsQueue() { return &gfxQueue; }
+    // 没有专用的计算/传输队列族时，返回的就是graphics queue本身
+    LittleGFXQueue* GetComputeQueue() { return HasDedicatedComputeQueue() ? &computeQueue : &gfxQueue; }
+    LittleGFXQueue* GetTransferQueue() { return HasDedicatedTransferQueue() ? &transferQueue : &gfxQueue; }
+    bool HasDedicatedComputeQueue() const { return computeQueue.vkQueue != VK_NULL_HANDLE; }
+    bool HasDedicatedTransferQueue() const { return transferQueue.vkQueue != VK_NULL_HANDLE; }
+    // 提交所有队列合批器里积攒的命令
+    void FlushQueues();
+    // 汇总所有队列自上次调用以来的提交统计并清零
+    LittleGFXSubmitStats TakeSubmitStats();
+    uint32_t GetFramesInFlight() const { return framesInFlight; }
+    bool IsSynchronization2Enabled() const { return synchronization2Enabled; }
+    bool IsDescriptorIndexingEnabled() const { return descriptorIndexingEnabled; }
+    bool IsPushDescriptorEnabled() const { return pushDescriptorEnabled; }
+    VkDevice GetVkDevice() const { return vkDevice; }
+    // 通过volkTable调用设备函数省掉了loader的一层转发，录制命令时用它
+    const VolkDeviceTable& GetVolkTable() const { return volkTable; }
+    // 所有缓冲和图像的显存都应该从这里子分配，而不是直接调用vkAllocateMemory
+    LittleGFXMemoryAllocator* GetMemoryAllocator() { return &memoryAllocator; }
+    // 每帧的动态数据从这里切分，切出的内存只在当前帧内有效
+    LittleGFXRingAllocator* GetRingAllocator() { return &ringAllocator; }
+    // 资源数据的异步上传，每帧开始时会自动Flush一次
+    LittleGFXUploadManager* GetUploadManager() { return &uploadManager; }
+    // 各个堆的预算，以及可降级/驱逐资源的登记
+    LittleGFXResidencyManager* GetResidencyManager() { return &residencyManager; }
+    // 长时间运行、不断流入流出资源时，用它在后台把显存块压实
+    LittleGFXDefragmenter* GetDefragmenter() { return &defragmenter; }
+    // 所有管线都应该通过这个缓存创建，它会在设备销毁时写回磁盘
+    LittleGFXPipelineCache* GetPipelineCache() { return &pipelineCache; }
+    // 在工作线程上并行编译管线
+    LittleGFXPipelineCompiler* GetPipelineCompiler() { return &pipelineCompiler; }
+    // 着色器模块、描述符集布局和管线布局都从这里取，相同的内容在设备上只有一份
+    LittleGFXShaderCache* GetShaderCache() { return &shaderCache; }
+    // 全局的无绑定描述符堆，每帧绑定一次即可
+    LittleGFXBindlessHeap* GetBindlessHeap() { return &bindlessHeap; }
+    // 非无绑定的描述符集从这里按帧分配，帧执行完毕后整池重置，不需要也不能单独释放
+    LittleGFXDescriptorAllocator* GetDescriptorAllocator() { return &descriptorAllocator; }
+    // 用更新模板从打包好的结构体一次写完整个描述符集
+    LittleGFXDescriptorWriter* GetDescriptorWriter() { return &descriptorWriter; }
+    // 每个录制线程按帧取用的命令缓冲，帧执行完毕后整池重置，多线程录制时各线程互不加锁
+    LittleGFXCommandAllocator* GetCommandAllocator() { return &commandAllocator; }
+    // 静态内容录制一次、每帧重放的次级命令缓冲
+    LittleGFXCommandBundleCache* GetCommandBundleCache() { return &commandBundleCache; }
+
 protected:
     LittleGFXAdapter* gfxAdapter;
     VkDevice vkDevice;
     VolkDeviceTable volkTable;
+    LittleGFXQueue gfxQueue;
+    LittleGFXQueue computeQueue;
+    LittleGFXQueue transferQueue;
+    uint32_t framesInFlight = LITTLE_GFX_FRAMES_IN_FLIGHT;
+    bool synchronization2Enabled = false;
+    bool descriptorIndexingEnabled = false;
+    bool pushDescriptorEnabled = false;
+    LittleGFXMemoryAllocator memoryAllocator;
+    LittleGFXRingAllocator ringAllocator;
+    LittleGFXUploadManager uploadManager;
+    LittleGFXResidencyManager residencyManager;
+    LittleGFXDefragmenter defragmenter;
+    LittleGFXPipelineCache pipelineCache;
+    LittleGFXPipelineCompiler pipelineCompiler;
+    LittleGFXShaderCache shaderCache;
+    LittleGFXBindlessHeap bindlessHeap;
+    LittleGFXDescriptorAllocator descriptorAllocator;
+    LittleGFXDescriptorWriter descriptorWriter;
+    LittleGFXCommandAllocator commandAllocator;
+    LittleGFXCommandBundleCache commandBundleCache;
+
+protected:
+    void fetchQueue(LittleGFXQueue& queue, int64_t familyIndex);
+    // 由帧循环在每帧开始和提交之后调用，按帧回收资源的子系统在这里推进
+    void beginFrame();
+    void endFrame(uint64_t gfxTimelineValue);
 };
 
-class LittleGFXQueue
+// 呈现的延迟档位，会被映射到Surface实际支持的最合适的呈现模式上
+enum class LittleGFXPresentProfile
 {
-protected:
-    VkQueue vkQueue;
+    // 延迟最低，允许画面撕裂（IMMEDIATE优先）
+    LowestLatency,
+    // 不撕裂的前提下延迟尽量低（MAILBOX优先）
+    NoTearingLowLatency,
+    // 偶尔掉帧时允许撕裂来减少卡顿（FIFO_RELAXED优先）
+    MinimizeStutter,
+    // 严格垂直同步，最省电（FIFO）
+    PowerSave
+};
+
+// 帧环中的一个槽位。同一时间最多有framesInFlight个槽位的命令在GPU上执行，
+// CPU因此可以在GPU执行第N帧时录制第N+1帧
+struct LittleGFXFrame {
+    // 这个槽位上一次提交在graphics queue时间线上的值，到达之后槽位才能复用
+    uint64_t timelineValue = 0;
+    // Acquire到的交换链图像可以被写入时signal
+    VkSemaphore imageAcquired = VK_NULL_HANDLE;
+    // 这一帧的命令执行完毕、图像可以被呈现时signal
+    VkSemaphore renderFinished = VK_NULL_HANDLE;
+    // TRANSIENT的命令池，每帧开始时整体重置，而不是一个个地释放命令缓冲
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    // BeginFrame返回时已经处于录制状态
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // 和commandBuffer同一批提交、按顺序排在它前面执行的主命令缓冲，比如多线程录制的各段命令。
+    // 它们要在EndFrame之前结束录制，BeginFrame时清空
+    std::vector<VkCommandBuffer> commandBuffers;
+    // 这一帧要写入的交换链图像
+    uint32_t imageIndex = 0;
+    VkImage image = VK_NULL_HANDLE;
+    // 这个槽位最近一次提交时是第几帧，0表示还没有提交过
+    uint64_t frameNumber = 0;
+    // 这一帧的命令缓冲在提交前还要等待的其他队列的时间线值，比如异步计算的结果。BeginFrame时清空
+    std::vector<LittleGFXQueueWait> waits;
 };
 
 class LittleGFXWindow : public LittleWindow
@@ -73,17 +357,85 @@ class LittleGFXWindow : public LittleWindow
     friend class LittleGFXInstance;
 
 public:
-    bool Initialize(const wchar_t* title, LittleGFXDevice* device, bool enableVsync);
+    // headless为true时不创建系统窗口，使用VK_EXT_headless_surface或者纯离屏的图像链来出图
+    // framesInFlight是CPU最多可以领先GPU的帧数，0表示使用设备的设置。
+    // 设备上按帧分区的分配器只有设备的framesInFlight个分区，所以不能超过它
+    bool Initialize(const wchar_t* title, LittleGFXDevice* device, LittleGFXPresentProfile profile,
+        bool headless = false, uint32_t framesInFlight = 0);
     bool Destroy();
 
+    // 开始新的一帧：等待这个槽位上一次的提交完成，重置它的命令池并取得下一张交换链图像
+    // 返回nullptr表示这一帧无法渲染（比如窗口被最小化）
+    LittleGFXFrame* BeginFrame();
+    // 结束录制并提交这一帧，随后把图像交给呈现引擎
+    void EndFrame(LittleGFXFrame* frame);
+    // 交换链图像在EndFrame之前需要被转换到的布局
+    VkImageLayout GetPresentLayout() const { return offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
+    VkFormat GetImageFormat() const { return swapchainFormat; }
+    VkExtent2D GetImageExtent() const { return swapchainExtent; }
+    LittleGFXDevice* GetDevice() const { return gfxDevice; }
+
+    // 是否在没有任何Surface的纯离屏图像链上渲染
+    bool IsOffscreen() const { return offscreen; }
+    uint32_t GetImageCount() const { return (uint32_t)swapchainImages.size(); }
+    void OnResize(uint32_t newWidth, uint32_t newHeight) override;
+    // 标记交换链需要重建（比如切换了呈现模式），重建会推迟到下一帧开始之前
+    void RequestSwapchainRecreate() { swapchainDirty = true; }
+    // 切换延迟档位，新的呈现模式在交换链重建后生效
+    void SetPresentProfile(LittleGFXPresentProfile profile);
+    LittleGFXPresentProfile GetPresentProfile() const { return presentProfile; }
+    VkPresentModeKHR GetPresentMode() const { return presentMode; }
+
 protected:
-    VkSurfaceKHR vkSurface;
-    VkSwapchainKHR vkSwapchain;
+    // 被新交换链替换掉的旧交换链。它的图像可能还被在途的帧使用，
+    // 所以要等到retireFrame之前提交的帧全部完成之后才能销毁。
+    // 帧完成不代表呈现引擎已经处理完它的Present，交换链还要等presentsDone
+    struct RetiredSwapchain {
+        VkSwapchainKHR swapchain;
+        // 离屏图像链的图像和内存由我们自己持有，同样需要延迟销毁
+        std::vector<VkImage> offscreenImages;
+        std::vector<LittleGFXAllocation> offscreenMemories;
+        uint64_t retireFrame;
+        // 新交换链上Present过的图像又被Acquire回来时，呈现引擎按顺序处理Present，
+        // 旧交换链上更早的Present一定也处理完了
+        bool presentsDone;
+    };
+
+    VkSurfaceKHR vkSurface = VK_NULL_HANDLE;
+    VkSwapchainKHR vkSwapchain = VK_NULL_HANDLE;
+    VkFormat swapchainFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    VkExtent2D swapchainExtent = {};
+    // 交换链中的图像。离屏模式下这些图像由我们自己创建并持有
+    std::vector<VkImage> swapchainImages;
+    std::vector<LittleGFXAllocation> offscreenMemories;
+    // 当前交换链上每张图像是否已经Present过
+    std::vector<bool> imagePresented;
+    std::vector<RetiredSwapchain> retiredSwapchains;
+    bool offscreen = false;
+    LittleGFXPresentProfile presentProfile = LittleGFXPresentProfile::PowerSave;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    bool swapchainDirty = false;
+    // 已经提交和已经确认在GPU上执行完毕的帧数，由帧循环推进
+    uint64_t submittedFrameCount = 0;
+    uint64_t completedFrameCount = 0;
+    std::vector<LittleGFXFrame> frames;
+    uint32_t currentFrame = 0;
     LittleGFXDevice* gfxDevice;
 
 protected:
     void createSurface(LittleGFXInstance* inst);
-    void createSwapchainKHR(LittleGFXDevice* device, bool enableVsync);
+    bool supportsPresent(LittleGFXDevice* device) const;
+    bool createSwapchainKHR(LittleGFXDevice* device);
+    // 按照延迟档位的偏好顺序挑出Surface支持的第一个呈现模式
+    VkPresentModeKHR selectPresentMode(LittleGFXDevice* device) const;
+    void createOffscreenChain(LittleGFXDevice* device, uint32_t imageCount);
+    void destroyOffscreenChain();
+    void createFrames(uint32_t framesInFlight);
+    void destroyFrames();
+    // 交换链过期或者被标记为需要重建时重建它，返回false表示当前无法渲染（比如窗口被最小化）
+    bool recreateSwapchainIfNeeded();
+    // 销毁所有已经没有在途帧引用的旧交换链
+    void collectRetiredSwapchains(bool waitAll = false);
 };
 
 static const char* validation_layer_name = "VK_LAYER_KHRONOS_validation";
@@ -101,9 +453,17 @@ static const char* wanted_instance_exts[] = {
     VK_KHR_ANDROID_SURFACE_EXTENSION_NAME,
 #endif
     //这个扩展允许我们使用DeviceProperties2来查询更多信息
-    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
+    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+    //无头模式下用来创建不依赖显示服务器的Surface，lavapipe等软件驱动都支持它
+    VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME
 };
 static const char* wanted_device_exts[] = {
     "VK_KHR_portability_subset", //如果使用MoltenVK这种移植性兼容层，打开此扩展
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    //提供VkSubmitInfo2和vkCmdPipelineBarrier2，在1.3才进入核心
+    VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+    //查询每个堆在操作系统眼中的预算和我们进程的实际使用量
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    //每次绘制的少量描述符直接写进命令缓冲，不需要分配描述符集
+    VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
 };
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include "gfx/volk.h"
+#include <string>
+#include <vector>
+#include <mutex>
+
+class LittleGFXDevice;
+
+// 缓存文件所在的目录，相对于工作目录
+#define LITTLE_GFX_PIPELINE_CACHE_DIR "PipelineCache"
+
+// 持久化到磁盘上的VkPipelineCache。文件名由厂商ID、设备ID、驱动版本和pipelineCacheUUID组成，
+// 换显卡或者升级驱动之后会自然地使用一个新文件，旧的缓存不会被误用。
+// 设备创建时加载，销毁时写回；工作线程使用各自的缓存编译管线，之后再合并进主缓存
+class LittleGFXPipelineCache
+{
+    friend class LittleGFXDevice;
+
+public:
+    // 主缓存不对外暴露：vkMergePipelineCaches要求目标缓存被外部同步，所有管线都通过LittleGFXPipelineCompiler
+    // 在工作线程各自的缓存上创建，主缓存只在合并锁里被读写
+    // 为工作线程创建一个以主缓存当前内容为初始数据的缓存，用完之后交给MergeThreadCache
+    VkPipelineCache CreateThreadCache();
+    // 把工作线程的缓存合并进主缓存并销毁它
+    void MergeThreadCache(VkPipelineCache threadCache);
+    // 立即把主缓存写回磁盘，通常只在退出时调用
+    bool Save();
+    const std::string& GetFilePath() const { return filePath; }
+    // 这次启动时是否成功加载了磁盘上的缓存
+    bool IsLoadedFromDisk() const { return loadedFromDisk; }
+
+protected:
+    // 写在文件开头的自定义头，用来在交给驱动之前发现不匹配或者损坏的文件
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    VkPipelineCache vkPipelineCache = VK_NULL_HANDLE;
+    // 合并和读取数据都在这个锁里进行
+    std::mutex mergeMutex;
+    std::string filePath;
+    bool loadedFromDisk = false;
+
+protected:
+    bool initialize(LittleGFXDevice* device);
+    void destroy();
+    // 读取并校验缓存文件，失败时返回空数据
+    std::vector<uint8_t> loadFile() const;
+    bool validate(const FileHeader& header, const uint8_t* data, size_t dataSize) const;
+    void fillHeader(FileHeader& header) const;
+    // 在合并锁里读出主缓存的全部数据
+    bool readData(std::vector<uint8_t>& outData);
+};
\ No newline at end of file
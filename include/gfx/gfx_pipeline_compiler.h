@@ -0,0 +1,138 @@
+#pragma once
+#include "gfx/volk.h"
+#include "framework/thread_pool.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+
+class LittleGFXDevice;
+
+struct LittleGFXShaderStageDesc {
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+    VkShaderModule module = VK_NULL_HANDLE;
+    std::string entryPoint = "main";
+};
+
+// 图形管线的描述。它持有所有数据的拷贝，所以可以安全地交给工作线程
+struct LittleGFXGraphicsPipelineDesc {
+    std::vector<LittleGFXShaderStageDesc> stages;
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    bool depthTest = false;
+    bool depthWrite = false;
+    VkCompareOp depthCompare = VK_COMPARE_OP_LESS_OR_EQUAL;
+    // 每个颜色附件一项，数量必须和子通道的颜色附件数一致
+    std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+    // 视口和裁剪默认是动态的，这样同一个管线可以用于任意分辨率
+    std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+};
+
+struct LittleGFXComputePipelineDesc {
+    LittleGFXShaderStageDesc stage;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+};
+
+enum class LittleGFXPipelineStatus
+{
+    Pending,
+    Ready,
+    Failed
+};
+
+// 编译任务和它的结果，由编译服务和持有句柄的渲染代码共享
+struct LittleGFXPipelineState {
+    std::atomic<LittleGFXPipelineStatus> status{ LittleGFXPipelineStatus::Pending };
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipeline fallback = VK_NULL_HANDLE;
+};
+
+// 异步编译出的管线的句柄。查询状态不会阻塞，管线还没编译好时Get返回备用管线
+class LittleGFXPipelineHandle
+{
+    friend class LittleGFXPipelineCompiler;
+
+public:
+    LittleGFXPipelineHandle() = default;
+    explicit LittleGFXPipelineHandle(std::shared_ptr<LittleGFXPipelineState> state_) : state(std::move(state_)) {}
+
+    bool IsValid() const { return state != nullptr; }
+    bool IsReady() const { return state && state->status.load(std::memory_order_acquire) == LittleGFXPipelineStatus::Ready; }
+    bool IsFailed() const { return state && state->status.load(std::memory_order_acquire) == LittleGFXPipelineStatus::Failed; }
+    // 编译完成时返回真正的管线，否则返回备用管线（可能为空，此时调用方应跳过这次绘制）
+    VkPipeline Get() const
+    {
+        if (!state) return VK_NULL_HANDLE;
+        return IsReady() ? state->pipeline : state->fallback;
+    }
+
+protected:
+    std::shared_ptr<LittleGFXPipelineState> state;
+};
+
+// 并行的管线编译服务。管线描述被投递到工作线程上编译，每个工作线程使用自己的VkPipelineCache，
+// 避免在驱动内部争抢同一个缓存的锁，这些缓存在WaitIdle之后或者销毁时合并进磁盘缓存。
+// 加载时可以一次投递几百个管线，把编译分摊到所有的核上，而不是在渲染线程上串行编译
+class LittleGFXPipelineCompiler
+{
+    friend class LittleGFXDevice;
+
+public:
+    // fallback是编译完成之前代替它的管线，比如同一个顶点格式的纯色管线
+    LittleGFXPipelineHandle CompileGraphics(const LittleGFXGraphicsPipelineDesc& desc, VkPipeline fallback = VK_NULL_HANDLE);
+    LittleGFXPipelineHandle CompileCompute(const LittleGFXComputePipelineDesc& desc, VkPipeline fallback = VK_NULL_HANDLE);
+    // 阻塞直到这个管线编译完成，返回编译出的管线（失败时为空）
+    VkPipeline Wait(const LittleGFXPipelineHandle& handle);
+    // 不再使用这个管线时调用，句柄被清空，它的其他副本也不能再使用。管线在编译结束、并且最后可能用到它的帧执行完毕之后销毁；
+    // 没有释放的管线一直保留到设备销毁
+    void Release(LittleGFXPipelineHandle& handle);
+    // 等待所有投递的编译完成，并把各线程的缓存合并进磁盘缓存。调用期间其他线程不能再投递编译
+    void WaitIdle();
+    uint32_t GetWorkerCount() const { return workers.GetThreadCount(); }
+    uint64_t GetCompiledCount() const { return compiledCount.load(std::memory_order_relaxed); }
+
+protected:
+    LittleGFXDevice* gfxDevice = nullptr;
+    LittleThreadPool workers;
+    // 每个工作线程私有的缓存，用工作线程序号索引
+    std::vector<VkPipelineCache> threadCaches;
+    // 一个等待中的管线的延迟销毁
+    struct RetiredPipeline {
+        VkPipeline pipeline;
+        // graphics queue时间线到达这个值之后才能销毁
+        uint64_t timelineValue;
+    };
+    // 编译服务创建的、还没有被释放的管线，设备销毁时统一销毁
+    std::vector<std::shared_ptr<LittleGFXPipelineState>> states;
+    // 已经释放、等待这一帧结束时打上时间线值的管线，还在编译的留到编译结束之后
+    std::vector<std::shared_ptr<LittleGFXPipelineState>> releasedStates;
+    std::vector<RetiredPipeline> retiredPipelines;
+    std::mutex statesMutex;
+    // 每个编译任务结束时通知，Wait在它上面睡眠而不是忙等
+    std::mutex finishMutex;
+    std::condition_variable pipelineFinished;
+    std::atomic<uint64_t> compiledCount{ 0 };
+
+protected:
+    bool initialize(LittleGFXDevice* device, uint32_t threadCount = 0);
+    void destroy();
+    // 销毁时间线已经完成的释放的管线
+    void beginFrame();
+    void endFrame(uint64_t timelineValue);
+    std::shared_ptr<LittleGFXPipelineState> createState(VkPipeline fallback);
+    void notifyFinished();
+    void mergeThreadCaches();
+    static void compileGraphics(LittleGFXDevice* device, VkPipelineCache cache,
+        const LittleGFXGraphicsPipelineDesc& desc, LittleGFXPipelineState& state);
+    static void compileCompute(LittleGFXDevice* device, VkPipelineCache cache,
+        const LittleGFXComputePipelineDesc& desc, LittleGFXPipelineState& state);
+};
\ No newline at end of file
@@ -0,0 +1,353 @@
+#pragma once
+#include "gfx/gfx_memory.h"
+#include <string>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+class LittleGFXRenderGraph;
+class LittleGFXQueue;
+class LittleThreadPool;
+struct LittleGFXFrame;
+
+// 图中资源的句柄，只在声明它的那一帧内有效
+typedef uint32_t LittleGFXRGResource;
+#define LITTLE_GFX_RG_INVALID_RESOURCE UINT32_MAX
+// 临时资源连续这么多帧没有被用到时才真正销毁，避免分辨率来回切换时反复创建
+#define LITTLE_GFX_RG_POOL_FRAMES 8
+// 估算关键路径时，跨队列的一次信号量等待相当于多少个单位开销的通道
+#define LITTLE_GFX_RG_CROSS_QUEUE_COST 0.25f
+
+// 通道被调度到的队列
+enum class LittleGFXRGQueue
+{
+    Graphics,
+    // 设备有专用的计算队列族时才会使用
+    AsyncCompute,
+    Count
+};
+
+// 通道使用资源的方式。读和写使用同一种用途，比如Read(ColorAttachment)表示混合时读取已有的颜色，
+// 图会据此推导出管线阶段、访问类型、图像布局以及创建临时资源时需要的usage
+enum class LittleGFXRGUsage
+{
+    ColorAttachment,
+    // 读时使用只读的深度布局，可以同时作为纹理采样
+    DepthStencilAttachment,
+    SampledGraphics,
+    SampledCompute,
+    StorageGraphics,
+    StorageCompute,
+    // 读对应TRANSFER_SRC，写对应TRANSFER_DST
+    Transfer,
+    UniformBuffer,
+    VertexBuffer,
+    IndexBuffer,
+    IndirectBuffer,
+    Count
+};
+
+struct LittleGFXRGImageDesc {
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    VkExtent3D extent = { 1, 1, 1 };
+    VkImageType imageType = VK_IMAGE_TYPE_2D;
+    uint32_t mipLevels = 1;
+    uint32_t arrayLayers = 1;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+struct LittleGFXRGBufferDesc {
+    VkDeviceSize size = 0;
+};
+
+// 通道的录制函数，调用之前这个通道需要的屏障已经录制好了。设置了线程池时不同的通道可能在不同的线程上
+// 同时被调用，各自录制进自己的命令缓冲，所以录制函数只能访问线程安全的对象；同一个命令缓冲里的通道按调度顺序调用
+typedef std::function<void(LittleGFXRenderGraph& graph, VkCommandBuffer cmd)> LittleGFXRGExecuteFunc;
+
+// 图中的一个通道，用Read/Write声明它访问的资源
+class LittleGFXRGPass
+{
+    friend class LittleGFXRenderGraph;
+
+public:
+    LittleGFXRGPass& Read(LittleGFXRGResource resource, LittleGFXRGUsage usage);
+    LittleGFXRGPass& Write(LittleGFXRGResource resource, LittleGFXRGUsage usage);
+    LittleGFXRGPass& SetExecute(LittleGFXRGExecuteFunc func);
+    // 有副作用的通道（比如回读、调试输出）即使没有通道使用它的结果也不会被剔除
+    LittleGFXRGPass& SetSideEffect();
+    // 声明这个通道只包含计算和传输命令，可以放到异步计算队列上执行。
+    // 图只会在能缩短关键路径时才这样调度，录制函数不能假设自己在哪个队列上
+    LittleGFXRGPass& SetAsyncCompute();
+    // 估计的GPU开销，单位任意，只用来比较调度到不同队列时关键路径的长短
+    LittleGFXRGPass& SetCost(float cost);
+    const std::string& GetName() const { return name; }
+    // 编译之后这个通道被调度到的队列，录制函数里可以用它区分
+    LittleGFXRGQueue GetQueue() const { return queue; }
+
+protected:
+    struct Access {
+        LittleGFXRGResource resource;
+        LittleGFXRGUsage usage;
+        bool write;
+    };
+    std::string name;
+    std::vector<Access> accesses;
+    LittleGFXRGExecuteFunc execute;
+    bool sideEffect = false;
+    bool asyncCompute = false;
+    float cost = 1.f;
+    bool alive = false;
+    LittleGFXRGQueue queue = LittleGFXRGQueue::Graphics;
+};
+
+// 编译统计
+struct LittleGFXRGStats {
+    uint32_t passCount = 0;
+    uint32_t culledPassCount = 0;
+    // 实际录制的屏障批次，每个批次对应一次vkCmdPipelineBarrier2
+    uint32_t barrierBatchCount = 0;
+    uint32_t imageBarrierCount = 0;
+    uint32_t memoryBarrierCount = 0;
+    uint32_t transientResourceCount = 0;
+    // 这一帧的临时资源各自独占显存时需要的总量
+    VkDeviceSize transientBytes = 0;
+    // 按生命周期让互不重叠的临时资源共用显存之后实际需要的总量，也就是这一帧临时资源的显存峰值
+    VkDeviceSize aliasedTransientBytes = 0;
+    uint32_t transientHeapCount = 0;
+    uint32_t asyncComputePassCount = 0;
+    // 图切分出的提交数，包括录制进帧命令缓冲的最后一段
+    uint32_t submissionCount = 0;
+    uint32_t ownershipTransferCount = 0;
+    // 通道被分成的录制块数，每块由一个线程录制进一个主命令缓冲
+    uint32_t recordChunkCount = 0;
+};
+
+// 帧图。每帧重新声明通道和它们读写的资源，Compile剔除结果没有被使用的通道，
+// 按资源状态的变化计算出最少的屏障并在每个通道边界合并成一批，Execute按顺序录制屏障和通道。
+// 临时资源按它们在调度中的生命周期放进共享的显存堆里，生命周期不重叠的资源占用同一段显存。
+// 设备有专用的计算队列族时，标记为异步计算的通道会被放到计算队列上，和图形通道重叠执行，
+// 图按依赖切分提交，生成跨队列的时间线等待和队列族所有权转移。
+// 设置了线程池时，通道按开销切成若干块在工作线程上并行录制，再按调度顺序拼接提交，结果和单线程录制相同。
+// 通道按声明的顺序执行，声明顺序必须满足生产者在前、消费者在后
+class LittleGFXRenderGraph
+{
+public:
+    bool Initialize(LittleGFXDevice* device);
+    bool Destroy();
+    // 用线程池并行录制通道，传入nullptr时在调用Execute的线程上录制。在Compile之前设置；
+    // Execute会等待线程池空闲，所以这个线程池最好不要同时执行其他耗时的任务。
+    // 工作线程使用命令分配器里workerIndex + 1的槽位，槽位不够时在这里按线程数扩充，所以要在Initialize之后、录制之外调用
+    void SetThreadPool(LittleThreadPool* pool);
+
+    // 开始声明新的一帧，上一帧声明的通道和资源句柄全部失效，临时资源的显存留在池里复用
+    void Reset();
+    // 导入外部持有的图像。initialLayout是图开始执行时图像的布局，
+    // finalLayout不为UNDEFINED时图执行完毕后图像会被转换到它（比如交换链图像的PRESENT_SRC）
+    LittleGFXRGResource ImportImage(const char* name, VkImage image, VkImageView view, const LittleGFXRGImageDesc& desc,
+        VkImageLayout initialLayout, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+    LittleGFXRGResource ImportBuffer(const char* name, VkBuffer buffer, VkDeviceSize size);
+    // 声明一个只在这一帧内使用的临时资源，它的内容不会跨帧保留
+    LittleGFXRGResource CreateImage(const char* name, const LittleGFXRGImageDesc& desc);
+    LittleGFXRGResource CreateBuffer(const char* name, const LittleGFXRGBufferDesc& desc);
+    // 返回的引用在下一次AddPass之后仍然有效
+    LittleGFXRGPass& AddPass(const char* name);
+
+    // 剔除通道、为通道选择队列、分配临时资源并计算屏障
+    bool Compile();
+    // 录制并提交编译好的调度。最后一段图形命令的命令缓冲追加到frame->commandBuffers，最终的布局转换录制进
+    // frame的命令缓冲，跨队列等待追加到frame->waits里，由窗口的EndFrame一起提交；更早的图形段和所有计算段
+    // 由图自己提交到对应队列的合批器。命令缓冲都从设备的命令分配器里按帧分配。
+    // 调用时frame的命令缓冲里不应该已经有命令，之后录制的命令在图之后执行。
+    // 导入时指定了finalLayout的图像（比如交换链图像）只会在最后一段里被访问
+    void Execute(LittleGFXFrame* frame);
+
+    // 以下接口在Compile之后、通道的录制函数里使用
+    VkImage GetImage(LittleGFXRGResource resource) const;
+    VkImageView GetImageView(LittleGFXRGResource resource) const;
+    VkBuffer GetBuffer(LittleGFXRGResource resource) const;
+    const LittleGFXRGImageDesc& GetImageDesc(LittleGFXRGResource resource) const { return resources[resource].imageDesc; }
+    const LittleGFXRGStats& GetStats() const { return stats; }
+
+protected:
+    // 资源在图执行过程中的同步状态
+    struct ResourceState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // 最近一次写入的阶段和访问，之后的读写都要等待它并让它可见
+        VkPipelineStageFlags2KHR writeStages = 0;
+        VkAccessFlags2KHR writeAccess = 0;
+        // 最近一次写入之后已经读过（写入对它们已经可见）的阶段，之后的写入要等待它们读完
+        VkPipelineStageFlags2KHR readStages = 0;
+        // 最近一次访问它的队列和通道。队列为Count表示这一帧还没有被访问过，
+        // 通道为UINT32_MAX表示在图开始之前（导入的资源默认属于graphics queue）
+        LittleGFXRGQueue queue = LittleGFXRGQueue::Count;
+        uint32_t lastPass = UINT32_MAX;
+    };
+    struct Resource {
+        std::string name;
+        bool isImage = false;
+        bool imported = false;
+        LittleGFXRGImageDesc imageDesc;
+        LittleGFXRGBufferDesc bufferDesc;
+        VkImageAspectFlags aspect = 0;
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // 所有访问需要的usage，创建临时资源时使用
+        VkImageUsageFlags imageUsage = 0;
+        VkBufferUsageFlags bufferUsage = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        // 被存活的通道使用过
+        bool used = false;
+        ResourceState state;
+        // 生命周期：第一次和最后一次使用它的存活通道在调度中的下标
+        uint32_t firstPass = UINT32_MAX;
+        uint32_t lastPass = 0;
+        // 临时资源的显存需求以及它在所在堆里的位置
+        VkMemoryRequirements memoryRequirements = {};
+        uint32_t heapIndex = UINT32_MAX;
+        VkDeviceSize heapOffset = 0;
+        // 这一帧里先占用过同一段显存的临时资源，第一次使用前要等它们的访问结束
+        std::vector<LittleGFXRGResource> aliasPredecessors;
+        // 被异步计算队列上的通道访问过。两个队列并行执行，调度顺序不代表执行顺序，所以这种资源不和别的资源共用显存
+        bool asyncAccess = false;
+    };
+    // 一个通道边界上合并在一起的屏障
+    struct BarrierBatch {
+        std::vector<VkImageMemoryBarrier2KHR> imageBarriers;
+        // 只有队列族所有权转移需要具体的缓冲屏障
+        std::vector<VkBufferMemoryBarrier2KHR> bufferBarriers;
+        // 缓冲之间的依赖合并成一个全局的内存屏障
+        VkMemoryBarrier2KHR memoryBarrier;
+    };
+    // 同一个队列上连续执行、作为一次提交的一段通道。跨队列的等待只能放在提交的开头，
+    // 所以等待另一个队列的通道会开始新的一段，被另一个队列等待的通道会结束当前段
+    struct Segment {
+        LittleGFXRGQueue queue = LittleGFXRGQueue::Graphics;
+        // 这一段包含调度中[firstPass, lastPass]里属于这个队列的通道
+        uint32_t firstPass = 0;
+        uint32_t lastPass = 0;
+        // 开始前要等待的另一个队列的段，UINT32_MAX表示不需要
+        uint32_t waitSegment = UINT32_MAX;
+    };
+    // 同一段里按调度顺序相邻的几个通道，由一个线程录制进一个主命令缓冲。
+    // 一段可以由多块组成，提交时按块的顺序排列，执行顺序和录制进同一个命令缓冲时相同
+    struct RecordChunk {
+        uint32_t segment = 0;
+        std::vector<uint32_t> passes;
+        // 这一帧录制出的命令缓冲，Execute时填写
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    };
+    // 堆里被graphics queue访问过的一段显存。value为0表示录制进了帧的命令缓冲，下一次Execute时从帧上取值
+    struct GraphicsUse {
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint64_t value = 0;
+    };
+    // 临时资源共用的一段显存。缓冲和图像分开放，内存类型不同的资源也分开放
+    struct TransientHeap {
+        // 递增的编号，缓存的资源靠它识别自己绑定在哪个堆上
+        uint32_t id = 0;
+        bool linear = false;
+        uint32_t memoryTypeBits = 0;
+        LittleGFXAllocation allocation;
+        uint64_t lastUsedFrame = 0;
+        // 上一帧最后访问这个堆里资源的阶段，这一帧第一个占用某段显存的资源要等待它们
+        VkPipelineStageFlags2KHR lastStages = 0;
+        VkAccessFlags2KHR lastWriteAccess = 0;
+        // 之前的帧在graphics queue上还没执行完的访问，计算段占用重叠的显存之前要等待它们
+        std::vector<GraphicsUse> graphicsUses;
+    };
+    // 绑定在堆里某个位置上的资源。描述和位置都不变时帧之间直接复用，不需要重新创建
+    struct PhysicalResource {
+        bool isImage = false;
+        uint32_t heapId = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        uint64_t lastUsedFrame = 0;
+    };
+    // 等待graphics queue时间线到达retireValue之后才能销毁的对象
+    struct RetiredPhysical {
+        PhysicalResource physical;
+        uint64_t retireValue = 0;
+    };
+    struct RetiredHeap {
+        LittleGFXAllocation allocation;
+        uint64_t retireValue = 0;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::vector<std::unique_ptr<LittleGFXRGPass>> passes;
+    std::vector<Resource> resources;
+    // 下标与存活通道的执行顺序对应，最后一个批次是图执行完毕后导入图像的最终转换
+    std::vector<BarrierBatch> barrierBatches;
+    // 通道执行完之后的屏障，只用来释放队列族所有权
+    std::vector<BarrierBatch> postBarrierBatches;
+    // 图开始之前释放导入资源所有权的屏障，需要时作为单独的一次图形提交
+    BarrierBatch prologueBatch;
+    std::vector<LittleGFXRGPass*> schedule;
+    // 以下数组的下标与schedule对应
+    std::vector<LittleGFXRGQueue> passQueues;
+    // 每个通道依赖的更早的通道（读写冲突）
+    std::vector<std::vector<uint32_t>> passDependencies;
+    std::vector<uint32_t> passSegments;
+    std::vector<Segment> segments;
+    // 最后一段图形命令，它录制进帧的命令缓冲
+    uint32_t finalSegment = UINT32_MAX;
+    bool asyncComputeEnabled = false;
+    // 按段的顺序排列
+    std::vector<RecordChunk> recordChunks;
+    LittleThreadPool* threadPool = nullptr;
+    std::vector<TransientHeap> heaps;
+    uint32_t nextHeapId = 1;
+    // 以资源描述、堆编号和偏移组成的字节串为键
+    std::unordered_map<std::string, PhysicalResource> physicalResources;
+    // 以资源描述为键缓存显存需求，避免每帧创建临时对象来查询
+    std::unordered_map<std::string, VkMemoryRequirements> requirementsCache;
+    std::vector<RetiredPhysical> retiredPhysicals;
+    std::vector<RetiredHeap> retiredHeaps;
+    uint64_t frameIndex = 0;
+    // 上一次Execute的帧和当时它的frameNumber，frameNumber变大说明那一帧已经提交，timelineValue就是最后一段的值
+    LittleGFXFrame* lastFrame = nullptr;
+    uint64_t lastFrameNumber = 0;
+    LittleGFXRGStats stats;
+    bool compiled = false;
+
+protected:
+    void cullPasses();
+    // 记录通道之间的读写依赖，估算关键路径为通道选择队列并切分提交
+    void buildDependencies();
+    void assignQueues();
+    bool isAsyncComputeCapable(const LittleGFXRGPass& pass) const;
+    // 切分提交。返回UINT32_MAX表示切分合法，否则返回必须退回图形队列的计算通道
+    uint32_t buildSegments();
+    // 按通道的开销把每一段切成录制块，块数大致等于参与录制的线程数
+    void buildRecordChunks();
+    void realizeResources();
+    // 资源描述组成的字节串，同样描述的临时资源可以共用同一个缓存的对象
+    std::string resourceKey(const Resource& resource) const;
+    bool queryRequirements(Resource& resource);
+    // 在一组内存兼容的临时资源里为每个资源找到最低的、不和生命周期重叠的资源冲突的偏移，返回堆的大小
+    VkDeviceSize placeResources(const std::vector<LittleGFXRGResource>& group);
+    uint32_t acquireHeap(bool linear, uint32_t memoryTypeBits, VkDeviceSize size, VkDeviceSize alignment);
+    bool acquirePhysical(Resource& resource);
+    void destroyPhysical(PhysicalResource& physical);
+    void retireHeap(size_t heapIndex);
+    // 回收已经不再使用的堆和资源，销毁已经执行完的退役对象
+    void trimPhysicalResources();
+    void computeBarriers();
+    // 把资源从当前状态转换到这次访问需要的状态，需要屏障时追加到batch里
+    void transition(Resource& resource, VkPipelineStageFlags2KHR stages, VkAccessFlags2KHR access, VkImageLayout layout,
+        bool write, LittleGFXRGQueue queue, uint32_t pass, BarrierBatch& batch);
+    // 资源换到另一个队列上使用：必要时在原队列上释放、在新队列上获取所有权，执行依赖由信号量保证
+    void transferOwnership(Resource& resource, VkPipelineStageFlags2KHR stages, VkAccessFlags2KHR access,
+        VkImageLayout layout, bool write, LittleGFXRGQueue queue, BarrierBatch& batch);
+    LittleGFXQueue* getQueue(LittleGFXRGQueue queue);
+    void recordChunk(RecordChunk& chunk, uint32_t threadIndex);
+    // 这一段的通道访问的所有资源，每个资源只出现一次
+    void gatherSegmentResources(uint32_t segment, std::vector<LittleGFXRGResource>& outResources) const;
+    // 确定上一帧最后一段的时间线值，丢掉已经执行完的graphics queue访问
+    void updateGraphicsUses();
+    static void resetBatch(BarrierBatch& batch);
+    void recordBarriers(VkCommandBuffer cmd, const BarrierBatch& batch);
+};
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+#include "gfx/volk.h"
+#include <vector>
+#include <mutex>
+#include <functional>
+
+class LittleGFXDevice;
+
+// 使用量超过预算的这个比例时开始降级和驱逐，留出余量给驱动和同一帧内新的分配
+#define LITTLE_GFX_RESIDENCY_TARGET 0.9f
+// 没有VK_EXT_memory_budget时，假定我们能用到堆大小的这个比例
+#define LITTLE_GFX_RESIDENCY_FALLBACK_BUDGET 0.8f
+
+enum class LittleGFXResidencyPriority
+{
+    // 流式加载的细节mip、远处的网格等，最先被处理
+    Low,
+    Normal,
+    High,
+    // 渲染目标等必须常驻的资源，永远不会被降级或驱逐
+    Critical
+};
+
+// 降级/驱逐回调。bytesWanted是还需要腾出的字节数，返回实际释放的字节数
+// 资源可能还在在途的帧里使用，回调里应该延迟到对应的时间线完成后再销毁
+// 回调在管理器的锁内执行，不能在回调里再调用LittleGFXResidencyManager的接口
+typedef std::function<VkDeviceSize(VkDeviceSize bytesWanted)> LittleGFXEvictCallback;
+
+struct LittleGFXResidencyDesc {
+    uint32_t heapIndex = 0;
+    VkDeviceSize size = 0;
+    LittleGFXResidencyPriority priority = LittleGFXResidencyPriority::Normal;
+    // 降级：比如丢掉最高的几级mip，资源仍然可用。可以为空
+    LittleGFXEvictCallback demote;
+    // 驱逐：整个资源被释放，之后需要重新加载。可以为空
+    LittleGFXEvictCallback evict;
+};
+
+typedef uint32_t LittleGFXResidencyHandle;
+#define LITTLE_GFX_INVALID_RESIDENCY_HANDLE UINT32_MAX
+
+// 一个堆的预算和使用量。有VK_EXT_memory_budget时usage是整个进程在这个堆上的使用量，
+// budget是操作系统在考虑了其他进程之后愿意给我们的量，超过它就会被换到系统内存里
+struct LittleGFXHeapBudget {
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+    VkDeviceSize heapSize = 0;
+    bool deviceLocal = false;
+};
+
+// 显存驻留管理。每帧查询各个堆的预算和使用量，快要超过预算时按优先级和最近使用时间
+// 先降级、再驱逐登记过的资源，避免资源被悄悄地换出到系统内存、帧率减半
+class LittleGFXResidencyManager
+{
+    friend class LittleGFXDevice;
+
+public:
+    LittleGFXResidencyHandle Register(const LittleGFXResidencyDesc& desc);
+    void Unregister(LittleGFXResidencyHandle handle);
+    // 标记资源在这一帧被使用，驱逐时最久没有使用的资源优先
+    void Touch(LittleGFXResidencyHandle handle);
+    // 资源重新加载或者尺寸变化之后更新它占用的大小，驱逐过的资源也由此重新变为常驻
+    void SetResident(LittleGFXResidencyHandle handle, VkDeviceSize size);
+    bool IsResident(LittleGFXResidencyHandle handle);
+    // 使用量超过预算的多少比例时开始处理
+    void SetTarget(float fraction) { targetFraction = fraction; }
+    bool IsBudgetExtensionEnabled() const { return budgetExtension; }
+    uint32_t GetHeapCount() const { return (uint32_t)heapBudgets.size(); }
+    const LittleGFXHeapBudget& GetHeapBudget(uint32_t heapIndex) const { return heapBudgets[heapIndex]; }
+    // 最近一次更新时降级和驱逐掉的字节数
+    VkDeviceSize GetLastReclaimedBytes() const { return lastReclaimedBytes; }
+
+protected:
+    struct Entry {
+        LittleGFXResidencyDesc desc;
+        uint64_t lastUsedFrame = 0;
+        bool resident = false;
+        bool alive = false;
+    };
+    // 已经降级/驱逐、但回调还没有真正销毁的字节数。资源要等用过它的帧执行完才会被销毁，
+    // 在那之前查询到的使用量里仍然包含它们，所以每次查询之后都要扣掉，否则会在之后的几帧里重复驱逐
+    struct PendingReclaim {
+        uint32_t heapIndex = 0;
+        VkDeviceSize bytes = 0;
+        // 释放它的那一帧在graphics queue时间线上的值，那一帧还没有提交时为UINT64_MAX
+        uint64_t timelineValue = UINT64_MAX;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::mutex residencyMutex;
+    std::vector<Entry> entries;
+    std::vector<LittleGFXResidencyHandle> freeHandles;
+    std::vector<LittleGFXHeapBudget> heapBudgets;
+    std::vector<LittleGFXResidencyHandle> candidates;
+    std::vector<PendingReclaim> pendingReclaims;
+    float targetFraction = LITTLE_GFX_RESIDENCY_TARGET;
+    bool budgetExtension = false;
+    uint64_t frameIndex = 0;
+    VkDeviceSize lastReclaimedBytes = 0;
+
+protected:
+    bool initialize(LittleGFXDevice* device);
+    void destroy();
+    // 由设备在每帧开始时调用
+    void update();
+    void endFrame(uint64_t timelineValue);
+    // 查询预算，再扣掉还没有销毁完的降级/驱逐量
+    void queryBudgets();
+    // 按优先级从低到高，每一档里先降级、不够再驱逐，返回释放的字节数
+    VkDeviceSize reclaimHeap(uint32_t heapIndex, VkDeviceSize bytesWanted);
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include "gfx/gfx_memory.h"
+
+// 每个分区初始的容量，不够用时在分区内追加新的缓冲
+#define LITTLE_GFX_RING_CHUNK_SIZE (4ull * 1024 * 1024)
+
+// 从环形缓冲中切出的一段，只在当前帧内有效
+struct LittleGFXRingSlice {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // 持久映射的地址，直接memcpy进去即可，内存是HOST_COHERENT的，不需要Flush
+    void* mappedData = nullptr;
+};
+
+// 每帧的动态常量和即时几何数据用的线性分配器。一个持久映射的主机可见缓冲按帧分成若干个分区，
+// 分配只是在当前分区上移动指针，分区在它最后一次被使用的帧在GPU上执行完毕后整体回收。
+// 这样每次绘制既不需要创建缓冲，也不需要map/unmap
+class LittleGFXRingAllocator
+{
+    friend class LittleGFXDevice;
+
+public:
+    // alignment为0时使用uniform/storage缓冲偏移对齐的要求
+    bool Allocate(VkDeviceSize size, LittleGFXRingSlice& outSlice, VkDeviceSize alignment = 0);
+    // 分配并把data拷贝进去
+    bool Upload(const void* data, VkDeviceSize size, LittleGFXRingSlice& outSlice, VkDeviceSize alignment = 0);
+    VkDeviceSize GetMinAlignment() const { return minAlignment; }
+    // 当前帧已经切出去的字节数
+    VkDeviceSize GetFrameUsage() const { return frameUsage; }
+
+protected:
+    struct Chunk {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        LittleGFXAllocation allocation;
+        VkDeviceSize capacity = 0;
+    };
+    struct Partition {
+        std::vector<Chunk> chunks;
+        // 最后一次使用这个分区的帧在graphics queue时间线上的值
+        uint64_t timelineValue = 0;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::mutex ringMutex;
+    std::vector<Partition> partitions;
+    uint32_t currentPartition = 0;
+    uint32_t currentChunk = 0;
+    VkDeviceSize cursor = 0;
+    VkDeviceSize frameUsage = 0;
+    VkDeviceSize minAlignment = 1;
+
+protected:
+    // 分区数等于设备的framesInFlight，BeginFrame时窗口已经等过这个分区上一次的使用
+    bool initialize(LittleGFXDevice* device, uint32_t partitionCount);
+    void destroy();
+    // 切换到下一个分区，必要时等待它上一次的使用完成
+    void beginFrame();
+    // 记录当前分区被哪一次提交使用
+    void endFrame(uint64_t timelineValue);
+    bool createChunk(VkDeviceSize capacity, Chunk& outChunk);
+};
\ No newline at end of file
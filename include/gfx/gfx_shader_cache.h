@@ -0,0 +1,117 @@
+#pragma once
+#include "gfx/volk.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+class LittleGFXDevice;
+
+// 一个push descriptor集合最多包含的描述符数，这是规范保证的maxPushDescriptors的最小值
+#define LITTLE_GFX_MAX_PUSH_DESCRIPTORS 32
+
+// 着色器里声明的一个描述符绑定
+struct LittleGFXDescriptorBinding {
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    // 数组的元素个数，运行时数组（不定长）为0
+    uint32_t count = 1;
+    VkShaderStageFlags stages = 0;
+    std::string name;
+};
+
+// 顶点着色器的一个输入，format按照着色器里的类型推导（比如vec3对应R32G32B32_SFLOAT）
+struct LittleGFXVertexInput {
+    uint32_t location = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    std::string name;
+};
+
+// 从SPIR-V中反射出的着色器接口
+struct LittleGFXShaderReflection {
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+    std::string entryPoint;
+    std::vector<LittleGFXDescriptorBinding> bindings;
+    // size为0表示没有push constant
+    VkPushConstantRange pushConstants = {};
+    // 只有顶点着色器会填写，按location排序
+    std::vector<LittleGFXVertexInput> vertexInputs;
+};
+
+struct LittleGFXShader {
+    VkShaderModule module = VK_NULL_HANDLE;
+    uint64_t hash = 0;
+    size_t codeSize = 0;
+    // 保留一份SPIR-V，哈希相同时逐字节比较，避免碰撞时拿到别的模块
+    std::vector<uint32_t> code;
+    LittleGFXShaderReflection reflection;
+};
+
+// 由一组着色器的反射结果合并出的管线布局。setBindings按set编号索引，
+// 中间没有用到的set对应一个空的布局，这样set编号和vkCmdBindDescriptorSets的firstSet一致
+struct LittleGFXPipelineLayout {
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> setBindings;
+    VkPushConstantRange pushConstants = {};
+    // 使用push descriptor的集合编号，没有时为UINT32_MAX
+    uint32_t pushSet = UINT32_MAX;
+};
+
+// 着色器模块和管线布局的缓存。相同的SPIR-V只创建一个VkShaderModule，
+// 描述符集布局和管线布局由反射结果自动生成，内容相同的布局在整个设备上只有一份，
+// 使用相同布局的管线之间切换时已经绑定的描述符集仍然兼容，不需要重新绑定
+class LittleGFXShaderCache
+{
+    friend class LittleGFXDevice;
+
+public:
+    // code为SPIR-V字节码，codeSize以字节计。返回的指针在设备销毁前一直有效，失败时返回nullptr
+    const LittleGFXShader* LoadShader(const uint32_t* code, size_t codeSize);
+    // 内容相同的绑定（和绑定的顺序无关）返回同一个布局
+    VkDescriptorSetLayout GetSetLayout(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount,
+        VkDescriptorSetLayoutCreateFlags flags = 0);
+    // 合并各个阶段的绑定和push constant，返回共享的管线布局。
+    // pushSet指定一个用push descriptor直接写进命令缓冲的集合，设备不支持或者集合不满足限制时退回普通的集合
+    const LittleGFXPipelineLayout* GetPipelineLayout(const LittleGFXShader* const* shaders, uint32_t shaderCount,
+        uint32_t pushSet = UINT32_MAX);
+    // 让管线布局的第set个集合总是使用外部创建的布局（比如全局的无绑定描述符堆），
+    // 着色器里这个集合的绑定应该是它的子集。之后创建的管线布局才会受影响
+    void SetExternalSetLayout(uint32_t set, VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+    // 着色器里不定长的描述符数组（比如sampler2D textures[]）在集合布局里的元素个数上限，
+    // 这些绑定会带上PARTIALLY_BOUND，没有写入的元素只要不被访问就不需要有效。
+    // 为0（默认）或者设备不支持描述符索引时，含有这种绑定的管线布局会创建失败；外部集合里的绑定不受影响
+    void SetRuntimeArrayLimit(uint32_t count);
+    // 只解析SPIR-V，不创建任何对象
+    static bool Reflect(const uint32_t* code, size_t wordCount, LittleGFXShaderReflection& outReflection);
+    uint32_t GetShaderCount();
+    uint32_t GetPipelineLayoutCount();
+
+protected:
+    struct SetLayoutEntry {
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::mutex cacheMutex;
+    // 以SPIR-V的哈希为键，哈希碰撞的不同代码放在同一个键下
+    std::unordered_multimap<uint64_t, std::unique_ptr<LittleGFXShader>> shaders;
+    // 以布局内容的字节串为键，比较键就是逐字节地比较内容
+    std::unordered_map<std::string, SetLayoutEntry> setLayouts;
+    std::unordered_map<std::string, std::unique_ptr<LittleGFXPipelineLayout>> pipelineLayouts;
+    // 以set编号为键，这些布局由外部持有，不在这里销毁
+    std::unordered_map<uint32_t, SetLayoutEntry> externalSetLayouts;
+    uint32_t runtimeArrayLimit = 0;
+
+protected:
+    bool initialize(LittleGFXDevice* device);
+    void destroy();
+    // 调用时必须持有cacheMutex，找到哈希、长度和内容都相同的已加载着色器
+    const LittleGFXShader* findShaderLocked(uint64_t hash, const uint32_t* code, size_t codeSize);
+    // 调用时必须持有cacheMutex，返回的条目里的bindings已经按binding排好序
+    // partiallyBound里的binding编号会带上VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+    const SetLayoutEntry* getSetLayoutLocked(std::vector<VkDescriptorSetLayoutBinding> bindings,
+        VkDescriptorSetLayoutCreateFlags flags, const std::vector<uint32_t>& partiallyBound = {});
+};
\ No newline at end of file
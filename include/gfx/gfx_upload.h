@@ -0,0 +1,140 @@
+#pragma once
+#include "gfx/gfx_memory.h"
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+class LittleGFXQueue;
+struct LittleGFXQueueWait;
+
+// 暂存环的大小，超过它的单次上传会临时创建一个独立的暂存缓冲
+#define LITTLE_GFX_STAGING_RING_SIZE (32ull * 1024 * 1024)
+// 暂存数据的对齐，满足vkCmdCopyBufferToImage对bufferOffset的要求（4字节以及常见的texel/压缩块大小）
+#define LITTLE_GFX_STAGING_ALIGNMENT 16
+
+// 一次上传的凭据，Flush之后可以用它换到对应的时间线值
+typedef uint64_t LittleGFXUploadTicket;
+
+// 设备级的异步上传服务。任意线程都可以把缓冲/图像的数据交给它，数据会被立刻拷贝进暂存环，
+// 拷贝命令在Flush时统一录制并提交到专用的传输队列上，再通过队列族所有权转移交还给graphics queue。
+// 这样几MB的资源上传不会阻塞渲染线程，传输也能和渲染重叠执行。
+// 传输队列只等待目标资源自己的最后一次图形使用，新资源和只涉及暂存的上传完全不等待图形队列
+class LittleGFXUploadManager
+{
+    friend class LittleGFXDevice;
+
+public:
+    // 把data拷贝到dst的dstOffset处，dst必须是EXCLUSIVE共享模式并带有TRANSFER_DST用途，范围之外的内容保持不变。
+    // 图形队列用过的缓冲（上传过或者MarkGraphicsUse登记过）直接在graphics queue上拷贝，排在之前的图形命令之后，
+    // 不需要所有权转移，也不会让传输队列等待整个图形队列；其余的缓冲在传输队列上拷贝
+    LittleGFXUploadTicket UploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+    // 把data拷贝到dst的region.imageSubresource上，region.bufferOffset会被忽略
+    // 目标子资源原来的内容会被丢弃，上传完成后图像处于finalLayout。
+    // 传输队列会等待这个图像登记过的最后一次图形使用完成，没有登记过的图像不等待
+    LittleGFXUploadTicket UploadImage(VkImage dst, const void* data, VkDeviceSize size,
+        const VkBufferImageCopy& region, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    // 录制并提交所有积攒的上传，返回graphics queue上所有权转移完成的时间线值
+    // 之后提交到graphics queue的命令自动排在它之后，其他队列需要等待outWait
+    void Flush(LittleGFXQueueWait& outWait);
+    void Flush();
+    // ticket还没有被Flush时返回false
+    bool GetWait(LittleGFXUploadTicket ticket, LittleGFXQueueWait& outWait);
+    bool IsComplete(LittleGFXUploadTicket ticket);
+    // 阻塞直到ticket对应的上传完成，必要时会先Flush
+    void Wait(LittleGFXUploadTicket ticket);
+    // 登记图形队列对资源的使用。graphicsValue是使用它的那次提交在graphics queue时间线上的值，
+    // 之后对这个图像的上传会等待这个值；缓冲在这之后的上传改为在graphics queue上原地拷贝
+    void MarkGraphicsUse(VkBuffer buffer);
+    void MarkGraphicsUse(VkImage image, uint64_t graphicsValue);
+    // 销毁缓冲之前调用，句柄被复用时不会被当作图形队列用过的缓冲
+    void ForgetBuffer(VkBuffer buffer);
+
+protected:
+    struct PendingCopy {
+        VkBuffer srcBuffer = VK_NULL_HANDLE;
+        VkDeviceSize srcOffset = 0;
+        VkBuffer dstBuffer = VK_NULL_HANDLE;
+        VkDeviceSize dstOffset = 0;
+        VkDeviceSize size = 0;
+        VkImage dstImage = VK_NULL_HANDLE;
+        VkBufferImageCopy region = {};
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // 在graphics queue上拷贝，没有专用传输队列时所有的拷贝都是这样
+        bool onGraphics = false;
+    };
+    // 暂存环上的一段区域，end之前的数据在queue到达value之后可以被覆盖。
+    // 一次Flush的拷贝都在传输队列上时是传输队列的值，否则是graphics queue上那次提交的值
+    struct StagingRetire {
+        VkDeviceSize end;
+        LittleGFXQueue* queue;
+        uint64_t value;
+    };
+    // 超过暂存环大小的上传使用的临时缓冲
+    struct TemporaryBuffer {
+        VkBuffer buffer;
+        LittleGFXAllocation allocation;
+        LittleGFXQueue* queue;
+        uint64_t value;
+    };
+    // 一次Flush用到的命令缓冲，graphics那边的完成意味着整次上传完成，之后就可以复用
+    struct Submission {
+        VkCommandPool transferPool = VK_NULL_HANDLE;
+        VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+        VkCommandPool graphicsPool = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCommands = VK_NULL_HANDLE;
+        uint64_t graphicsValue = 0;
+    };
+    enum class BarrierPhase
+    {
+        // 拷贝之前把目标图像转换到TRANSFER_DST，目标缓冲等待同一个队列上之前的访问
+        PreCopy,
+        // 传输队列上释放所有权
+        Release,
+        // graphics queue上获取所有权
+        Acquire,
+        // 在graphics queue上拷贝时，拷贝和使用在同一个队列族上，只需要普通的屏障
+        Complete
+    };
+    struct FlushedTicket {
+        LittleGFXUploadTicket ticket;
+        uint64_t graphicsValue;
+    };
+    LittleGFXDevice* gfxDevice = nullptr;
+    std::mutex uploadMutex;
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    LittleGFXAllocation stagingAllocation;
+    VkDeviceSize stagingCapacity = 0;
+    VkDeviceSize stagingHead = 0;
+    VkDeviceSize stagingTail = 0;
+    VkDeviceSize stagingPendingBytes = 0;
+    std::deque<StagingRetire> stagingRetires;
+    std::vector<TemporaryBuffer> pendingTemporaries;
+    std::vector<TemporaryBuffer> inflightTemporaries;
+    std::vector<PendingCopy> pendingCopies;
+    std::vector<Submission> submissions;
+    std::deque<FlushedTicket> flushedTickets;
+    // 下一次Flush会提交的ticket，以及最近一次Flush提交的ticket
+    LittleGFXUploadTicket currentTicket = 1;
+    LittleGFXUploadTicket lastFlushedTicket = 0;
+    uint64_t lastGraphicsValue = 0;
+    // 图形队列用过的缓冲，对它们的部分更新要保留原来的内容，放在graphics queue上拷贝
+    std::unordered_set<VkBuffer> graphicsBuffers;
+    // 图像最后一次被图形队列使用时的时间线值，完成之后就从这里删掉
+    std::unordered_map<VkImage, uint64_t> graphicsImages;
+    // 录制屏障用的临时数组
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+
+protected:
+    bool initialize(LittleGFXDevice* device);
+    void destroy();
+    // 把数据拷贝到暂存环上，放不下时改用临时缓冲
+    bool stageLocked(const void* data, VkDeviceSize size, VkBuffer& outBuffer, VkDeviceSize& outOffset);
+    bool tryAllocateStaging(VkDeviceSize size, VkDeviceSize& outOffset);
+    void reclaimLocked();
+    void flushLocked(LittleGFXQueueWait& outWait);
+    Submission& acquireSubmission();
+    // 只处理onGraphics等于graphicsCopies的那些拷贝
+    void recordBarriers(VkCommandBuffer cmd, BarrierPhase phase, bool graphicsCopies);
+    void recordCopies(VkCommandBuffer cmd, bool graphicsCopies);
+};
\ No newline at end of file
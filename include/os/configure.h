@@ -1,9 +1,19 @@
 #pragma once
 #include <assert.h>
-#ifndef WIN32_LEAN_AND_MEAN
-    #define WIN32_LEAN_AND_MEAN
+#include <stdint.h>
+#if defined(_WIN32) || defined(_WIN64)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    // windows.h中的min/max宏会和std::min/std::max冲突
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include "windows.h"
+#else
+    // 非Windows平台（比如Linux渲染节点）上没有我们支持的窗口系统，只能以无头（headless）模式运行
+    #define LITTLE_HEADLESS_ONLY
 #endif
-#include "windows.h"
 
 #ifndef SAFE_RELEASE
     #define SAFE_RELEASE(p_var) \
@@ -14,4 +24,6 @@
         }
 #endif
 
-#pragma warning (disable:4819)
\ No newline at end of file
+#ifdef _MSC_VER
+    #pragma warning (disable:4819)
+#endif
\ No newline at end of file
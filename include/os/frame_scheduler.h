@@ -0,0 +1,71 @@
+#pragma once
+#include "configure.h"
+#include <chrono>
+
+enum class LittleFrameMode
+{
+    // 不做任何限制，能跑多快跑多快，适合无头模式下测吞吐
+    Unlocked,
+    // 按照固定的目标帧率出帧，空闲时线程阻塞在计时器上
+    TargetFPS,
+    // 节奏由交换链的Present和帧的Fence决定，调度器自己不再等待。
+    // 无头/离屏交换链没有呈现引擎可以阻塞，此时退回按targetFPS用计时器节流
+    VSync
+};
+
+struct LittleFrameStats {
+    uint64_t frameIndex = 0;
+    // 相邻两帧开始之间的间隔
+    double frameMs = 0.0;
+    // BeginFrame到EndFrame经过的墙钟时间
+    double workMs = 0.0;
+    // 同一段时间里线程真正消耗的CPU时间，阻塞在Fence/Present上的时间不算在内
+    double cpuMs = 0.0;
+    // 在WaitForNextFrame里阻塞的时间
+    double waitMs = 0.0;
+    // 以上数值的滑动平均
+    double avgFrameMs = 0.0;
+    double avgWorkMs = 0.0;
+    double avgCpuMs = 0.0;
+};
+
+class LittleFrameScheduler
+{
+public:
+    // wakeOnMessages为true时，系统消息到来会提前结束等待，窗口因此能保持响应。
+    // presentBlocks为false表示Present不会阻塞（无头/离屏交换链），VSync模式改为按targetFPS节流。
+    // targetFPS不是正数或者创建计时器失败时返回false
+    bool Initialize(LittleFrameMode mode, double targetFPS, bool wakeOnMessages, bool presentBlocks = true);
+    bool Destroy();
+
+    // 阻塞直到下一帧到期。返回false表示等待被系统消息打断，应当先处理消息再来等待
+    bool WaitForNextFrame();
+    void BeginFrame();
+    void EndFrame();
+
+    LittleFrameMode GetMode() const { return mode; }
+    const LittleFrameStats& GetStats() const { return stats; }
+
+protected:
+    using Clock = std::chrono::steady_clock;
+    LittleFrameMode mode = LittleFrameMode::Unlocked;
+    Clock::duration period = {};
+    // 是否由WaitForNextFrame按period节流
+    bool paced = false;
+    Clock::time_point nextDeadline = {};
+    Clock::time_point lastFrameBegin = {};
+    Clock::time_point frameBegin = {};
+    double frameBeginCpuMs = 0.0;
+    double pendingWaitMs = 0.0;
+    bool wakeOnMessages = false;
+    LittleFrameStats stats;
+#if !defined(LITTLE_HEADLESS_ONLY)
+    HANDLE waitableTimer = nullptr;
+    bool highResolutionTimer = false;
+#endif
+
+protected:
+    // 阻塞到deadline，返回false表示被系统消息唤醒
+    bool sleepUntil(Clock::time_point deadline);
+    static double threadCpuTimeMs();
+};
\ No newline at end of file
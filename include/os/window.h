@@ -6,14 +6,29 @@
 class LittleWindow
 {
 public:
-    bool Initialize(const wchar_t* title);
+    // headless为true时不创建任何系统窗口，此时Run循环可以不受显示器约束地全速运行
+    bool Initialize(const wchar_t* title, bool headless = false);
     virtual void Run() = 0;
     bool Destroy();
 
+    bool IsHeadless() const { return headless; }
+    // 处理所有积压的系统消息，返回false表示窗口已经关闭、Run循环应当退出
+    bool PumpMessages();
+    // 阻塞直到有新的系统消息，窗口最小化等无事可做的时候用它让出CPU
+    void WaitMessages();
+    // 主动结束Run循环，无头模式下没有关闭按钮，只能这样退出
+    void RequestQuit() { quitRequested = true; }
+    // 窗口客户区大小发生变化时调用，无头模式下也可以直接调用它来模拟改变分辨率
+    virtual void OnResize(uint32_t newWidth, uint32_t newHeight);
+
 protected:
     std::wstring title;
-    UINT32 width;
-    UINT32 height;
-    HWND hWnd;
+    uint32_t width;
+    uint32_t height;
+    bool headless = false;
+    bool quitRequested = false;
+#if !defined(LITTLE_HEADLESS_ONLY)
+    HWND hWnd = nullptr;
     HWND createWin32Window(const wchar_t* title);
+#endif
 };
\ No newline at end of file
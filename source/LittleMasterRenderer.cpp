@@ -1,39 +1,183 @@
 #include "gfx/gfx_objects.h"
+#include "os/frame_scheduler.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
 
 class LittleRendererWindow final : public LittleGFXWindow
 {
 public:
     void Run() override
     {
-        MSG msg = { 0 };
-        while (msg.message != WM_QUIT)
+        // 有窗口时系统消息需要能打断帧之间的等待，窗口才不会失去响应。
+        // 无头模式的离屏交换链不会在Present上阻塞，垂直同步改为按targetFPS节流
+        if (!frameScheduler.Initialize(frameMode, targetFPS, !IsHeadless(), !IsHeadless()))
         {
-            // 处理系统的消息
-            if (PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
+            std::cout << "frame scheduler initialize failed, running unlocked" << std::endl;
+            frameScheduler.Initialize(LittleFrameMode::Unlocked, targetFPS, !IsHeadless());
+        }
+        auto start = std::chrono::steady_clock::now();
+        // 处理系统的消息，收到WM_QUIT或者RequestQuit之后退出循环
+        while (PumpMessages())
+        {
+            // 阻塞到下一帧到期为止，空闲时线程睡在计时器上而不是Sleep(1)轮询
+            if (!frameScheduler.WaitForNextFrame()) continue;
+            frameScheduler.BeginFrame();
+            // 最小化时没有东西可画，睡到下一条消息到来
+            auto frame = BeginFrame();
+            if (!frame)
             {
-                TranslateMessage(&msg);
-                DispatchMessage(&msg);
+                frameScheduler.EndFrame();
+                WaitMessages();
+                continue;
             }
-            // 在空闲时进行我们自己的逻辑
-            else
+            recordClear(frame);
+            EndFrame(frame);
+            submitStats += gfxDevice->TakeSubmitStats();
+            frameCount++;
+            if (frameLimit && frameCount >= frameLimit)
             {
-                // 暂时什么都不做
-                // Sleep 1~2ms 来避免整个线程被while抢占
-                Sleep(1);
+                RequestQuit();
             }
+            frameScheduler.EndFrame();
         }
-        // 如果收到了WM_QUIT消息，我们直接退出此函数
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const auto& stats = frameScheduler.GetStats();
+        std::cout << frameCount << " frames in " << seconds << "s, "
+                  << (seconds > 0.0 ? frameCount / seconds : 0.0) << " fps, "
+                  << "avg frame " << stats.avgFrameMs << "ms, "
+                  << "avg work " << stats.avgWorkMs << "ms, "
+                  << "avg cpu " << stats.avgCpuMs << "ms" << std::endl;
+        if (frameCount > 0)
+        {
+            // 合批前后每帧的提交次数
+            std::cout << "submits/frame: requested " << (double)submitStats.enqueued / frameCount
+                      << ", batches " << (double)submitStats.batches / frameCount
+                      << ", vkQueueSubmit " << (double)submitStats.queueSubmits / frameCount << std::endl;
+        }
+        frameScheduler.Destroy();
         return;
     }
+    // 渲染frameLimit帧以后自动退出，0表示不限制
+    void SetFrameLimit(uint64_t limit) { frameLimit = limit; }
+    // targetFPS在TargetFPS模式下生效，无头模式下的垂直同步也按它节流
+    void SetFrameMode(LittleFrameMode mode, double fps)
+    {
+        frameMode = mode;
+        targetFPS = fps;
+    }
+
+protected:
+    // 暂时只是用一个随时间变化的颜色清屏
+    void recordClear(LittleGFXFrame* frame)
+    {
+        auto& table = gfxDevice->GetVolkTable();
+        VkImageSubresourceRange range = {};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.levelCount = 1;
+        range.layerCount = 1;
+        // 上一帧的内容不需要保留，直接从UNDEFINED转换
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = frame->image;
+        barrier.subresourceRange = range;
+        table.vkCmdPipelineBarrier(frame->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+        float t = (float)(frameCount % 256) / 255.f;
+        VkClearColorValue color = { { t, 0.3f, 1.f - t, 1.f } };
+        table.vkCmdClearColorImage(frame->commandBuffer, frame->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &color, 1, &range);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = GetPresentLayout();
+        table.vkCmdPipelineBarrier(frame->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    uint64_t frameCount = 0;
+    uint64_t frameLimit = 0;
+    LittleGFXSubmitStats submitStats;
+    LittleFrameMode frameMode = LittleFrameMode::VSync;
+    double targetFPS = 60.0;
+    LittleFrameScheduler frameScheduler;
 };
 
-int main(void)
+int main(int argc, char** argv)
 {
+    // 命令行参数: --headless 不创建窗口运行，--frames N 渲染N帧后退出
+    // --fps N 按固定帧率出帧，--unlocked 不限帧率，默认有窗口时垂直同步、无头时不限帧率
+    // --present lowest|notearing|stutter|power 选择呈现的延迟档位
+    bool headless = false;
+    bool modeSpecified = false;
+    uint64_t frameLimit = 0;
+    LittleFrameMode frameMode = LittleFrameMode::VSync;
+    double targetFPS = 60.0;
+    bool profileSpecified = false;
+    LittleGFXPresentProfile presentProfile = LittleGFXPresentProfile::PowerSave;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string_view(argv[i]) == "--headless")
+            headless = true;
+        else if (std::string_view(argv[i]) == "--frames" && i + 1 < argc)
+            frameLimit = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::string_view(argv[i]) == "--fps" && i + 1 < argc)
+        {
+            frameMode = LittleFrameMode::TargetFPS;
+            targetFPS = std::strtod(argv[++i], nullptr);
+            modeSpecified = true;
+            if (!(targetFPS > 0.0))
+            {
+                std::cout << "--fps expects a positive frame rate, got " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (std::string_view(argv[i]) == "--unlocked")
+        {
+            frameMode = LittleFrameMode::Unlocked;
+            modeSpecified = true;
+        }
+        else if (std::string_view(argv[i]) == "--vsync")
+        {
+            frameMode = LittleFrameMode::VSync;
+            modeSpecified = true;
+        }
+        else if (std::string_view(argv[i]) == "--present" && i + 1 < argc)
+        {
+            auto profile = std::string_view(argv[++i]);
+            profileSpecified = true;
+            if (profile == "lowest")
+                presentProfile = LittleGFXPresentProfile::LowestLatency;
+            else if (profile == "notearing")
+                presentProfile = LittleGFXPresentProfile::NoTearingLowLatency;
+            else if (profile == "stutter")
+                presentProfile = LittleGFXPresentProfile::MinimizeStutter;
+            else
+                presentProfile = LittleGFXPresentProfile::PowerSave;
+        }
+    }
+#if defined(LITTLE_HEADLESS_ONLY)
+    headless = true;
+#endif
+    if (headless && !modeSpecified) frameMode = LittleFrameMode::Unlocked;
+    // 不限帧率时默认使用延迟最低的呈现模式，否则和原来一样严格垂直同步
+    if (!profileSpecified && frameMode == LittleFrameMode::Unlocked)
+        presentProfile = LittleGFXPresentProfile::LowestLatency;
+    // 无头模式下没有关闭按钮，不指定帧数时默认跑1000帧
+    if (headless && frameLimit == 0) frameLimit = 1000;
     // 创建并初始化实例
     auto instance = LittleFactory::Create<LittleGFXInstance>(true);
     auto device = LittleFactory::Create<LittleGFXDevice>(instance->GetAdapter(0));
     // 创建并初始化窗口类
-    auto window = LittleFactory::Create<LittleRendererWindow>(L"LittleMaster", device, true);
+    auto window = LittleFactory::Create<LittleRendererWindow>(L"LittleMaster", device, presentProfile, headless);
+    window->SetFrameLimit(frameLimit);
+    window->SetFrameMode(frameMode, targetFPS);
     // 运行窗口类的循环
     window->Run();
     // 现在窗口已经关闭，我们清理窗口类
@@ -0,0 +1,70 @@
+#include "framework/thread_pool.h"
+
+bool LittleThreadPool::Initialize(uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+    stopping = false;
+    threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back(&LittleThreadPool::workerMain, this, i);
+    }
+    return true;
+}
+
+bool LittleThreadPool::Destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        stopping = true;
+    }
+    // 还在排队的任务会被执行完再退出
+    taskAvailable.notify_all();
+    for (auto& thread : threads)
+    {
+        if (thread.joinable()) thread.join();
+    }
+    threads.clear();
+    return true;
+}
+
+void LittleThreadPool::Submit(LittleTask task)
+{
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        tasks.emplace_back(std::move(task));
+        pendingCount++;
+    }
+    taskAvailable.notify_one();
+}
+
+void LittleThreadPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(taskMutex);
+    allDone.wait(lock, [this]() { return pendingCount == 0; });
+}
+
+void LittleThreadPool::workerMain(uint32_t workerIndex)
+{
+    while (true)
+    {
+        LittleTask task;
+        {
+            std::unique_lock<std::mutex> lock(taskMutex);
+            taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task(workerIndex);
+        {
+            std::lock_guard<std::mutex> lock(taskMutex);
+            pendingCount--;
+            if (pendingCount == 0) allDone.notify_all();
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "gfx/gfx_bindless.h"
+#include "gfx/gfx_objects.h"
+#include <algorithm>
+
+static const VkDescriptorType bindlessDescriptorTypes[] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_SAMPLER
+};
+
+bool LittleGFXBindlessHeap::initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    if (!device->descriptorIndexingEnabled) return true;
+    // 数组容量受每个阶段可以访问的update-after-bind描述符数量限制
+    VkPhysicalDeviceVulkan12Properties props12 = {};
+    props12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 props = {};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &props12;
+    vkGetPhysicalDeviceProperties2(device->gfxAdapter->vkPhysicalDevice, &props);
+    slots[(uint32_t)LittleGFXBindlessType::SampledImage].capacity =
+        std::min<uint32_t>(LITTLE_GFX_BINDLESS_SAMPLED_IMAGES, props12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    slots[(uint32_t)LittleGFXBindlessType::StorageBuffer].capacity =
+        std::min<uint32_t>(LITTLE_GFX_BINDLESS_STORAGE_BUFFERS, props12.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+    slots[(uint32_t)LittleGFXBindlessType::Sampler].capacity =
+        std::min<uint32_t>(LITTLE_GFX_BINDLESS_SAMPLERS, props12.maxPerStageDescriptorUpdateAfterBindSamplers);
+    // 三个数组都是部分绑定的：没有写入的槽位只要不被访问就是合法的
+    VkDescriptorSetLayoutBinding bindings[(uint32_t)LittleGFXBindlessType::Count] = {};
+    VkDescriptorBindingFlags bindingFlags[(uint32_t)LittleGFXBindlessType::Count] = {};
+    VkDescriptorPoolSize poolSizes[(uint32_t)LittleGFXBindlessType::Count] = {};
+    for (uint32_t i = 0; i < (uint32_t)LittleGFXBindlessType::Count; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = bindlessDescriptorTypes[i];
+        bindings[i].descriptorCount = slots[i].capacity;
+        bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                          VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        poolSizes[i].type = bindlessDescriptorTypes[i];
+        poolSizes[i].descriptorCount = slots[i].capacity;
+    }
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flagsInfo.bindingCount = (uint32_t)LittleGFXBindlessType::Count;
+    flagsInfo.pBindingFlags = bindingFlags;
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &flagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = (uint32_t)LittleGFXBindlessType::Count;
+    layoutInfo.pBindings = bindings;
+    auto& table = device->volkTable;
+    if (table.vkCreateDescriptorSetLayout(device->vkDevice, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+    {
+        assert(0 && "create bindless descriptor set layout failed!");
+        return false;
+    }
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = (uint32_t)LittleGFXBindlessType::Count;
+    poolInfo.pPoolSizes = poolSizes;
+    if (table.vkCreateDescriptorPool(device->vkDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    {
+        assert(0 && "create bindless descriptor pool failed!");
+        return false;
+    }
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &setLayout;
+    if (table.vkAllocateDescriptorSets(device->vkDevice, &allocInfo, &descriptorSet) != VK_SUCCESS)
+    {
+        assert(0 && "allocate bindless descriptor set failed!");
+        return false;
+    }
+    // 之后由反射生成的管线布局在这个集合上都使用堆的布局，彼此兼容
+    device->shaderCache.SetExternalSetLayout(LITTLE_GFX_BINDLESS_SET, setLayout,
+        std::vector<VkDescriptorSetLayoutBinding>(bindings, bindings + (uint32_t)LittleGFXBindlessType::Count));
+    return true;
+}
+
+void LittleGFXBindlessHeap::destroy()
+{
+    auto& table = gfxDevice->volkTable;
+    // 描述符集随池一起释放
+    if (descriptorPool != VK_NULL_HANDLE) table.vkDestroyDescriptorPool(gfxDevice->vkDevice, descriptorPool, nullptr);
+    if (setLayout != VK_NULL_HANDLE) table.vkDestroyDescriptorSetLayout(gfxDevice->vkDevice, setLayout, nullptr);
+    descriptorPool = VK_NULL_HANDLE;
+    setLayout = VK_NULL_HANDLE;
+    descriptorSet = VK_NULL_HANDLE;
+    pendingSlots.clear();
+    retiredSlots.clear();
+}
+
+void LittleGFXBindlessHeap::beginFrame()
+{
+    std::lock_guard<std::mutex> lock(heapMutex);
+    // 按时间线的顺序退休，遇到第一个没完成的就可以停下
+    while (!retiredSlots.empty() && gfxDevice->gfxQueue.IsComplete(retiredSlots.front().timelineValue))
+    {
+        const auto& retired = retiredSlots.front();
+        slots[(uint32_t)retired.type].freeSlots.emplace_back(retired.index);
+        retiredSlots.pop_front();
+    }
+}
+
+void LittleGFXBindlessHeap::endFrame(uint64_t timelineValue)
+{
+    std::lock_guard<std::mutex> lock(heapMutex);
+    for (auto& slot : pendingSlots)
+    {
+        slot.timelineValue = timelineValue;
+        retiredSlots.emplace_back(slot);
+    }
+    pendingSlots.clear();
+}
+
+uint32_t LittleGFXBindlessHeap::allocateSlot(LittleGFXBindlessType type)
+{
+    auto& allocator = slots[(uint32_t)type];
+    uint32_t index = LITTLE_GFX_BINDLESS_INVALID_INDEX;
+    if (!allocator.freeSlots.empty())
+    {
+        index = allocator.freeSlots.back();
+        allocator.freeSlots.pop_back();
+    }
+    else if (allocator.highWater < allocator.capacity)
+    {
+        index = allocator.highWater++;
+    }
+    if (index != LITTLE_GFX_BINDLESS_INVALID_INDEX) allocator.usedCount++;
+    return index;
+}
+
+void LittleGFXBindlessHeap::write(LittleGFXBindlessType type, uint32_t index, const VkDescriptorImageInfo* imageInfo,
+    const VkDescriptorBufferInfo* bufferInfo)
+{
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = (uint32_t)type;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = bindlessDescriptorTypes[(uint32_t)type];
+    descriptorWrite.pImageInfo = imageInfo;
+    descriptorWrite.pBufferInfo = bufferInfo;
+    gfxDevice->volkTable.vkUpdateDescriptorSets(gfxDevice->vkDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+uint32_t LittleGFXBindlessHeap::AddSampledImage(VkImageView view, VkImageLayout layout)
+{
+    if (!IsEnabled()) return LITTLE_GFX_BINDLESS_INVALID_INDEX;
+    std::lock_guard<std::mutex> lock(heapMutex);
+    const uint32_t index = allocateSlot(LittleGFXBindlessType::SampledImage);
+    if (index == LITTLE_GFX_BINDLESS_INVALID_INDEX) return index;
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = layout;
+    write(LittleGFXBindlessType::SampledImage, index, &imageInfo, nullptr);
+    return index;
+}
+
+uint32_t LittleGFXBindlessHeap::AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    if (!IsEnabled()) return LITTLE_GFX_BINDLESS_INVALID_INDEX;
+    std::lock_guard<std::mutex> lock(heapMutex);
+    const uint32_t index = allocateSlot(LittleGFXBindlessType::StorageBuffer);
+    if (index == LITTLE_GFX_BINDLESS_INVALID_INDEX) return index;
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = offset;
+    bufferInfo.range = range;
+    write(LittleGFXBindlessType::StorageBuffer, index, nullptr, &bufferInfo);
+    return index;
+}
+
+uint32_t LittleGFXBindlessHeap::AddSampler(VkSampler sampler)
+{
+    if (!IsEnabled()) return LITTLE_GFX_BINDLESS_INVALID_INDEX;
+    std::lock_guard<std::mutex> lock(heapMutex);
+    const uint32_t index = allocateSlot(LittleGFXBindlessType::Sampler);
+    if (index == LITTLE_GFX_BINDLESS_INVALID_INDEX) return index;
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = sampler;
+    write(LittleGFXBindlessType::Sampler, index, &imageInfo, nullptr);
+    return index;
+}
+
+void LittleGFXBindlessHeap::Remove(LittleGFXBindlessType type, uint32_t index)
+{
+    if (index == LITTLE_GFX_BINDLESS_INVALID_INDEX) return;
+    std::lock_guard<std::mutex> lock(heapMutex);
+    // 旧的描述符留在槽位里不动，部分绑定的数组只要着色器不再访问它就是合法的
+    RetiredSlot slot;
+    slot.type = type;
+    slot.index = index;
+    slot.timelineValue = 0;
+    pendingSlots.emplace_back(slot);
+    slots[(uint32_t)type].usedCount--;
+}
+
+uint32_t LittleGFXBindlessHeap::GetUsedCount(LittleGFXBindlessType type)
+{
+    std::lock_guard<std::mutex> lock(heapMutex);
+    return slots[(uint32_t)type].usedCount;
+}
+
+void LittleGFXBindlessHeap::Bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout) const
+{
+    gfxDevice->volkTable.vkCmdBindDescriptorSets(cmd, bindPoint, layout, LITTLE_GFX_BINDLESS_SET, 1, &descriptorSet, 0, nullptr);
+}
\ No newline at end of file
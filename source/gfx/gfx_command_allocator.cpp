@@ -0,0 +1,144 @@
+#include "gfx/gfx_command_allocator.h"
+#include "gfx/gfx_objects.h"
+
+bool LittleGFXCommandAllocator::initialize(LittleGFXDevice* device, uint32_t partitionCount)
+{
+    gfxDevice = device;
+    partitions.resize(partitionCount);
+    // 线程的槽位预先开好，录制时不会有人扩容这个数组
+    for (auto& partition : partitions)
+    {
+        partition.threads.resize(LITTLE_GFX_COMMAND_RESERVED_THREADS);
+    }
+    currentPartition = 0;
+    return true;
+}
+
+void LittleGFXCommandAllocator::destroy()
+{
+    // 销毁池时池里的命令缓冲一起被释放
+    for (auto& partition : partitions)
+    {
+        for (auto& familyPools : partition.threads)
+        {
+            for (auto& familyPool : familyPools)
+            {
+                gfxDevice->volkTable.vkDestroyCommandPool(gfxDevice->vkDevice, familyPool.pool, nullptr);
+            }
+        }
+    }
+    partitions.clear();
+    poolCount = 0;
+}
+
+void LittleGFXCommandAllocator::beginFrame()
+{
+    currentPartition = (currentPartition + 1) % (uint32_t)partitions.size();
+    auto& partition = partitions[currentPartition];
+    // 分区数和帧环的槽位数相同，窗口在BeginFrame里已经等过这个值了，这里不会阻塞。
+    // 其他队列上的命令也从这里分配，它们的结果都被这一帧graphics queue上的提交等待过，所以只等这一个值
+    gfxDevice->gfxQueue.Wait(partition.timelineValue);
+    for (auto& familyPools : partition.threads)
+    {
+        for (auto& familyPool : familyPools)
+        {
+            // 整个池一次重置，命令缓冲回到初始状态，留着下一次直接复用
+            gfxDevice->volkTable.vkResetCommandPool(gfxDevice->vkDevice, familyPool.pool, 0);
+            familyPool.usedCount[0] = 0;
+            familyPool.usedCount[1] = 0;
+        }
+    }
+}
+
+void LittleGFXCommandAllocator::endFrame(uint64_t timelineValue)
+{
+    partitions[currentPartition].timelineValue = timelineValue;
+}
+
+void LittleGFXCommandAllocator::ReserveThreads(uint32_t threadCount)
+{
+    // 只会变大：已经创建的池还挂在原来的槽位上，缩小会把它们泄漏掉
+    for (auto& partition : partitions)
+    {
+        if (partition.threads.size() < threadCount) partition.threads.resize(threadCount);
+    }
+}
+
+VkCommandBuffer LittleGFXCommandAllocator::acquire(uint32_t threadIndex, LittleGFXQueue* queue, VkCommandBufferLevel level)
+{
+    if (threadIndex >= partitions[currentPartition].threads.size())
+    {
+        assert(0 && "command allocator thread index out of range!");
+        return VK_NULL_HANDLE;
+    }
+    auto& table = gfxDevice->volkTable;
+    auto& familyPools = partitions[currentPartition].threads[threadIndex];
+    const uint32_t familyIndex = queue->GetFamilyIndex();
+    FamilyPool* familyPool = nullptr;
+    for (auto& candidate : familyPools)
+    {
+        if (candidate.familyIndex == familyIndex) familyPool = &candidate;
+    }
+    if (familyPool == nullptr)
+    {
+        // 这个线程第一次在这个分区里给这个队列族录制，池只在这里创建一次
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = familyIndex;
+        VkCommandPool pool = VK_NULL_HANDLE;
+        if (table.vkCreateCommandPool(gfxDevice->vkDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        {
+            assert(0 && "create command pool failed!");
+            return VK_NULL_HANDLE;
+        }
+        poolCount++;
+        familyPools.emplace_back();
+        familyPool = &familyPools.back();
+        familyPool->familyIndex = familyIndex;
+        familyPool->pool = pool;
+    }
+    const uint32_t levelIndex = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+    auto& commandBuffers = familyPool->commandBuffers[levelIndex];
+    uint32_t& usedCount = familyPool->usedCount[levelIndex];
+    if (usedCount == (uint32_t)commandBuffers.size())
+    {
+        VkCommandBufferAllocateInfo cmdInfo = {};
+        cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdInfo.commandPool = familyPool->pool;
+        cmdInfo.level = level;
+        cmdInfo.commandBufferCount = 1;
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        if (table.vkAllocateCommandBuffers(gfxDevice->vkDevice, &cmdInfo, &cmd) != VK_SUCCESS)
+        {
+            assert(0 && "allocate command buffer failed!");
+            return VK_NULL_HANDLE;
+        }
+        commandBuffers.emplace_back(cmd);
+    }
+    return commandBuffers[usedCount++];
+}
+
+VkCommandBuffer LittleGFXCommandAllocator::AllocatePrimary(uint32_t threadIndex, LittleGFXQueue* queue)
+{
+    VkCommandBuffer cmd = acquire(threadIndex, queue, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    if (cmd == VK_NULL_HANDLE) return VK_NULL_HANDLE;
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    gfxDevice->volkTable.vkBeginCommandBuffer(cmd, &beginInfo);
+    return cmd;
+}
+
+VkCommandBuffer LittleGFXCommandAllocator::AllocateSecondary(uint32_t threadIndex, LittleGFXQueue* queue,
+    const VkCommandBufferInheritanceInfo& inheritance, VkCommandBufferUsageFlags flags)
+{
+    VkCommandBuffer cmd = acquire(threadIndex, queue, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    if (cmd == VK_NULL_HANDLE) return VK_NULL_HANDLE;
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = flags;
+    beginInfo.pInheritanceInfo = &inheritance;
+    gfxDevice->volkTable.vkBeginCommandBuffer(cmd, &beginInfo);
+    return cmd;
+}
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "gfx/gfx_command_bundle.h"
+#include "gfx/gfx_objects.h"
+
+// 每一项前面加一个标记字节，不同种类的输入拼在一起时不会恰好得到相同的字节串
+LittleGFXBundleKey& LittleGFXBundleKey::Pipeline(VkPipeline pipeline)
+{
+    bytes.push_back('P');
+    bytes.append((const char*)&pipeline, sizeof(pipeline));
+    return *this;
+}
+
+LittleGFXBundleKey& LittleGFXBundleKey::Viewport(const VkViewport& viewport, const VkRect2D& scissor)
+{
+    bytes.push_back('V');
+    bytes.append((const char*)&viewport, sizeof(viewport));
+    bytes.append((const char*)&scissor, sizeof(scissor));
+    return *this;
+}
+
+LittleGFXBundleKey& LittleGFXBundleKey::Bindless(const uint32_t* indices, uint32_t count)
+{
+    bytes.push_back('B');
+    bytes.append((const char*)&count, sizeof(count));
+    bytes.append((const char*)indices, sizeof(uint32_t) * count);
+    return *this;
+}
+
+LittleGFXBundleKey& LittleGFXBundleKey::Value(const void* data, size_t size)
+{
+    bytes.push_back('D');
+    bytes.append((const char*)&size, sizeof(size));
+    bytes.append((const char*)data, size);
+    return *this;
+}
+
+bool LittleGFXCommandBundleCache::initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    frameIndex = 0;
+    // bundle只在graphics queue上执行。不带TRANSIENT，它们会存活很多帧
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = device->gfxQueue.GetFamilyIndex();
+    if (device->volkTable.vkCreateCommandPool(device->vkDevice, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+    {
+        assert(0 && "fatal: create bundle command pool failed!");
+        return false;
+    }
+    return true;
+}
+
+void LittleGFXCommandBundleCache::destroy()
+{
+    std::lock_guard<std::mutex> lock(bundleMutex);
+    // 命令缓冲随命令池一起释放
+    gfxDevice->volkTable.vkDestroyCommandPool(gfxDevice->vkDevice, commandPool, nullptr);
+    commandPool = VK_NULL_HANDLE;
+    bundles.clear();
+    frameBundles.clear();
+    retiredBundles.clear();
+    stats = LittleGFXBundleStats();
+}
+
+void LittleGFXCommandBundleCache::retire(std::unique_ptr<Bundle> bundle)
+{
+    retiredBundles.emplace_back(std::move(bundle));
+}
+
+void LittleGFXCommandBundleCache::beginFrame()
+{
+    std::lock_guard<std::mutex> lock(bundleMutex);
+    frameIndex++;
+    // 长时间没有执行过的bundle多半是输入已经变了，旧键不会再被用到
+    for (auto iter = bundles.begin(); iter != bundles.end();)
+    {
+        if (iter->second->lastUsedFrame + LITTLE_GFX_BUNDLE_EVICT_FRAMES < frameIndex)
+        {
+            retire(std::move(iter->second));
+            iter = bundles.erase(iter);
+        }
+        else
+            ++iter;
+    }
+    auto& gfxQueue = gfxDevice->gfxQueue;
+    for (size_t i = 0; i < retiredBundles.size();)
+    {
+        if (gfxQueue.IsComplete(retiredBundles[i]->lastUsedValue))
+        {
+            gfxDevice->volkTable.vkFreeCommandBuffers(gfxDevice->vkDevice, commandPool, 1, &retiredBundles[i]->commandBuffer);
+            retiredBundles[i] = std::move(retiredBundles.back());
+            retiredBundles.pop_back();
+        }
+        else
+            i++;
+    }
+    stats.hitCount = 0;
+    stats.recordCount = 0;
+    stats.bundleCount = (uint32_t)bundles.size();
+}
+
+void LittleGFXCommandBundleCache::endFrame(uint64_t timelineValue)
+{
+    std::lock_guard<std::mutex> lock(bundleMutex);
+    for (auto bundle : frameBundles)
+    {
+        bundle->lastUsedValue = timelineValue;
+    }
+    frameBundles.clear();
+}
+
+VkCommandBuffer LittleGFXCommandBundleCache::Get(const LittleGFXBundleKey& key, const VkCommandBufferInheritanceInfo& inheritance,
+    const LittleGFXBundleRecordFunc& record, VkCommandBufferUsageFlags flags)
+{
+    // 同样的内容在不同的渲染通道、子通道里执行时是不同的bundle
+    std::string fullKey = key.GetBytes();
+    fullKey.append((const char*)&inheritance.renderPass, sizeof(inheritance.renderPass));
+    fullKey.append((const char*)&inheritance.subpass, sizeof(inheritance.subpass));
+    fullKey.append((const char*)&inheritance.framebuffer, sizeof(inheritance.framebuffer));
+    fullKey.append((const char*)&flags, sizeof(flags));
+    std::lock_guard<std::mutex> lock(bundleMutex);
+    Bundle* bundle = nullptr;
+    auto iter = bundles.find(fullKey);
+    if (iter != bundles.end())
+    {
+        bundle = iter->second.get();
+        stats.hitCount++;
+    }
+    else
+    {
+        auto& table = gfxDevice->volkTable;
+        VkCommandBufferAllocateInfo cmdInfo = {};
+        cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdInfo.commandPool = commandPool;
+        cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        cmdInfo.commandBufferCount = 1;
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        if (table.vkAllocateCommandBuffers(gfxDevice->vkDevice, &cmdInfo, &cmd) != VK_SUCCESS)
+        {
+            assert(0 && "allocate bundle command buffer failed!");
+            return VK_NULL_HANDLE;
+        }
+        // 在途的几帧会同时引用同一个bundle，所以需要SIMULTANEOUS_USE
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = flags | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+        beginInfo.pInheritanceInfo = &inheritance;
+        table.vkBeginCommandBuffer(cmd, &beginInfo);
+        record(cmd);
+        if (table.vkEndCommandBuffer(cmd) != VK_SUCCESS)
+        {
+            table.vkFreeCommandBuffers(gfxDevice->vkDevice, commandPool, 1, &cmd);
+            assert(0 && "record command bundle failed!");
+            return VK_NULL_HANDLE;
+        }
+        auto newBundle = std::make_unique<Bundle>();
+        newBundle->key = key.GetBytes();
+        newBundle->commandBuffer = cmd;
+        bundle = newBundle.get();
+        bundles.emplace(std::move(fullKey), std::move(newBundle));
+        stats.recordCount++;
+        stats.bundleCount = (uint32_t)bundles.size();
+    }
+    // 一帧里多次使用只登记一次，提交之前时间线值未知，先标成永远不会完成
+    if (bundle->lastUsedValue != UINT64_MAX) frameBundles.emplace_back(bundle);
+    bundle->lastUsedFrame = frameIndex;
+    bundle->lastUsedValue = UINT64_MAX;
+    return bundle->commandBuffer;
+}
+
+bool LittleGFXCommandBundleCache::Execute(VkCommandBuffer cmd, const LittleGFXBundleKey& key,
+    const VkCommandBufferInheritanceInfo& inheritance, const LittleGFXBundleRecordFunc& record, VkCommandBufferUsageFlags flags)
+{
+    VkCommandBuffer bundle = Get(key, inheritance, record, flags);
+    if (bundle == VK_NULL_HANDLE) return false;
+    gfxDevice->volkTable.vkCmdExecuteCommands(cmd, 1, &bundle);
+    return true;
+}
+
+void LittleGFXCommandBundleCache::Invalidate(const LittleGFXBundleKey& key)
+{
+    std::lock_guard<std::mutex> lock(bundleMutex);
+    // 同一个键可能在几个不同的渲染通道里各有一个bundle
+    for (auto iter = bundles.begin(); iter != bundles.end();)
+    {
+        if (iter->second->key == key.GetBytes())
+        {
+            retire(std::move(iter->second));
+            iter = bundles.erase(iter);
+        }
+        else
+            ++iter;
+    }
+    stats.bundleCount = (uint32_t)bundles.size();
+}
+
+void LittleGFXCommandBundleCache::InvalidateAll()
+{
+    std::lock_guard<std::mutex> lock(bundleMutex);
+    for (auto& iter : bundles)
+    {
+        retire(std::move(iter.second));
+    }
+    bundles.clear();
+    stats.bundleCount = 0;
+}
\ No newline at end of file
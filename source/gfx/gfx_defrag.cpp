@@ -0,0 +1,482 @@
+#include "gfx/gfx_defrag.h"
+#include "gfx/gfx_objects.h"
+#include <unordered_map>
+#include <unordered_set>
+
+static VkImageAspectFlags aspectOfFormat(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+bool LittleGFXDefragmenter::initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    return true;
+}
+
+void LittleGFXDefragmenter::destroy()
+{
+    auto& table = gfxDevice->volkTable;
+    collectMoves(true);
+    for (auto& submission : submissions)
+    {
+        table.vkDestroyCommandPool(gfxDevice->vkDevice, submission.graphicsPool, nullptr);
+        if (submission.transferPool) table.vkDestroyCommandPool(gfxDevice->vkDevice, submission.transferPool, nullptr);
+    }
+    submissions.clear();
+    entries.clear();
+    freeHandles.clear();
+}
+
+LittleGFXMovableHandle LittleGFXDefragmenter::registerEntry(Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(defragMutex);
+    LittleGFXMovableHandle handle;
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    else
+    {
+        handle = (LittleGFXMovableHandle)entries.size();
+        entries.emplace_back();
+    }
+    entry.alive = true;
+    entries[handle] = std::move(entry);
+    return handle;
+}
+
+LittleGFXMovableHandle LittleGFXDefragmenter::RegisterBuffer(VkBuffer buffer, const VkBufferCreateInfo& createInfo,
+    const LittleGFXAllocation& allocation, LittleGFXMovePatchCallback patch)
+{
+    const VkBufferUsageFlags required = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if ((createInfo.usage & required) != required || createInfo.sharingMode != VK_SHARING_MODE_EXCLUSIVE)
+    {
+        assert(0 && "movable buffers need TRANSFER_SRC | TRANSFER_DST usage and exclusive sharing!");
+        return LITTLE_GFX_INVALID_MOVABLE_HANDLE;
+    }
+    Entry entry;
+    entry.buffer = buffer;
+    entry.bufferInfo = createInfo;
+    entry.bufferInfo.pNext = nullptr;
+    entry.allocation = allocation;
+    entry.patch = std::move(patch);
+    return registerEntry(entry);
+}
+
+LittleGFXMovableHandle LittleGFXDefragmenter::RegisterImage(VkImage image, const VkImageCreateInfo& createInfo, VkImageLayout layout,
+    const LittleGFXAllocation& allocation, LittleGFXMovePatchCallback patch)
+{
+    const VkImageUsageFlags required = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if ((createInfo.usage & required) != required || createInfo.sharingMode != VK_SHARING_MODE_EXCLUSIVE)
+    {
+        assert(0 && "movable images need TRANSFER_SRC | TRANSFER_DST usage and exclusive sharing!");
+        return LITTLE_GFX_INVALID_MOVABLE_HANDLE;
+    }
+    // 搬运之后新图像要转换回这个布局，UNDEFINED和PREINITIALIZED都不能作为屏障的目标布局
+    if (layout == VK_IMAGE_LAYOUT_UNDEFINED || layout == VK_IMAGE_LAYOUT_PREINITIALIZED)
+    {
+        assert(0 && "movable images need the real layout they stay in between frames!");
+        return LITTLE_GFX_INVALID_MOVABLE_HANDLE;
+    }
+    Entry entry;
+    entry.image = image;
+    entry.imageInfo = createInfo;
+    entry.imageInfo.pNext = nullptr;
+    entry.imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    entry.layout = layout;
+    entry.allocation = allocation;
+    entry.patch = std::move(patch);
+    return registerEntry(entry);
+}
+
+void LittleGFXDefragmenter::Unregister(LittleGFXMovableHandle handle)
+{
+    std::lock_guard<std::mutex> lock(defragMutex);
+    if (handle >= entries.size() || !entries[handle].alive) return;
+    entries[handle] = Entry();
+    freeHandles.emplace_back(handle);
+}
+
+void LittleGFXDefragmenter::collectMoves(bool waitAll)
+{
+    bool freed = false;
+    for (auto iter = inflightMoves.begin(); iter != inflightMoves.end();)
+    {
+        if (waitAll) gfxDevice->gfxQueue.Wait(iter->graphicsValue);
+        if (!gfxDevice->gfxQueue.IsComplete(iter->graphicsValue))
+        {
+            ++iter;
+            continue;
+        }
+        // 拷贝已经完成，之后的帧用的都是新资源，旧的可以销毁了
+        if (iter->oldBuffer != VK_NULL_HANDLE)
+            gfxDevice->memoryAllocator.DestroyBuffer(iter->oldBuffer, iter->oldAllocation);
+        else
+            gfxDevice->memoryAllocator.DestroyImage(iter->oldImage, iter->oldAllocation);
+        iter = inflightMoves.erase(iter);
+        freed = true;
+    }
+    if (freed) stats.freedBlocks += gfxDevice->memoryAllocator.trimEmptyBlocks();
+}
+
+bool LittleGFXDefragmenter::selectSourceBlock(uint32_t& outPool, uint32_t& outBlock)
+{
+    // 统计每个块里有多少分配是可以搬走的：登记过的资源，加上已经搬走、等待释放的旧分配。
+    // 刚搬过、拷贝还没完成的资源这一帧不算可以搬走，它们所在的块要等下一次，
+    // 否则同一批资源可能每帧都被选中来回搬运
+    std::unordered_set<LittleGFXMovableHandle> inflightHandles;
+    for (const auto& move : inflightMoves)
+    {
+        inflightHandles.insert(move.handle);
+    }
+    std::unordered_map<uint64_t, uint32_t> movableCounts;
+    std::unordered_map<uint64_t, uint32_t> registeredCounts;
+    for (LittleGFXMovableHandle handle = 0; handle < entries.size(); handle++)
+    {
+        const auto& entry = entries[handle];
+        if (!entry.alive || entry.allocation.dedicated || inflightHandles.count(handle)) continue;
+        const uint64_t key = ((uint64_t)entry.allocation.poolIndex << 32) | entry.allocation.blockIndex;
+        movableCounts[key]++;
+        registeredCounts[key]++;
+    }
+    for (const auto& move : inflightMoves)
+    {
+        movableCounts[((uint64_t)move.oldAllocation.poolIndex << 32) | move.oldAllocation.blockIndex]++;
+    }
+    auto& allocator = gfxDevice->memoryAllocator;
+    std::lock_guard<std::mutex> lock(allocator.allocatorMutex);
+    bool found = false;
+    VkDeviceSize lowestUsage = 0;
+    for (const auto& iter : registeredCounts)
+    {
+        const uint32_t poolIndex = (uint32_t)(iter.first >> 32);
+        const uint32_t blockIndex = (uint32_t)(iter.first & 0xFFFFFFFF);
+        const auto& pool = allocator.pools[poolIndex];
+        const auto& block = pool.blocks[blockIndex];
+        // 块里还有不能搬的分配时，搬了也空不出来
+        if (movableCounts[iter.first] < block.allocationCount) continue;
+        // 其他块的空闲总量要放得下这个块里的数据
+        VkDeviceSize otherFree = 0;
+        for (uint32_t i = 0; i < pool.blocks.size(); i++)
+        {
+            if (i == blockIndex || pool.blocks[i].memory == VK_NULL_HANDLE) continue;
+            otherFree += pool.blocks[i].size - pool.blocks[i].allocatedBytes;
+        }
+        if (otherFree < block.allocatedBytes) continue;
+        if (!found || block.allocatedBytes < lowestUsage)
+        {
+            found = true;
+            lowestUsage = block.allocatedBytes;
+            outPool = poolIndex;
+            outBlock = blockIndex;
+        }
+    }
+    return found;
+}
+
+bool LittleGFXDefragmenter::createMove(LittleGFXMovableHandle handle, uint32_t sourceBlock, Move& outMove)
+{
+    auto& table = gfxDevice->volkTable;
+    auto vkDevice = gfxDevice->vkDevice;
+    auto& allocator = gfxDevice->memoryAllocator;
+    const auto& entry = entries[handle];
+    outMove.handle = handle;
+    outMove.oldBuffer = entry.buffer;
+    outMove.oldImage = entry.image;
+    outMove.oldAllocation = entry.allocation;
+    VkMemoryRequirements reqs;
+    if (entry.buffer != VK_NULL_HANDLE)
+    {
+        if (table.vkCreateBuffer(vkDevice, &entry.bufferInfo, nullptr, &outMove.newBuffer) != VK_SUCCESS) return false;
+        table.vkGetBufferMemoryRequirements(vkDevice, outMove.newBuffer, &reqs);
+        if (!allocator.allocateForMove(entry.allocation.poolIndex, reqs.size, reqs.alignment, sourceBlock, outMove.newAllocation))
+        {
+            table.vkDestroyBuffer(vkDevice, outMove.newBuffer, nullptr);
+            return false;
+        }
+        table.vkBindBufferMemory(vkDevice, outMove.newBuffer, outMove.newAllocation.memory, outMove.newAllocation.offset);
+    }
+    else
+    {
+        if (table.vkCreateImage(vkDevice, &entry.imageInfo, nullptr, &outMove.newImage) != VK_SUCCESS) return false;
+        table.vkGetImageMemoryRequirements(vkDevice, outMove.newImage, &reqs);
+        if (!allocator.allocateForMove(entry.allocation.poolIndex, reqs.size, reqs.alignment, sourceBlock, outMove.newAllocation))
+        {
+            table.vkDestroyImage(vkDevice, outMove.newImage, nullptr);
+            return false;
+        }
+        table.vkBindImageMemory(vkDevice, outMove.newImage, outMove.newAllocation.memory, outMove.newAllocation.offset);
+    }
+    return true;
+}
+
+void LittleGFXDefragmenter::recordCopies(VkCommandBuffer cmd)
+{
+    auto& table = gfxDevice->volkTable;
+    for (const auto& move : frameMoves)
+    {
+        const auto& entry = entries[move.handle];
+        if (move.oldBuffer != VK_NULL_HANDLE)
+        {
+            VkBufferCopy region = {};
+            region.size = entry.bufferInfo.size;
+            table.vkCmdCopyBuffer(cmd, move.oldBuffer, move.newBuffer, 1, &region);
+            continue;
+        }
+        // 每一级mip一个拷贝区域，所有数组层一起拷贝
+        imageCopies.clear();
+        const auto& info = entry.imageInfo;
+        for (uint32_t mip = 0; mip < info.mipLevels; mip++)
+        {
+            VkImageCopy region = {};
+            region.srcSubresource.aspectMask = aspectOfFormat(info.format);
+            region.srcSubresource.mipLevel = mip;
+            region.srcSubresource.baseArrayLayer = 0;
+            region.srcSubresource.layerCount = info.arrayLayers;
+            region.dstSubresource = region.srcSubresource;
+            region.extent.width = info.extent.width >> mip ? info.extent.width >> mip : 1;
+            region.extent.height = info.extent.height >> mip ? info.extent.height >> mip : 1;
+            region.extent.depth = info.extent.depth >> mip ? info.extent.depth >> mip : 1;
+            imageCopies.emplace_back(region);
+        }
+        table.vkCmdCopyImage(cmd, move.oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            move.newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)imageCopies.size(), imageCopies.data());
+    }
+}
+
+void LittleGFXDefragmenter::recordBarriers(VkCommandBuffer cmd, BarrierPhase phase)
+{
+    bufferBarriers.clear();
+    imageBarriers.clear();
+    const uint32_t gfxFamily = gfxDevice->gfxQueue.familyIndex;
+    const uint32_t transferFamily = gfxDevice->transferQueue.familyIndex;
+    // 按阶段决定作用于旧资源还是新资源、布局怎么转换、所有权从哪里转到哪里
+    const bool onSource = phase == BarrierPhase::SourceRelease || phase == BarrierPhase::SourceAcquire || phase == BarrierPhase::LocalPreCopy;
+    const bool ownership = phase != BarrierPhase::LocalPreCopy && phase != BarrierPhase::LocalPostCopy;
+    const uint32_t srcFamily = !ownership ? VK_QUEUE_FAMILY_IGNORED : (onSource ? gfxFamily : transferFamily);
+    const uint32_t dstFamily = !ownership ? VK_QUEUE_FAMILY_IGNORED : (onSource ? transferFamily : gfxFamily);
+    VkPipelineStageFlags srcStage = 0, dstStage = 0;
+    VkAccessFlags srcAccess = 0, dstAccess = 0;
+    switch (phase)
+    {
+    case BarrierPhase::SourceRelease:
+        srcStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        srcAccess = VK_ACCESS_MEMORY_WRITE_BIT;
+        break;
+    case BarrierPhase::SourceAcquire:
+        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dstAccess = VK_ACCESS_TRANSFER_READ_BIT;
+        break;
+    case BarrierPhase::DestinationRelease:
+        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        srcAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+        break;
+    case BarrierPhase::DestinationAcquire:
+        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        dstAccess = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        break;
+    case BarrierPhase::LocalPreCopy:
+        srcStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        srcAccess = VK_ACCESS_MEMORY_WRITE_BIT;
+        dstAccess = VK_ACCESS_TRANSFER_READ_BIT;
+        break;
+    case BarrierPhase::LocalPostCopy:
+        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        srcAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+        dstAccess = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        break;
+    }
+    for (const auto& move : frameMoves)
+    {
+        const auto& entry = entries[move.handle];
+        if (move.oldBuffer != VK_NULL_HANDLE)
+        {
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = dstAccess;
+            barrier.srcQueueFamilyIndex = srcFamily;
+            barrier.dstQueueFamilyIndex = dstFamily;
+            barrier.buffer = onSource ? move.oldBuffer : move.newBuffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            bufferBarriers.emplace_back(barrier);
+            continue;
+        }
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = srcFamily;
+        barrier.dstQueueFamilyIndex = dstFamily;
+        barrier.image = onSource ? move.oldImage : move.newImage;
+        barrier.subresourceRange.aspectMask = aspectOfFormat(entry.imageInfo.format);
+        barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        // 布局转换在释放和获取两侧写成一样的
+        barrier.oldLayout = onSource ? entry.layout : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = onSource ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : entry.layout;
+        imageBarriers.emplace_back(barrier);
+        // 新图像在拷贝之前从UNDEFINED转换到TRANSFER_DST，它还没有被任何队列族拥有，不需要所有权转移
+        if (phase == BarrierPhase::SourceAcquire || phase == BarrierPhase::LocalPreCopy)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = move.newImage;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            imageBarriers.emplace_back(barrier);
+        }
+    }
+    if (bufferBarriers.empty() && imageBarriers.empty()) return;
+    gfxDevice->volkTable.vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, nullptr,
+        (uint32_t)bufferBarriers.size(), bufferBarriers.data(), (uint32_t)imageBarriers.size(), imageBarriers.data());
+}
+
+LittleGFXDefragmenter::Submission& LittleGFXDefragmenter::acquireSubmission()
+{
+    auto& table = gfxDevice->volkTable;
+    for (auto& submission : submissions)
+    {
+        if (gfxDevice->gfxQueue.IsComplete(submission.graphicsValue))
+        {
+            table.vkResetCommandPool(gfxDevice->vkDevice, submission.graphicsPool, 0);
+            if (submission.transferPool) table.vkResetCommandPool(gfxDevice->vkDevice, submission.transferPool, 0);
+            return submission;
+        }
+    }
+    submissions.emplace_back();
+    auto& submission = submissions.back();
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = gfxDevice->gfxQueue.familyIndex;
+    table.vkCreateCommandPool(gfxDevice->vkDevice, &poolInfo, nullptr, &submission.graphicsPool);
+    VkCommandBuffer graphicsCommands[2];
+    VkCommandBufferAllocateInfo cmdInfo = {};
+    cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdInfo.commandPool = submission.graphicsPool;
+    cmdInfo.commandBufferCount = 2;
+    table.vkAllocateCommandBuffers(gfxDevice->vkDevice, &cmdInfo, graphicsCommands);
+    submission.releaseCommands = graphicsCommands[0];
+    submission.acquireCommands = graphicsCommands[1];
+    if (gfxDevice->HasDedicatedTransferQueue())
+    {
+        poolInfo.queueFamilyIndex = gfxDevice->transferQueue.familyIndex;
+        table.vkCreateCommandPool(gfxDevice->vkDevice, &poolInfo, nullptr, &submission.transferPool);
+        cmdInfo.commandPool = submission.transferPool;
+        cmdInfo.commandBufferCount = 1;
+        table.vkAllocateCommandBuffers(gfxDevice->vkDevice, &cmdInfo, &submission.transferCommands);
+    }
+    return submission;
+}
+
+void LittleGFXDefragmenter::update()
+{
+    std::lock_guard<std::mutex> lock(defragMutex);
+    collectMoves(false);
+    if (frameBudget == 0) return;
+    uint32_t sourcePool = 0, sourceBlock = 0;
+    if (!selectSourceBlock(sourcePool, sourceBlock)) return;
+    // 在预算内把源块里的资源逐个搬走，剩下的留给之后的帧
+    VkDeviceSize movedBytes = 0;
+    frameMoves.clear();
+    for (LittleGFXMovableHandle handle = 0; handle < entries.size() && movedBytes < frameBudget; handle++)
+    {
+        const auto& entry = entries[handle];
+        if (!entry.alive || entry.allocation.dedicated) continue;
+        if (entry.allocation.poolIndex != sourcePool || entry.allocation.blockIndex != sourceBlock) continue;
+        Move move;
+        if (!createMove(handle, sourceBlock, move)) break;
+        movedBytes += move.oldAllocation.size;
+        frameMoves.emplace_back(move);
+    }
+    if (frameMoves.empty()) return;
+    auto& table = gfxDevice->volkTable;
+    auto& submission = acquireSubmission();
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    LittleGFXSubmitDesc submitDesc = {};
+    submitDesc.commandBufferCount = 1;
+    if (gfxDevice->HasDedicatedTransferQueue())
+    {
+        // graphics释放旧资源 -> 传输队列获取、拷贝、释放新资源 -> graphics获取新资源
+        table.vkBeginCommandBuffer(submission.releaseCommands, &beginInfo);
+        recordBarriers(submission.releaseCommands, BarrierPhase::SourceRelease);
+        table.vkEndCommandBuffer(submission.releaseCommands);
+        submitDesc.commandBuffers = &submission.releaseCommands;
+        LittleGFXQueueWait releaseWait;
+        releaseWait.queue = &gfxDevice->gfxQueue;
+        releaseWait.value = gfxDevice->gfxQueue.Enqueue(submitDesc);
+        // 依赖链上的每一段都立刻提交，保证等待总是排在对应的signal之后
+        gfxDevice->gfxQueue.Flush();
+        table.vkBeginCommandBuffer(submission.transferCommands, &beginInfo);
+        recordBarriers(submission.transferCommands, BarrierPhase::SourceAcquire);
+        recordCopies(submission.transferCommands);
+        recordBarriers(submission.transferCommands, BarrierPhase::DestinationRelease);
+        table.vkEndCommandBuffer(submission.transferCommands);
+        submitDesc.commandBuffers = &submission.transferCommands;
+        submitDesc.waits = &releaseWait;
+        submitDesc.waitCount = 1;
+        LittleGFXQueueWait transferWait;
+        transferWait.queue = &gfxDevice->transferQueue;
+        transferWait.value = gfxDevice->transferQueue.Enqueue(submitDesc);
+        gfxDevice->transferQueue.Flush();
+        table.vkBeginCommandBuffer(submission.acquireCommands, &beginInfo);
+        recordBarriers(submission.acquireCommands, BarrierPhase::DestinationAcquire);
+        table.vkEndCommandBuffer(submission.acquireCommands);
+        submitDesc.commandBuffers = &submission.acquireCommands;
+        submitDesc.waits = &transferWait;
+        submission.graphicsValue = gfxDevice->gfxQueue.Enqueue(submitDesc);
+    }
+    else
+    {
+        table.vkBeginCommandBuffer(submission.acquireCommands, &beginInfo);
+        recordBarriers(submission.acquireCommands, BarrierPhase::LocalPreCopy);
+        recordCopies(submission.acquireCommands);
+        recordBarriers(submission.acquireCommands, BarrierPhase::LocalPostCopy);
+        table.vkEndCommandBuffer(submission.acquireCommands);
+        submitDesc.commandBuffers = &submission.acquireCommands;
+        submission.graphicsValue = gfxDevice->gfxQueue.Enqueue(submitDesc);
+    }
+    // 获取新资源的屏障排在这一帧的命令之前，所以从这一帧开始就可以直接使用新资源
+    for (auto& move : frameMoves)
+    {
+        auto& entry = entries[move.handle];
+        entry.buffer = move.newBuffer;
+        entry.image = move.newImage;
+        entry.allocation = move.newAllocation;
+        if (entry.patch) entry.patch(move.newBuffer, move.newImage, move.newAllocation);
+        move.graphicsValue = submission.graphicsValue;
+        stats.movedCount++;
+        stats.movedBytes += move.oldAllocation.size;
+        inflightMoves.emplace_back(move);
+    }
+    frameMoves.clear();
+}
\ No newline at end of file
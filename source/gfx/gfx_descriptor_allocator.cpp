@@ -0,0 +1,153 @@
+#include "gfx/gfx_descriptor_allocator.h"
+#include "gfx/gfx_objects.h"
+
+// 每个池里各类描述符的容量相对于描述符集数量的比例，按常见材质和后处理的用量估计
+static const struct {
+    VkDescriptorType type;
+    float ratio;
+} poolRatios[] = {
+    { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.f },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1.f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1.f },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.f },
+    { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f },
+    // 着色器反射也会产出加速结构，光追的TLAS一般每帧只绑定一两个
+    { VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 0.1f }
+};
+
+bool LittleGFXDescriptorAllocator::initialize(LittleGFXDevice* device, uint32_t partitionCount)
+{
+    gfxDevice = device;
+    accelerationStructureEnabled = device->gfxAdapter->isExtensionEnabled(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
+    partitions.resize(partitionCount);
+    currentPartition = 0;
+    // 第一帧之前也可以分配，所以先给当前分区准备好一个池
+    if (acquirePool() == VK_NULL_HANDLE)
+    {
+        assert(0 && "fatal: create descriptor pool failed!");
+        return false;
+    }
+    return true;
+}
+
+void LittleGFXDescriptorAllocator::destroy()
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    auto& table = gfxDevice->volkTable;
+    for (auto& partition : partitions)
+    {
+        for (auto pool : partition.pools)
+        {
+            table.vkDestroyDescriptorPool(gfxDevice->vkDevice, pool, nullptr);
+        }
+    }
+    for (auto pool : freePools)
+    {
+        table.vkDestroyDescriptorPool(gfxDevice->vkDevice, pool, nullptr);
+    }
+    partitions.clear();
+    freePools.clear();
+    poolCount = 0;
+}
+
+VkDescriptorPool LittleGFXDescriptorAllocator::acquirePool()
+{
+    auto& partition = partitions[currentPartition];
+    if (!freePools.empty())
+    {
+        partition.pools.emplace_back(freePools.back());
+        freePools.pop_back();
+        return partition.pools.back();
+    }
+    VkDescriptorPoolSize poolSizes[sizeof(poolRatios) / sizeof(poolRatios[0])];
+    uint32_t poolSizeCount = 0;
+    for (uint32_t i = 0; i < sizeof(poolRatios) / sizeof(poolRatios[0]); i++)
+    {
+        if (poolRatios[i].type == VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR && !accelerationStructureEnabled) continue;
+        poolSizes[poolSizeCount].type = poolRatios[i].type;
+        poolSizes[poolSizeCount].descriptorCount = (uint32_t)(poolRatios[i].ratio * LITTLE_GFX_DESCRIPTOR_POOL_SETS);
+        poolSizeCount++;
+    }
+    // 不带FREE_DESCRIPTOR_SET_BIT，驱动可以用最简单的线性分配来实现这个池
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = LITTLE_GFX_DESCRIPTOR_POOL_SETS;
+    poolInfo.poolSizeCount = poolSizeCount;
+    poolInfo.pPoolSizes = poolSizes;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    if (gfxDevice->volkTable.vkCreateDescriptorPool(gfxDevice->vkDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    poolCount++;
+    partition.pools.emplace_back(pool);
+    return pool;
+}
+
+void LittleGFXDescriptorAllocator::beginFrame()
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    currentPartition = (currentPartition + 1) % (uint32_t)partitions.size();
+    auto& partition = partitions[currentPartition];
+    // 分区数和帧环的槽位数相同，窗口在BeginFrame里已经等过这个值了，这里不会阻塞
+    gfxDevice->gfxQueue.Wait(partition.timelineValue);
+    // 整个池一次重置，池里分配过的描述符集全部作废，不需要逐个vkFreeDescriptorSets
+    for (auto pool : partition.pools)
+    {
+        gfxDevice->volkTable.vkResetDescriptorPool(gfxDevice->vkDevice, pool, 0);
+        freePools.emplace_back(pool);
+    }
+    partition.pools.clear();
+    frameSetCount = 0;
+    acquirePool();
+}
+
+void LittleGFXDescriptorAllocator::endFrame(uint64_t timelineValue)
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    partitions[currentPartition].timelineValue = timelineValue;
+}
+
+bool LittleGFXDescriptorAllocator::Allocate(const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* outSets)
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    auto& partition = partitions[currentPartition];
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = count;
+    allocInfo.pSetLayouts = layouts;
+    // 当前池放不下时换一个新池重试一次，新池仍然放不下说明这批集合超过了单个池的容量
+    for (uint32_t attempt = 0; attempt < 2; attempt++)
+    {
+        allocInfo.descriptorPool = partition.pools.empty() ? acquirePool() : partition.pools.back();
+        if (allocInfo.descriptorPool == VK_NULL_HANDLE) break;
+        VkResult res = gfxDevice->volkTable.vkAllocateDescriptorSets(gfxDevice->vkDevice, &allocInfo, outSets);
+        if (res == VK_SUCCESS)
+        {
+            frameSetCount += count;
+            return true;
+        }
+        if (res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL) break;
+        // 只在两次尝试之间换池，最后一次失败之后再换只会留下一个空池
+        if (attempt == 0 && acquirePool() == VK_NULL_HANDLE) break;
+    }
+    assert(0 && "allocate descriptor sets failed!");
+    return false;
+}
+
+VkDescriptorSet LittleGFXDescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    if (!Allocate(&layout, 1, &descriptorSet)) return VK_NULL_HANDLE;
+    return descriptorSet;
+}
+
+uint32_t LittleGFXDescriptorAllocator::GetPoolCount()
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    return poolCount;
+}
\ No newline at end of file
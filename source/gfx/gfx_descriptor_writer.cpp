@@ -0,0 +1,168 @@
+#include "gfx/gfx_descriptor_writer.h"
+#include "gfx/gfx_objects.h"
+
+// 一个描述符元素在模板数据里占用的记录大小
+static uint32_t descriptorRecordSize(VkDescriptorType type)
+{
+    switch (type)
+    {
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        return sizeof(VkDescriptorBufferInfo);
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+        return sizeof(VkBufferView);
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+        return sizeof(VkAccelerationStructureKHR);
+    default:
+        return sizeof(VkDescriptorImageInfo);
+    }
+}
+
+bool LittleGFXDescriptorWriter::initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    return true;
+}
+
+void LittleGFXDescriptorWriter::destroy()
+{
+    std::lock_guard<std::mutex> lock(templateMutex);
+    for (auto& iter : templates)
+    {
+        gfxDevice->volkTable.vkDestroyDescriptorUpdateTemplate(gfxDevice->vkDevice, iter.second->updateTemplate, nullptr);
+    }
+    templates.clear();
+    for (auto& iter : pushTemplates)
+    {
+        gfxDevice->volkTable.vkDestroyDescriptorUpdateTemplate(gfxDevice->vkDevice, iter.second->updateTemplate, nullptr);
+    }
+    pushTemplates.clear();
+}
+
+uint32_t LittleGFXDescriptorWriter::buildEntries(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+    std::vector<VkDescriptorUpdateTemplateEntry>& outEntries, std::vector<uint32_t>& outBindingOffsets)
+{
+    uint32_t offset = 0;
+    for (const auto& binding : bindings)
+    {
+        // 不定长的数组属于无绑定堆，由它自己写入
+        if (binding.descriptorCount == 0) continue;
+        const uint32_t stride = descriptorRecordSize(binding.descriptorType);
+        VkDescriptorUpdateTemplateEntry entry = {};
+        entry.dstBinding = binding.binding;
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = binding.descriptorCount;
+        entry.descriptorType = binding.descriptorType;
+        entry.offset = offset;
+        entry.stride = stride;
+        outEntries.emplace_back(entry);
+        if (outBindingOffsets.size() <= binding.binding) outBindingOffsets.resize(binding.binding + 1, UINT32_MAX);
+        outBindingOffsets[binding.binding] = offset;
+        offset += stride * binding.descriptorCount;
+    }
+    return offset;
+}
+
+const LittleGFXDescriptorTemplate* LittleGFXDescriptorWriter::GetTemplate(const LittleGFXPipelineLayout* layout, uint32_t set)
+{
+    if (layout == nullptr || set >= layout->setLayouts.size()) return nullptr;
+    return GetTemplate(layout->setLayouts[set], layout->setBindings[set]);
+}
+
+const LittleGFXDescriptorTemplate* LittleGFXDescriptorWriter::GetTemplate(VkDescriptorSetLayout setLayout,
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    std::lock_guard<std::mutex> lock(templateMutex);
+    auto iter = templates.find(setLayout);
+    if (iter != templates.end()) return iter->second.get();
+    auto descriptorTemplate = std::make_unique<LittleGFXDescriptorTemplate>();
+    descriptorTemplate->setLayout = setLayout;
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    descriptorTemplate->dataSize = buildEntries(bindings, entries, descriptorTemplate->bindingOffsets);
+    // descriptorUpdateEntryCount必须大于0，空集合只需要分配出来，不需要写
+    if (entries.empty()) return templates.emplace(setLayout, std::move(descriptorTemplate)).first->second.get();
+    VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+    templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.descriptorUpdateEntryCount = (uint32_t)entries.size();
+    templateInfo.pDescriptorUpdateEntries = entries.data();
+    templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    templateInfo.descriptorSetLayout = setLayout;
+    if (gfxDevice->volkTable.vkCreateDescriptorUpdateTemplate(gfxDevice->vkDevice, &templateInfo, nullptr,
+        &descriptorTemplate->updateTemplate) != VK_SUCCESS)
+    {
+        assert(0 && "create descriptor update template failed!");
+        return nullptr;
+    }
+    return templates.emplace(setLayout, std::move(descriptorTemplate)).first->second.get();
+}
+
+void LittleGFXDescriptorWriter::Write(VkDescriptorSet descriptorSet, const LittleGFXDescriptorTemplate* descriptorTemplate,
+    const void* data)
+{
+    if (descriptorTemplate->updateTemplate == VK_NULL_HANDLE) return;
+    gfxDevice->volkTable.vkUpdateDescriptorSetWithTemplate(gfxDevice->vkDevice, descriptorSet,
+        descriptorTemplate->updateTemplate, data);
+}
+
+VkDescriptorSet LittleGFXDescriptorWriter::AllocateAndWrite(const LittleGFXDescriptorTemplate* descriptorTemplate,
+    const void* data)
+{
+    VkDescriptorSet descriptorSet = gfxDevice->descriptorAllocator.Allocate(descriptorTemplate->setLayout);
+    if (descriptorSet == VK_NULL_HANDLE) return VK_NULL_HANDLE;
+    Write(descriptorSet, descriptorTemplate, data);
+    return descriptorSet;
+}
+
+const LittleGFXDescriptorTemplate* LittleGFXDescriptorWriter::getPushTemplate(VkPipelineBindPoint bindPoint,
+    const LittleGFXPipelineLayout* layout, uint32_t set)
+{
+    std::string key((const char*)&layout->layout, sizeof(layout->layout));
+    key.append((const char*)&set, sizeof(set));
+    key.append((const char*)&bindPoint, sizeof(bindPoint));
+    std::lock_guard<std::mutex> lock(templateMutex);
+    auto iter = pushTemplates.find(key);
+    if (iter != pushTemplates.end()) return iter->second.get();
+    auto descriptorTemplate = std::make_unique<LittleGFXDescriptorTemplate>();
+    descriptorTemplate->setLayout = layout->setLayouts[set];
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    descriptorTemplate->dataSize = buildEntries(layout->setBindings[set], entries, descriptorTemplate->bindingOffsets);
+    if (entries.empty()) return pushTemplates.emplace(std::move(key), std::move(descriptorTemplate)).first->second.get();
+    VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+    templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.descriptorUpdateEntryCount = (uint32_t)entries.size();
+    templateInfo.pDescriptorUpdateEntries = entries.data();
+    templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+    templateInfo.pipelineBindPoint = bindPoint;
+    templateInfo.pipelineLayout = layout->layout;
+    templateInfo.set = set;
+    if (gfxDevice->volkTable.vkCreateDescriptorUpdateTemplate(gfxDevice->vkDevice, &templateInfo, nullptr,
+        &descriptorTemplate->updateTemplate) != VK_SUCCESS)
+    {
+        assert(0 && "create push descriptor update template failed!");
+        return nullptr;
+    }
+    return pushTemplates.emplace(std::move(key), std::move(descriptorTemplate)).first->second.get();
+}
+
+void LittleGFXDescriptorWriter::Push(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, const LittleGFXPipelineLayout* layout,
+    uint32_t set, const void* data)
+{
+    if (layout == nullptr || set >= layout->setLayouts.size()) return;
+    auto& table = gfxDevice->volkTable;
+    if (layout->pushSet == set)
+    {
+        auto descriptorTemplate = getPushTemplate(bindPoint, layout, set);
+        if (descriptorTemplate && descriptorTemplate->updateTemplate != VK_NULL_HANDLE)
+            table.vkCmdPushDescriptorSetWithTemplateKHR(cmd, descriptorTemplate->updateTemplate, layout->layout, set, data);
+        return;
+    }
+    // 退回路径：普通的集合从每帧的分配器里取，命令缓冲执行完之前分区不会被重置
+    auto descriptorTemplate = GetTemplate(layout, set);
+    if (!descriptorTemplate) return;
+    VkDescriptorSet descriptorSet = AllocateAndWrite(descriptorTemplate, data);
+    if (descriptorSet == VK_NULL_HANDLE) return;
+    table.vkCmdBindDescriptorSets(cmd, bindPoint, layout->layout, set, 1, &descriptorSet, 0, nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,466 @@
+#include "gfx/gfx_memory.h"
+#include "gfx/gfx_objects.h"
+
+// 满足 (LITTLE_GFX_MIN_ALLOCATION_SIZE << order) >= size 的最小order
+static uint32_t sizeToOrder(VkDeviceSize size)
+{
+    uint32_t order = 0;
+    while (((VkDeviceSize)LITTLE_GFX_MIN_ALLOCATION_SIZE << order) < size) order++;
+    return order;
+}
+
+static VkDeviceSize orderToSize(uint32_t order)
+{
+    return (VkDeviceSize)LITTLE_GFX_MIN_ALLOCATION_SIZE << order;
+}
+
+bool LittleGFXMemoryAllocator::initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    const auto& memProps = device->gfxAdapter->vkMemoryProps;
+    for (uint32_t type = 0; type < memProps.memoryTypeCount; type++)
+    {
+        // 块大小取默认值和堆大小1/8中较小的那个，保持为2的幂，这样集成显卡上的小堆不会被一个块占满
+        const VkDeviceSize heapSize = memProps.memoryHeaps[memProps.memoryTypes[type].heapIndex].size;
+        VkDeviceSize blockSize = LITTLE_GFX_DEFAULT_BLOCK_SIZE;
+        while (blockSize > LITTLE_GFX_MIN_ALLOCATION_SIZE && blockSize > heapSize / 8) blockSize >>= 1;
+        for (uint32_t linear = 0; linear < 2; linear++)
+        {
+            auto& pool = pools[type * 2 + linear];
+            pool.memoryTypeIndex = type;
+            pool.blockSize = blockSize;
+            pool.maxOrder = sizeToOrder(blockSize);
+        }
+    }
+    return true;
+}
+
+void LittleGFXMemoryAllocator::destroy()
+{
+    for (auto& pool : pools)
+    {
+        for (auto& block : pool.blocks)
+        {
+            destroyBlock(block);
+        }
+        pool.blocks.clear();
+    }
+    // 拥有者没有释放的独占分配也不能留给驱动去回收
+    for (auto memory : dedicatedMemories)
+    {
+        gfxDevice->volkTable.vkFreeMemory(gfxDevice->vkDevice, memory, nullptr);
+    }
+    dedicatedMemories.clear();
+    dedicatedCount = 0;
+}
+
+uint32_t LittleGFXMemoryAllocator::GetMemoryTypeHeap(uint32_t memoryTypeIndex) const
+{
+    return gfxDevice->gfxAdapter->vkMemoryProps.memoryTypes[memoryTypeIndex].heapIndex;
+}
+
+bool LittleGFXMemoryAllocator::selectMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, uint32_t& outTypeIndex) const
+{
+    // 先找同时满足required和preferred的类型，找不到再退而求其次
+    if (gfxDevice->gfxAdapter->findMemoryType(typeBits, required | preferred, outTypeIndex)) return true;
+    return gfxDevice->gfxAdapter->findMemoryType(typeBits, required, outTypeIndex);
+}
+
+bool LittleGFXMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, bool linear, LittleGFXAllocation& outAllocation)
+{
+    return allocate(requirements, required, preferred, linear, VK_NULL_HANDLE, VK_NULL_HANDLE, outAllocation);
+}
+
+bool LittleGFXMemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, bool linear, VkBuffer dedicatedBuffer, VkImage dedicatedImage, LittleGFXAllocation& outAllocation)
+{
+    uint32_t typeIndex = 0;
+    if (!selectMemoryType(requirements.memoryTypeBits, required, preferred, typeIndex)) return false;
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    const uint32_t poolIndex = typeIndex * 2 + (linear ? 1 : 0);
+    auto& pool = pools[poolIndex];
+    // 超过块大小一半的分配用伙伴算法取整会浪费太多，驱动要求独占的资源也单独分配
+    const bool wantsDedicated = dedicatedBuffer != VK_NULL_HANDLE || dedicatedImage != VK_NULL_HANDLE;
+    if (wantsDedicated || requirements.size > pool.blockSize / 2)
+    {
+        if (!allocateDedicated(requirements, typeIndex, dedicatedBuffer, dedicatedImage, outAllocation)) return false;
+    }
+    else if (!allocateFromPool(pool, requirements.size, requirements.alignment, outAllocation))
+    {
+        return false;
+    }
+    outAllocation.poolIndex = poolIndex;
+    outAllocation.memoryTypeIndex = typeIndex;
+    outAllocation.size = requirements.size;
+    usedBytes[GetMemoryTypeHeap(typeIndex)] += requirements.size;
+    return true;
+}
+
+bool LittleGFXMemoryAllocator::allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex,
+    VkBuffer dedicatedBuffer, VkImage dedicatedImage, LittleGFXAllocation& outAllocation)
+{
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.buffer = dedicatedBuffer;
+    dedicatedInfo.image = dedicatedImage;
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = (dedicatedBuffer != VK_NULL_HANDLE || dedicatedImage != VK_NULL_HANDLE) ? &dedicatedInfo : nullptr;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (gfxDevice->volkTable.vkAllocateMemory(gfxDevice->vkDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        return false;
+    }
+    outAllocation = LittleGFXAllocation();
+    outAllocation.memory = memory;
+    outAllocation.offset = 0;
+    outAllocation.dedicated = true;
+    outAllocation.mappedData = mapMemory(memory, memoryTypeIndex);
+    dedicatedMemories.insert(memory);
+    const uint32_t heap = GetMemoryTypeHeap(memoryTypeIndex);
+    dedicatedBytes[heap] += requirements.size;
+    dedicatedUsedBytes[heap] += requirements.size;
+    dedicatedCount++;
+    return true;
+}
+
+bool LittleGFXMemoryAllocator::allocateFromPool(Pool& pool, VkDeviceSize size, VkDeviceSize alignment,
+    LittleGFXAllocation& outAllocation, uint32_t excludeBlock)
+{
+    // 伙伴块的偏移总是自身大小的整数倍，所以只要取整后的大小不小于对齐要求，对齐就自动满足了
+    VkDeviceSize needed = size > alignment ? size : alignment;
+    const uint32_t order = sizeToOrder(needed);
+    const bool defragMove = excludeBlock != UINT32_MAX;
+    uint32_t blockIndex = UINT32_MAX;
+    uint32_t freeOrder = 0;
+    for (uint32_t i = 0; i < pool.blocks.size(); i++)
+    {
+        auto& block = pool.blocks[i];
+        if (block.memory == VK_NULL_HANDLE || i == excludeBlock) continue;
+        // 找到一个不小于需求的空闲块
+        uint32_t k = order;
+        while (k <= pool.maxOrder && block.freeLists[k].empty()) k++;
+        if (k > pool.maxOrder) continue;
+        // 碎片整理时挑最满的块，把数据尽量压实到少数几个块里；平时第一个放得下的就行
+        if (blockIndex != UINT32_MAX && (!defragMove || block.allocatedBytes <= pool.blocks[blockIndex].allocatedBytes)) continue;
+        blockIndex = i;
+        freeOrder = k;
+        if (!defragMove) break;
+    }
+    VkDeviceSize offset = 0;
+    if (blockIndex != UINT32_MAX)
+    {
+        auto& block = pool.blocks[blockIndex];
+        uint32_t k = freeOrder;
+        offset = *block.freeLists[k].begin();
+        block.freeLists[k].erase(block.freeLists[k].begin());
+        // 把多余的部分逐级拆成伙伴放回空闲链表
+        while (k > order)
+        {
+            k--;
+            block.freeLists[k].insert(offset + orderToSize(k));
+        }
+    }
+    else
+    {
+        // 碎片整理不能为了搬运而申请新的块，否则就失去了意义
+        if (defragMove || !createBlock(pool, blockIndex)) return false;
+        auto& block = pool.blocks[blockIndex];
+        uint32_t k = pool.maxOrder;
+        block.freeLists[k].clear();
+        offset = 0;
+        while (k > order)
+        {
+            k--;
+            block.freeLists[k].insert(orderToSize(k));
+        }
+    }
+    auto& block = pool.blocks[blockIndex];
+    block.allocatedBytes += orderToSize(order);
+    block.allocationCount++;
+    outAllocation = LittleGFXAllocation();
+    outAllocation.memory = block.memory;
+    outAllocation.offset = offset;
+    outAllocation.blockIndex = blockIndex;
+    outAllocation.order = order;
+    outAllocation.mappedData = block.mappedData ? (uint8_t*)block.mappedData + offset : nullptr;
+    return true;
+}
+
+bool LittleGFXMemoryAllocator::createBlock(Pool& pool, uint32_t& outBlockIndex)
+{
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = pool.blockSize;
+    allocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (gfxDevice->volkTable.vkAllocateMemory(gfxDevice->vkDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        return false;
+    }
+    // 优先复用之前被释放掉的槽位
+    outBlockIndex = (uint32_t)pool.blocks.size();
+    for (uint32_t i = 0; i < pool.blocks.size(); i++)
+    {
+        if (pool.blocks[i].memory == VK_NULL_HANDLE)
+        {
+            outBlockIndex = i;
+            break;
+        }
+    }
+    if (outBlockIndex == pool.blocks.size()) pool.blocks.emplace_back();
+    auto& block = pool.blocks[outBlockIndex];
+    block.memory = memory;
+    block.size = pool.blockSize;
+    block.allocatedBytes = 0;
+    block.allocationCount = 0;
+    block.mappedData = mapMemory(memory, pool.memoryTypeIndex);
+    block.freeLists.clear();
+    block.freeLists.resize(pool.maxOrder + 1);
+    block.freeLists[pool.maxOrder].insert(0);
+    return true;
+}
+
+void LittleGFXMemoryAllocator::destroyBlock(Block& block)
+{
+    if (block.memory == VK_NULL_HANDLE) return;
+    // 释放VkDeviceMemory会隐式地解除映射
+    gfxDevice->volkTable.vkFreeMemory(gfxDevice->vkDevice, block.memory, nullptr);
+    block.memory = VK_NULL_HANDLE;
+    block.mappedData = nullptr;
+    block.size = 0;
+    block.freeLists.clear();
+}
+
+void* LittleGFXMemoryAllocator::mapMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex)
+{
+    const auto flags = gfxDevice->gfxAdapter->vkMemoryProps.memoryTypes[memoryTypeIndex].propertyFlags;
+    if (!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) return nullptr;
+    // 整块持久映射，之后的子分配只需要做指针偏移，不再有map/unmap的开销
+    void* data = nullptr;
+    gfxDevice->volkTable.vkMapMemory(gfxDevice->vkDevice, memory, 0, VK_WHOLE_SIZE, 0, &data);
+    return data;
+}
+
+void LittleGFXMemoryAllocator::syncMappedRange(const LittleGFXAllocation& allocation, VkDeviceSize offset,
+    VkDeviceSize size, bool flush)
+{
+    if (allocation.memory == VK_NULL_HANDLE || allocation.mappedData == nullptr) return;
+    const auto& adapter = *gfxDevice->gfxAdapter;
+    if (adapter.vkMemoryProps.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) return;
+    if (size == VK_WHOLE_SIZE) size = allocation.size - offset;
+    VkDeviceSize atom = adapter.vkPhysDeviceProps.properties.limits.nonCoherentAtomSize;
+    if (atom == 0) atom = 1;
+    // 伙伴块的偏移是自身大小的整数倍，而且不小于256，nonCoherentAtomSize也不超过256，
+    // 所以扩展之后的范围不会碰到相邻的分配；超出整块内存末尾时改用VK_WHOLE_SIZE
+    const VkDeviceSize begin = (allocation.offset + offset) / atom * atom;
+    const VkDeviceSize end = (allocation.offset + offset + size + atom - 1) / atom * atom;
+    const VkDeviceSize memorySize = allocation.dedicated ? allocation.size : pools[allocation.poolIndex].blockSize;
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = begin;
+    range.size = end >= memorySize ? VK_WHOLE_SIZE : end - begin;
+    if (flush)
+        gfxDevice->volkTable.vkFlushMappedMemoryRanges(gfxDevice->vkDevice, 1, &range);
+    else
+        gfxDevice->volkTable.vkInvalidateMappedMemoryRanges(gfxDevice->vkDevice, 1, &range);
+}
+
+void LittleGFXMemoryAllocator::Flush(const LittleGFXAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    syncMappedRange(allocation, offset, size, true);
+}
+
+void LittleGFXMemoryAllocator::Invalidate(const LittleGFXAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    syncMappedRange(allocation, offset, size, false);
+}
+
+bool LittleGFXMemoryAllocator::allocateForMove(uint32_t poolIndex, VkDeviceSize size, VkDeviceSize alignment,
+    uint32_t excludeBlock, LittleGFXAllocation& outAllocation)
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    auto& pool = pools[poolIndex];
+    if (!allocateFromPool(pool, size, alignment, outAllocation, excludeBlock)) return false;
+    outAllocation.poolIndex = poolIndex;
+    outAllocation.memoryTypeIndex = pool.memoryTypeIndex;
+    outAllocation.size = size;
+    usedBytes[GetMemoryTypeHeap(pool.memoryTypeIndex)] += size;
+    return true;
+}
+
+uint32_t LittleGFXMemoryAllocator::trimEmptyBlocks()
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    uint32_t freedCount = 0;
+    for (auto& pool : pools)
+    {
+        for (auto& block : pool.blocks)
+        {
+            if (block.memory == VK_NULL_HANDLE || block.allocationCount != 0) continue;
+            destroyBlock(block);
+            freedCount++;
+        }
+    }
+    return freedCount;
+}
+
+void LittleGFXMemoryAllocator::Free(LittleGFXAllocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) return;
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    const uint32_t heap = GetMemoryTypeHeap(allocation.memoryTypeIndex);
+    usedBytes[heap] -= allocation.size;
+    if (allocation.dedicated)
+    {
+        gfxDevice->volkTable.vkFreeMemory(gfxDevice->vkDevice, allocation.memory, nullptr);
+        dedicatedMemories.erase(allocation.memory);
+        dedicatedBytes[heap] -= allocation.size;
+        dedicatedUsedBytes[heap] -= allocation.size;
+        dedicatedCount--;
+        allocation = LittleGFXAllocation();
+        return;
+    }
+    auto& pool = pools[allocation.poolIndex];
+    auto& block = pool.blocks[allocation.blockIndex];
+    VkDeviceSize offset = allocation.offset;
+    uint32_t order = allocation.order;
+    block.allocatedBytes -= orderToSize(order);
+    block.allocationCount--;
+    // 伙伴也空闲时就合并成上一级的块，直到伙伴被占用或者合并成整块
+    while (order < pool.maxOrder)
+    {
+        const VkDeviceSize buddy = offset ^ orderToSize(order);
+        auto iter = block.freeLists[order].find(buddy);
+        if (iter == block.freeLists[order].end()) break;
+        block.freeLists[order].erase(iter);
+        offset = offset < buddy ? offset : buddy;
+        order++;
+    }
+    block.freeLists[order].insert(offset);
+    // 池子里保留一个空块以免分配释放反复触发vkAllocateMemory，多余的空块还给驱动
+    if (block.allocationCount == 0)
+    {
+        for (uint32_t i = 0; i < pool.blocks.size(); i++)
+        {
+            const auto& other = pool.blocks[i];
+            if (i != allocation.blockIndex && other.memory != VK_NULL_HANDLE && other.allocationCount == 0)
+            {
+                destroyBlock(block);
+                break;
+            }
+        }
+    }
+    allocation = LittleGFXAllocation();
+}
+
+bool LittleGFXMemoryAllocator::CreateBuffer(const VkBufferCreateInfo& bufferInfo, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, VkBuffer& outBuffer, LittleGFXAllocation& outAllocation)
+{
+    auto& table = gfxDevice->volkTable;
+    if (table.vkCreateBuffer(gfxDevice->vkDevice, &bufferInfo, nullptr, &outBuffer) != VK_SUCCESS) return false;
+    // 通过Requirements2顺便问一下驱动是否希望这个资源独占一块内存
+    VkMemoryDedicatedRequirements dedicatedReqs = {};
+    dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 requirements = {};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicatedReqs;
+    VkBufferMemoryRequirementsInfo2 requirementsInfo = {};
+    requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    requirementsInfo.buffer = outBuffer;
+    table.vkGetBufferMemoryRequirements2(gfxDevice->vkDevice, &requirementsInfo, &requirements);
+    const VkBuffer dedicated = dedicatedReqs.prefersDedicatedAllocation ? outBuffer : VK_NULL_HANDLE;
+    if (!allocate(requirements.memoryRequirements, required, preferred, true, dedicated, VK_NULL_HANDLE, outAllocation))
+    {
+        table.vkDestroyBuffer(gfxDevice->vkDevice, outBuffer, nullptr);
+        outBuffer = VK_NULL_HANDLE;
+        return false;
+    }
+    table.vkBindBufferMemory(gfxDevice->vkDevice, outBuffer, outAllocation.memory, outAllocation.offset);
+    return true;
+}
+
+bool LittleGFXMemoryAllocator::CreateImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, VkImage& outImage, LittleGFXAllocation& outAllocation)
+{
+    auto& table = gfxDevice->volkTable;
+    if (table.vkCreateImage(gfxDevice->vkDevice, &imageInfo, nullptr, &outImage) != VK_SUCCESS) return false;
+    VkMemoryDedicatedRequirements dedicatedReqs = {};
+    dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 requirements = {};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicatedReqs;
+    VkImageMemoryRequirementsInfo2 requirementsInfo = {};
+    requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    requirementsInfo.image = outImage;
+    table.vkGetImageMemoryRequirements2(gfxDevice->vkDevice, &requirementsInfo, &requirements);
+    const VkImage dedicated = dedicatedReqs.prefersDedicatedAllocation ? outImage : VK_NULL_HANDLE;
+    const bool linear = imageInfo.tiling == VK_IMAGE_TILING_LINEAR;
+    if (!allocate(requirements.memoryRequirements, required, preferred, linear, VK_NULL_HANDLE, dedicated, outAllocation))
+    {
+        table.vkDestroyImage(gfxDevice->vkDevice, outImage, nullptr);
+        outImage = VK_NULL_HANDLE;
+        return false;
+    }
+    table.vkBindImageMemory(gfxDevice->vkDevice, outImage, outAllocation.memory, outAllocation.offset);
+    return true;
+}
+
+void LittleGFXMemoryAllocator::DestroyBuffer(VkBuffer buffer, LittleGFXAllocation& allocation)
+{
+    if (buffer != VK_NULL_HANDLE) gfxDevice->volkTable.vkDestroyBuffer(gfxDevice->vkDevice, buffer, nullptr);
+    Free(allocation);
+}
+
+void LittleGFXMemoryAllocator::DestroyImage(VkImage image, LittleGFXAllocation& allocation)
+{
+    if (image != VK_NULL_HANDLE) gfxDevice->volkTable.vkDestroyImage(gfxDevice->vkDevice, image, nullptr);
+    Free(allocation);
+}
+
+LittleGFXMemoryStats LittleGFXMemoryAllocator::GetStats()
+{
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    LittleGFXMemoryStats stats;
+    for (const auto& pool : pools)
+    {
+        if (pool.blocks.empty()) continue;
+        const uint32_t heap = GetMemoryTypeHeap(pool.memoryTypeIndex);
+        for (const auto& block : pool.blocks)
+        {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            stats.blockCount++;
+            stats.allocationCount += block.allocationCount;
+            stats.committedBytes += block.size;
+            stats.allocatedBytes += block.allocatedBytes;
+            stats.freeBytes += block.size - block.allocatedBytes;
+            stats.heapCommittedBytes[heap] += block.size;
+            // 最高一级非空的空闲链表就是这个块里最大的连续空闲
+            for (uint32_t k = pool.maxOrder + 1; k > 0; k--)
+            {
+                if (!block.freeLists[k - 1].empty())
+                {
+                    if (orderToSize(k - 1) > stats.largestFreeRange) stats.largestFreeRange = orderToSize(k - 1);
+                    break;
+                }
+            }
+        }
+    }
+    for (uint32_t heap = 0; heap < VK_MAX_MEMORY_HEAPS; heap++)
+    {
+        stats.committedBytes += dedicatedBytes[heap];
+        stats.allocatedBytes += dedicatedBytes[heap];
+        stats.heapCommittedBytes[heap] += dedicatedBytes[heap];
+        stats.heapUsedBytes[heap] = usedBytes[heap];
+        stats.usedBytes += usedBytes[heap];
+    }
+    stats.dedicatedCount = dedicatedCount;
+    stats.allocationCount += dedicatedCount;
+    stats.fragmentation = stats.freeBytes > 0 ? 1.f - (float)((double)stats.largestFreeRange / (double)stats.freeBytes) : 0.f;
+    return stats;
+}
\ No newline at end of file
@@ -7,9 +7,44 @@ void LittleGFXAdapter::queryProperties()
 {
     vkPhysDeviceProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
     vkGetPhysicalDeviceProperties2(vkPhysicalDevice, &vkPhysDeviceProps);
+    vkGetPhysicalDeviceMemoryProperties(vkPhysicalDevice, &vkMemoryProps);
+    // 同样使用两段式的pNext链查询1.2的特性
+    vkSync2Features = {};
+    vkSync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    vkFeatures12 = {};
+    vkFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vkFeatures12.pNext = &vkSync2Features;
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &vkFeatures12;
+    vkGetPhysicalDeviceFeatures2(vkPhysicalDevice, &features);
+    vkFeatures12.pNext = nullptr;
+    vkSync2Features.pNext = nullptr;
     std::cout << vkPhysDeviceProps.properties.deviceName << std::endl;
 }
 
+bool LittleGFXAdapter::isExtensionEnabled(const char* extName) const
+{
+    for (auto ext : deviceExtensions)
+    {
+        if (std::string_view(ext) == std::string_view(extName)) return true;
+    }
+    return false;
+}
+
+bool LittleGFXAdapter::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags, uint32_t& outTypeIndex) const
+{
+    for (uint32_t i = 0; i < vkMemoryProps.memoryTypeCount; i++)
+    {
+        if ((typeBits & (1u << i)) && (vkMemoryProps.memoryTypes[i].propertyFlags & flags) == flags)
+        {
+            outTypeIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
 void LittleGFXAdapter::selectExtensionsAndLayers()
 {
     uint32_t ext_count = 0;
@@ -33,14 +68,27 @@ void LittleGFXAdapter::selectQueueIndices()
     vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &queueFamiliesCount, nullptr);
     std::vector<VkQueueFamilyProperties> queueProps(queueFamiliesCount);
     vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &queueFamiliesCount, queueProps.data());
+    queueFamilyProps = queueProps;
     uint32_t queueIdx = 0;
     for (auto&& queueProp : queueProps)
     {
-        // select graphics index
-        if (queueProp.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        const auto flags = queueProp.queueFlags;
+        // select graphics index，第一个支持图形的队列族一般就是驱动推荐的主队列
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && gfxQueueIndex < 0)
         {
             gfxQueueIndex = queueIdx;
         }
+        // 不支持图形的计算队列族，提交到它上面的计算可以和光栅化同时进行
+        else if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && computeQueueIndex < 0)
+        {
+            computeQueueIndex = queueIdx;
+        }
+        // 只支持传输的队列族，大块的上传走它可以不占用图形和计算引擎
+        // 规范规定支持图形或计算的队列一定隐式支持传输，所以这里不要求显式带TRANSFER_BIT
+        else if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && transferQueueIndex < 0)
+        {
+            transferQueueIndex = queueIdx;
+        }
         queueIdx++;
     }
 }
@@ -61,7 +109,8 @@ bool LittleGFXInstance::Initialize(bool enableDebugLayer)
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_1;
+    // 时间线信号量等功能在1.2进入了核心
+    appInfo.apiVersion = VK_API_VERSION_1_2;
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
@@ -128,6 +177,15 @@ void LittleGFXInstance::selectExtensionsAndLayers(bool enableDebugLayer)
     }
 }
 
+bool LittleGFXInstance::isExtensionEnabled(const char* extName) const
+{
+    for (auto ext : instanceExtensions)
+    {
+        if (std::string_view(ext) == std::string_view(extName)) return true;
+    }
+    return false;
+}
+
 void LittleGFXInstance::fetchAllAdapters()
 {
     uint32_t adapter_count = 0;
@@ -153,21 +211,69 @@ const float queuePriorities[] = {
     1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, //
     1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, //
 };
-bool LittleGFXDevice::Initialize(LittleGFXAdapter* adapter)
+bool LittleGFXDevice::Initialize(LittleGFXAdapter* adapter, uint32_t framesInFlight)
 {
     gfxAdapter = adapter;
-    // 要申请的graphics queue
-    VkDeviceQueueCreateInfo queueInfo = {};
-    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueInfo.queueCount = 1;
-    queueInfo.queueFamilyIndex = adapter->gfxQueueIndex;
-    queueInfo.pQueuePriorities = queuePriorities;
-    VkPhysicalDeviceFeatures deviceFeatures{};
+    this->framesInFlight = framesInFlight > 0 ? framesInFlight : 1;
+    // 队列的提交模型建立在时间线信号量上，它在1.2成为核心功能
+    if (adapter->vkPhysDeviceProps.properties.apiVersion < VK_API_VERSION_1_2 || !adapter->vkFeatures12.timelineSemaphore)
+    {
+        assert(0 && "Vulkan 1.2 timeline semaphores are required!");
+        return false;
+    }
+    // 要申请的graphics queue，以及存在时专用的compute和transfer queue，每个队列族各一个队列
+    std::vector<VkDeviceQueueCreateInfo> queueInfos;
+    for (auto familyIndex : { adapter->gfxQueueIndex, adapter->computeQueueIndex, adapter->transferQueueIndex })
+    {
+        if (familyIndex < 0) continue;
+        VkDeviceQueueCreateInfo queueInfo = {};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueCount = 1;
+        queueInfo.queueFamilyIndex = (uint32_t)familyIndex;
+        queueInfo.pQueuePriorities = queuePriorities;
+        queueInfos.emplace_back(queueInfo);
+    }
+    // 要打开的特性通过VkPhysicalDeviceFeatures2的pNext链传入，此时pEnabledFeatures必须为空
+    VkPhysicalDeviceVulkan12Features features12 = {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.timelineSemaphore = VK_TRUE;
+    // 无绑定描述符堆需要的描述符索引特性，在1.2成为核心功能（原先是VK_EXT_descriptor_indexing）
+    const auto& supported12 = adapter->vkFeatures12;
+    descriptorIndexingEnabled = supported12.descriptorIndexing && supported12.runtimeDescriptorArray &&
+                                supported12.descriptorBindingPartiallyBound &&
+                                supported12.descriptorBindingUpdateUnusedWhilePending &&
+                                supported12.descriptorBindingSampledImageUpdateAfterBind &&
+                                supported12.descriptorBindingStorageBufferUpdateAfterBind &&
+                                supported12.shaderSampledImageArrayNonUniformIndexing &&
+                                supported12.shaderStorageBufferArrayNonUniformIndexing;
+    if (descriptorIndexingEnabled)
+    {
+        features12.descriptorIndexing = VK_TRUE;
+        features12.runtimeDescriptorArray = VK_TRUE;
+        features12.descriptorBindingPartiallyBound = VK_TRUE;
+        features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        features12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    }
+    // 驱动支持时打开synchronization2，提交时就可以使用VkSubmitInfo2
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2Features = {};
+    sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    sync2Features.synchronization2 = VK_TRUE;
+    synchronization2Enabled = adapter->isExtensionEnabled(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) &&
+                              adapter->vkSync2Features.synchronization2;
+    if (synchronization2Enabled) features12.pNext = &sync2Features;
+    pushDescriptorEnabled = adapter->isExtensionEnabled(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+    VkPhysicalDeviceFeatures2 deviceFeatures = {};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = &features12;
     VkDeviceCreateInfo deviceInfo = {};
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceInfo.queueCreateInfoCount = 1;
-    deviceInfo.pQueueCreateInfos = &queueInfo;
-    deviceInfo.pEnabledFeatures = &deviceFeatures;
+    deviceInfo.pNext = &deviceFeatures;
+    deviceInfo.queueCreateInfoCount = (uint32_t)queueInfos.size();
+    deviceInfo.pQueueCreateInfos = queueInfos.data();
+    deviceInfo.pEnabledFeatures = nullptr;
     // 打开需要的扩展和层
     deviceInfo.enabledExtensionCount = adapter->deviceExtensions.size();
     deviceInfo.ppEnabledExtensionNames = adapter->deviceExtensions.data();
@@ -181,35 +287,701 @@ bool LittleGFXDevice::Initialize(LittleGFXAdapter* adapter)
     // 使用volk从device中读出相关的API函数地址
     // 这些API被放进volkTable中，因为转发层数很少所以性能有一定提升
     volkLoadDeviceTable(&volkTable, vkDevice);
+    // 取出创建好的队列，不存在的专用队列保持为空
+    fetchQueue(gfxQueue, adapter->gfxQueueIndex);
+    fetchQueue(computeQueue, adapter->computeQueueIndex);
+    fetchQueue(transferQueue, adapter->transferQueueIndex);
+    memoryAllocator.initialize(this);
+    ringAllocator.initialize(this, this->framesInFlight);
+    uploadManager.initialize(this);
+    residencyManager.initialize(this);
+    defragmenter.initialize(this);
+    pipelineCache.initialize(this);
+    pipelineCompiler.initialize(this);
+    shaderCache.initialize(this);
+    bindlessHeap.initialize(this);
+    descriptorAllocator.initialize(this, this->framesInFlight);
+    descriptorWriter.initialize(this);
+    commandAllocator.initialize(this, this->framesInFlight);
+    commandBundleCache.initialize(this);
+    return true;
+}
+
+void LittleGFXDevice::beginFrame()
+{
+    ringAllocator.beginFrame();
+    bindlessHeap.beginFrame();
+    descriptorAllocator.beginFrame();
+    commandAllocator.beginFrame();
+    commandBundleCache.beginFrame();
+    pipelineCompiler.beginFrame();
+    // 在录制新的一帧之前检查预算，超出时先降级/驱逐，避免这一帧的分配溢出到系统内存
+    residencyManager.update();
+    // 上一帧之后其他线程积攒的上传在这一帧的命令之前提交，这一帧就能直接使用它们
+    uploadManager.Flush();
+    // 在字节预算内搬运一部分资源，搬运的屏障同样排在这一帧的命令之前
+    defragmenter.update();
+}
+
+void LittleGFXDevice::endFrame(uint64_t gfxTimelineValue)
+{
+    ringAllocator.endFrame(gfxTimelineValue);
+    bindlessHeap.endFrame(gfxTimelineValue);
+    descriptorAllocator.endFrame(gfxTimelineValue);
+    commandAllocator.endFrame(gfxTimelineValue);
+    commandBundleCache.endFrame(gfxTimelineValue);
+    pipelineCompiler.endFrame(gfxTimelineValue);
+    residencyManager.endFrame(gfxTimelineValue);
+}
+
+void LittleGFXDevice::FlushQueues()
+{
+    // 先提交专用队列，graphics queue上的工作经常要等待它们
+    if (HasDedicatedTransferQueue()) transferQueue.Flush();
+    if (HasDedicatedComputeQueue()) computeQueue.Flush();
+    gfxQueue.Flush();
+}
+
+LittleGFXSubmitStats LittleGFXDevice::TakeSubmitStats()
+{
+    LittleGFXSubmitStats total = gfxQueue.TakeStats();
+    if (HasDedicatedComputeQueue()) total += computeQueue.TakeStats();
+    if (HasDedicatedTransferQueue()) total += transferQueue.TakeStats();
+    return total;
+}
+
+void LittleGFXDevice::fetchQueue(LittleGFXQueue& queue, int64_t familyIndex)
+{
+    queue.gfxDevice = this;
+    if (familyIndex < 0) return;
+    queue.initialize(this, (uint32_t)familyIndex, gfxAdapter->queueFamilyProps[familyIndex].queueFlags);
+}
+
+bool LittleGFXQueue::initialize(LittleGFXDevice* device, uint32_t familyIndex_, VkQueueFlags flags)
+{
+    gfxDevice = device;
+    familyIndex = familyIndex_;
+    queueFlags = flags;
+    device->volkTable.vkGetDeviceQueue(device->vkDevice, familyIndex, 0, &vkQueue);
+    // 时间线信号量从0开始，每次提交signal的值加一
+    VkSemaphoreTypeCreateInfo typeInfo = {};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    if (device->volkTable.vkCreateSemaphore(device->vkDevice, &semaphoreInfo, nullptr, &timelineSemaphore) != VK_SUCCESS)
+    {
+        assert(0 && "failed to create queue timeline semaphore!");
+        return false;
+    }
+    return true;
+}
+
+void LittleGFXQueue::destroy()
+{
+    if (timelineSemaphore == VK_NULL_HANDLE) return;
+    gfxDevice->volkTable.vkDestroySemaphore(gfxDevice->vkDevice, timelineSemaphore, nullptr);
+    timelineSemaphore = VK_NULL_HANDLE;
+}
+
+bool LittleGFXQueue::hasSameWaits(const PendingBatch& batch) const
+{
+    if (batch.waitCount != enqueueWaits.size()) return false;
+    for (const auto& wait : enqueueWaits)
+    {
+        bool found = false;
+        for (uint32_t j = batch.firstWait; j < batch.firstWait + batch.waitCount; j++)
+        {
+            const auto& other = pendingWaits[j];
+            if (other.semaphore == wait.semaphore && other.value == wait.value && other.stageMask == wait.stageMask)
+            {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+uint64_t LittleGFXQueue::Enqueue(const LittleGFXSubmitDesc& desc)
+{
+    std::lock_guard<std::mutex> lock(submitMutex);
+    stats.enqueued++;
+    enqueueWaits.clear();
+    for (uint32_t i = 0; i < desc.binaryWaitCount; i++)
+    {
+        enqueueWaits.push_back({ desc.binaryWaits[i], 0, desc.binaryWaitStages[i] });
+    }
+    for (uint32_t i = 0; i < desc.waitCount; i++)
+    {
+        const auto& wait = desc.waits[i];
+        // 对同一条时间线只需要等待最大的那个值
+        bool merged = false;
+        for (auto& pending : enqueueWaits)
+        {
+            if (pending.semaphore == wait.queue->timelineSemaphore)
+            {
+                if (wait.value > pending.value) pending.value = wait.value;
+                pending.stageMask |= wait.stageMask;
+                merged = true;
+                break;
+            }
+        }
+        if (!merged) enqueueWaits.push_back({ wait.queue->timelineSemaphore, wait.value, wait.stageMask });
+    }
+    // 等待只能加在批次的开头。当前批次已经有命令时，只有等待完全相同的提交才能并入，
+    // 否则不需要等待（或者等待更少）的命令会被别人的等待拖住，跨队列的依赖甚至可能因此死锁。
+    // 二元信号量只能被等待一次，带二元等待的提交总是另起一个批次
+    bool mergeIntoBack = !pendingBatches.empty();
+    if (mergeIntoBack && pendingBatches.back().commandBufferCount > 0)
+        mergeIntoBack = desc.binaryWaitCount == 0 && hasSameWaits(pendingBatches.back());
+    if (!mergeIntoBack)
+    {
+        PendingBatch batch = {};
+        batch.firstCommandBuffer = (uint32_t)pendingCommandBuffers.size();
+        batch.firstWait = (uint32_t)pendingWaits.size();
+        batch.firstSignal = (uint32_t)pendingBinarySignals.size();
+        batch.signalValue = lastSubmittedValue.load(std::memory_order_relaxed) + 1;
+        lastSubmittedValue.store(batch.signalValue, std::memory_order_release);
+        pendingBatches.emplace_back(batch);
+    }
+    auto& batch = pendingBatches.back();
+    // 并入已经有命令的批次时等待完全相同，不需要再追加；还没有命令的批次可以直接追加等待，
+    // 代价只是它的signal晚一点到来
+    if (batch.commandBufferCount == 0)
+    {
+        for (const auto& wait : enqueueWaits)
+        {
+            bool merged = false;
+            for (uint32_t j = batch.firstWait; j < batch.firstWait + batch.waitCount; j++)
+            {
+                auto& pending = pendingWaits[j];
+                // 二元信号量的值总是0，同一个二元信号量不会被等待两次
+                if (pending.semaphore == wait.semaphore && wait.value > 0)
+                {
+                    if (wait.value > pending.value) pending.value = wait.value;
+                    pending.stageMask |= wait.stageMask;
+                    merged = true;
+                    break;
+                }
+            }
+            if (merged) continue;
+            pendingWaits.push_back(wait);
+            batch.waitCount++;
+        }
+    }
+    for (uint32_t i = 0; i < desc.commandBufferCount; i++)
+    {
+        pendingCommandBuffers.emplace_back(desc.commandBuffers[i]);
+        batch.commandBufferCount++;
+    }
+    for (uint32_t i = 0; i < desc.binarySignalCount; i++)
+    {
+        pendingBinarySignals.emplace_back(desc.binarySignals[i]);
+        batch.signalCount++;
+    }
+    return batch.signalValue;
+}
+
+void LittleGFXQueue::Flush()
+{
+    std::lock_guard<std::mutex> lock(submitMutex);
+    flushLocked();
+}
+
+uint64_t LittleGFXQueue::Submit(const LittleGFXSubmitDesc& desc)
+{
+    uint64_t value = Enqueue(desc);
+    Flush();
+    return value;
+}
+
+LittleGFXSubmitStats LittleGFXQueue::TakeStats()
+{
+    std::lock_guard<std::mutex> lock(submitMutex);
+    auto result = stats;
+    stats = LittleGFXSubmitStats();
+    return result;
+}
+
+void LittleGFXQueue::flushLocked()
+{
+    if (pendingBatches.empty()) return;
+    if (gfxDevice->synchronization2Enabled)
+        submitBatches2();
+    else
+        submitBatchesLegacy();
+    stats.batches += pendingBatches.size();
+    stats.queueSubmits++;
+    flushedValue.store(pendingBatches.back().signalValue, std::memory_order_release);
+    pendingBatches.clear();
+    pendingCommandBuffers.clear();
+    pendingWaits.clear();
+    pendingBinarySignals.clear();
+}
+
+void LittleGFXQueue::submitBatches2()
+{
+    submitInfos2.clear();
+    semaphoreInfos.clear();
+    commandBufferInfos.clear();
+    // 先把所有数组填满再取指针，避免vector扩容让前面取到的指针失效
+    for (const auto& batch : pendingBatches)
+    {
+        for (uint32_t i = 0; i < batch.waitCount; i++)
+        {
+            const auto& wait = pendingWaits[batch.firstWait + i];
+            VkSemaphoreSubmitInfoKHR info = {};
+            info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+            info.semaphore = wait.semaphore;
+            info.value = wait.value;
+            // 老的管线阶段位在VkPipelineStageFlags2中的数值是一样的
+            info.stageMask = (VkPipelineStageFlags2KHR)wait.stageMask;
+            semaphoreInfos.emplace_back(info);
+        }
+        VkSemaphoreSubmitInfoKHR timelineSignal = {};
+        timelineSignal.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineSignal.semaphore = timelineSemaphore;
+        timelineSignal.value = batch.signalValue;
+        timelineSignal.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+        semaphoreInfos.emplace_back(timelineSignal);
+        for (uint32_t i = 0; i < batch.signalCount; i++)
+        {
+            VkSemaphoreSubmitInfoKHR info = timelineSignal;
+            info.semaphore = pendingBinarySignals[batch.firstSignal + i];
+            info.value = 0;
+            semaphoreInfos.emplace_back(info);
+        }
+        for (uint32_t i = 0; i < batch.commandBufferCount; i++)
+        {
+            VkCommandBufferSubmitInfoKHR info = {};
+            info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+            info.commandBuffer = pendingCommandBuffers[batch.firstCommandBuffer + i];
+            commandBufferInfos.emplace_back(info);
+        }
+    }
+    uint32_t semaphoreOffset = 0;
+    for (const auto& batch : pendingBatches)
+    {
+        VkSubmitInfo2KHR submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+        submitInfo.waitSemaphoreInfoCount = batch.waitCount;
+        submitInfo.pWaitSemaphoreInfos = semaphoreInfos.data() + semaphoreOffset;
+        submitInfo.commandBufferInfoCount = batch.commandBufferCount;
+        submitInfo.pCommandBufferInfos = commandBufferInfos.data() + batch.firstCommandBuffer;
+        submitInfo.signalSemaphoreInfoCount = 1 + batch.signalCount;
+        submitInfo.pSignalSemaphoreInfos = semaphoreInfos.data() + semaphoreOffset + batch.waitCount;
+        semaphoreOffset += batch.waitCount + 1 + batch.signalCount;
+        submitInfos2.emplace_back(submitInfo);
+    }
+    if (gfxDevice->volkTable.vkQueueSubmit2KHR(vkQueue, (uint32_t)submitInfos2.size(), submitInfos2.data(), VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        assert(0 && "vkQueueSubmit2 failed!");
+    }
+}
+
+void LittleGFXQueue::submitBatchesLegacy()
+{
+    submitInfos.clear();
+    timelineInfos.clear();
+    semaphores.clear();
+    semaphoreValues.clear();
+    waitStages.clear();
+    // 和submitBatches2一样，先填满数组再取指针。二元信号量的值会被忽略，但数组长度必须一致
+    for (const auto& batch : pendingBatches)
+    {
+        for (uint32_t i = 0; i < batch.waitCount; i++)
+        {
+            const auto& wait = pendingWaits[batch.firstWait + i];
+            semaphores.emplace_back(wait.semaphore);
+            semaphoreValues.emplace_back(wait.value);
+            waitStages.emplace_back(wait.stageMask);
+        }
+        semaphores.emplace_back(timelineSemaphore);
+        semaphoreValues.emplace_back(batch.signalValue);
+        for (uint32_t i = 0; i < batch.signalCount; i++)
+        {
+            semaphores.emplace_back(pendingBinarySignals[batch.firstSignal + i]);
+            semaphoreValues.emplace_back(0);
+        }
+    }
+    timelineInfos.resize(pendingBatches.size());
+    uint32_t semaphoreOffset = 0;
+    uint32_t waitOffset = 0;
+    for (uint32_t b = 0; b < pendingBatches.size(); b++)
+    {
+        const auto& batch = pendingBatches[b];
+        auto& timelineInfo = timelineInfos[b];
+        timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = batch.waitCount;
+        timelineInfo.pWaitSemaphoreValues = semaphoreValues.data() + semaphoreOffset;
+        timelineInfo.signalSemaphoreValueCount = 1 + batch.signalCount;
+        timelineInfo.pSignalSemaphoreValues = semaphoreValues.data() + semaphoreOffset + batch.waitCount;
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = batch.waitCount;
+        submitInfo.pWaitSemaphores = semaphores.data() + semaphoreOffset;
+        submitInfo.pWaitDstStageMask = waitStages.data() + waitOffset;
+        submitInfo.commandBufferCount = batch.commandBufferCount;
+        submitInfo.pCommandBuffers = pendingCommandBuffers.data() + batch.firstCommandBuffer;
+        submitInfo.signalSemaphoreCount = 1 + batch.signalCount;
+        submitInfo.pSignalSemaphores = semaphores.data() + semaphoreOffset + batch.waitCount;
+        semaphoreOffset += batch.waitCount + 1 + batch.signalCount;
+        waitOffset += batch.waitCount;
+        submitInfos.emplace_back(submitInfo);
+    }
+    if (gfxDevice->volkTable.vkQueueSubmit(vkQueue, (uint32_t)submitInfos.size(), submitInfos.data(), VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        assert(0 && "vkQueueSubmit failed!");
+    }
+}
+
+VkResult LittleGFXQueue::Present(const VkPresentInfoKHR& presentInfo)
+{
+    std::lock_guard<std::mutex> lock(submitMutex);
+    // Present等待的信号量必须已经被提交过的批次signal
+    flushLocked();
+    return gfxDevice->volkTable.vkQueuePresentKHR(vkQueue, &presentInfo);
+}
+
+uint64_t LittleGFXQueue::GetCompletedValue()
+{
+    uint64_t value = 0;
+    gfxDevice->volkTable.vkGetSemaphoreCounterValue(gfxDevice->vkDevice, timelineSemaphore, &value);
+    // 多个线程可能同时更新缓存，只允许它单调增长
+    uint64_t cached = completedValue.load(std::memory_order_relaxed);
+    while (value > cached && !completedValue.compare_exchange_weak(cached, value, std::memory_order_release)) {}
+    return value > cached ? value : cached;
+}
+
+bool LittleGFXQueue::IsComplete(uint64_t value)
+{
+    // 绝大多数查询都能被缓存值回答，不需要进入驱动
+    if (completedValue.load(std::memory_order_acquire) >= value) return true;
+    return GetCompletedValue() >= value;
+}
+
+bool LittleGFXQueue::Wait(uint64_t value, uint64_t timeoutNs)
+{
+    if (IsComplete(value)) return true;
+    // 还停留在合批器里的值永远不会被signal，先把它们提交出去
+    if (value > flushedValue.load(std::memory_order_acquire)) Flush();
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timelineSemaphore;
+    waitInfo.pValues = &value;
+    if (gfxDevice->volkTable.vkWaitSemaphores(gfxDevice->vkDevice, &waitInfo, timeoutNs) != VK_SUCCESS) return false;
+    uint64_t cached = completedValue.load(std::memory_order_relaxed);
+    while (value > cached && !completedValue.compare_exchange_weak(cached, value, std::memory_order_release)) {}
     return true;
 }
 
 bool LittleGFXDevice::Destroy()
 {
+    // 编译服务先把各线程的缓存合并进来，管线缓存再写回磁盘
+    pipelineCompiler.destroy();
+    commandBundleCache.destroy();
+    commandAllocator.destroy();
+    descriptorWriter.destroy();
+    descriptorAllocator.destroy();
+    bindlessHeap.destroy();
+    shaderCache.destroy();
+    pipelineCache.destroy();
+    defragmenter.destroy();
+    // 上传服务销毁时还要等待队列上的时间线，所以先于队列销毁
+    uploadManager.destroy();
+    residencyManager.destroy();
+    gfxQueue.destroy();
+    computeQueue.destroy();
+    transferQueue.destroy();
+    ringAllocator.destroy();
+    memoryAllocator.destroy();
     vkDestroyDevice(vkDevice, nullptr);
     return true;
 }
 
-bool LittleGFXWindow::Initialize(const wchar_t* title, LittleGFXDevice* device, bool enableVsync)
+bool LittleGFXWindow::Initialize(const wchar_t* title, LittleGFXDevice* device, LittleGFXPresentProfile profile,
+    bool headless, uint32_t framesInFlight)
 {
-    auto succeed = LittleWindow::Initialize(title);
+    auto succeed = LittleWindow::Initialize(title, headless);
     gfxDevice = device;
+    presentProfile = profile;
+    if (framesInFlight == 0) framesInFlight = device->framesInFlight;
+    if (framesInFlight > device->framesInFlight)
+    {
+        // 槽位比分配器的分区多时，分区会在GPU还在使用时被下一帧复用
+        assert(0 && "window framesInFlight exceeds the device's!");
+        framesInFlight = device->framesInFlight;
+    }
     createSurface(device->gfxAdapter->gfxInstance);
-    createSwapchainKHR(device, enableVsync);
+    offscreen = !supportsPresent(device);
+    if (!offscreen)
+    {
+        createSwapchainKHR(device);
+    }
+    else
+    {
+        // 离屏图像按帧轮流使用，没有Acquire替我们等待图像的上一个使用者，
+        // 所以图像数不能少于在途的帧数，否则两帧会同时写同一张图像
+        uint32_t imageCount = profile == LittleGFXPresentProfile::NoTearingLowLatency ? 3 : 2;
+        if (imageCount < framesInFlight) imageCount = framesInFlight;
+        createOffscreenChain(device, imageCount);
+    }
+    // 创建窗口时收到的WM_SIZE已经体现在上面创建的交换链里了
+    swapchainDirty = false;
+    createFrames(framesInFlight);
     return succeed;
 }
 
 bool LittleGFXWindow::Destroy()
 {
     auto succeed = LittleWindow::Destroy();
-    gfxDevice->volkTable.vkDestroySwapchainKHR(gfxDevice->vkDevice, vkSwapchain, nullptr);
-    vkDestroySurfaceKHR(gfxDevice->gfxAdapter->gfxInstance->vkInstance, vkSurface, nullptr);
+    // 程序退出时等待GPU空闲是可以接受的，运行时重建交换链则绝不这样做
+    gfxDevice->volkTable.vkDeviceWaitIdle(gfxDevice->vkDevice);
+    destroyFrames();
+    collectRetiredSwapchains(true);
+    destroyOffscreenChain();
+    if (vkSwapchain != VK_NULL_HANDLE)
+        gfxDevice->volkTable.vkDestroySwapchainKHR(gfxDevice->vkDevice, vkSwapchain, nullptr);
+    if (vkSurface != VK_NULL_HANDLE)
+        vkDestroySurfaceKHR(gfxDevice->gfxAdapter->gfxInstance->vkInstance, vkSurface, nullptr);
     return succeed;
 }
 
+void LittleGFXWindow::createFrames(uint32_t framesInFlight)
+{
+    auto& table = gfxDevice->volkTable;
+    auto vkDevice = gfxDevice->vkDevice;
+    frames.resize(framesInFlight > 0 ? framesInFlight : 1);
+    for (auto& frame : frames)
+    {
+        // 槽位的进度用graphics queue的时间线来追踪，0表示从未提交，第一次BeginFrame不会卡住
+        frame.timelineValue = 0;
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        table.vkCreateSemaphore(vkDevice, &semaphoreInfo, nullptr, &frame.imageAcquired);
+        table.vkCreateSemaphore(vkDevice, &semaphoreInfo, nullptr, &frame.renderFinished);
+        // 每帧的命令缓冲都是录制一次、提交一次就丢掉的，TRANSIENT可以让驱动选择更轻量的分配策略
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = gfxDevice->gfxQueue.familyIndex;
+        table.vkCreateCommandPool(vkDevice, &poolInfo, nullptr, &frame.commandPool);
+        VkCommandBufferAllocateInfo cmdInfo = {};
+        cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdInfo.commandPool = frame.commandPool;
+        cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmdInfo.commandBufferCount = 1;
+        table.vkAllocateCommandBuffers(vkDevice, &cmdInfo, &frame.commandBuffer);
+    }
+    currentFrame = 0;
+}
+
+void LittleGFXWindow::destroyFrames()
+{
+    auto& table = gfxDevice->volkTable;
+    auto vkDevice = gfxDevice->vkDevice;
+    for (auto& frame : frames)
+    {
+        // 命令缓冲随命令池一起释放
+        table.vkDestroyCommandPool(vkDevice, frame.commandPool, nullptr);
+        table.vkDestroySemaphore(vkDevice, frame.renderFinished, nullptr);
+        table.vkDestroySemaphore(vkDevice, frame.imageAcquired, nullptr);
+    }
+    frames.clear();
+}
+
+LittleGFXFrame* LittleGFXWindow::BeginFrame()
+{
+    auto& table = gfxDevice->volkTable;
+    auto vkDevice = gfxDevice->vkDevice;
+    LittleGFXFrame& frame = frames[currentFrame];
+    // 只等待这个槽位自己上一次的提交，更新的帧仍然可以在GPU上继续执行
+    gfxDevice->gfxQueue.Wait(frame.timelineValue);
+    // 队列按提交顺序执行完毕，所以这个槽位完成意味着它之前的帧也都完成了
+    if (frame.frameNumber > completedFrameCount) completedFrameCount = frame.frameNumber;
+    if (!recreateSwapchainIfNeeded()) return nullptr;
+    if (offscreen)
+    {
+        // 离屏图像链没有呈现引擎，按顺序轮流使用每张图像
+        frame.imageIndex = (uint32_t)(submittedFrameCount % swapchainImages.size());
+    }
+    else
+    {
+        VkResult res = table.vkAcquireNextImageKHR(vkDevice, vkSwapchain, UINT64_MAX,
+            frame.imageAcquired, VK_NULL_HANDLE, &frame.imageIndex);
+        if (res == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            // 交换链已经和Surface不匹配了，重建之后再试一次
+            swapchainDirty = true;
+            if (!recreateSwapchainIfNeeded()) return nullptr;
+            res = table.vkAcquireNextImageKHR(vkDevice, vkSwapchain, UINT64_MAX,
+                frame.imageAcquired, VK_NULL_HANDLE, &frame.imageIndex);
+        }
+        // SUBOPTIMAL的图像仍然可以正常呈现，这一帧照常渲染，下一帧再重建
+        if (res == VK_SUBOPTIMAL_KHR)
+            swapchainDirty = true;
+        else if (res != VK_SUCCESS)
+            return nullptr;
+        // 拿回了一张在当前交换链上Present过的图像，之前退役的交换链上的Present都已经被处理完
+        if (imagePresented[frame.imageIndex])
+        {
+            for (auto& retired : retiredSwapchains)
+            {
+                retired.presentsDone = true;
+            }
+        }
+    }
+    frame.image = swapchainImages[frame.imageIndex];
+    // 整个命令池一次性重置，比逐个重置命令缓冲便宜得多
+    table.vkResetCommandPool(vkDevice, frame.commandPool, 0);
+    frame.waits.clear();
+    frame.commandBuffers.clear();
+    gfxDevice->beginFrame();
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    table.vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
+    return &frame;
+}
+
+void LittleGFXWindow::EndFrame(LittleGFXFrame* frame)
+{
+    auto& table = gfxDevice->volkTable;
+    table.vkEndCommandBuffer(frame->commandBuffer);
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    // 附加的命令缓冲排在帧的命令缓冲前面，一起作为一批提交
+    frame->commandBuffers.emplace_back(frame->commandBuffer);
+    LittleGFXSubmitDesc submitDesc = {};
+    submitDesc.commandBuffers = frame->commandBuffers.data();
+    submitDesc.commandBufferCount = (uint32_t)frame->commandBuffers.size();
+    submitDesc.waits = frame->waits.data();
+    submitDesc.waitCount = (uint32_t)frame->waits.size();
+    // 离屏图像链没有Acquire，也就没有需要等待和通知的信号量
+    if (!offscreen)
+    {
+        submitDesc.binaryWaits = &frame->imageAcquired;
+        submitDesc.binaryWaitStages = &waitStage;
+        submitDesc.binaryWaitCount = 1;
+        submitDesc.binarySignals = &frame->renderFinished;
+        submitDesc.binarySignalCount = 1;
+    }
+    frame->timelineValue = gfxDevice->gfxQueue.Enqueue(submitDesc);
+    frame->frameNumber = ++submittedFrameCount;
+    gfxDevice->endFrame(frame->timelineValue);
+    // 这一帧里各个系统放进合批器的命令在这里一起提交
+    gfxDevice->FlushQueues();
+    if (!offscreen)
+    {
+        VkPresentInfoKHR presentInfo = {};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &frame->renderFinished;
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = &vkSwapchain;
+        presentInfo.pImageIndices = &frame->imageIndex;
+        VkResult res = gfxDevice->gfxQueue.Present(presentInfo);
+        // OUT_OF_DATE时Present也可能已经排进了呈现引擎，同样算作Present过
+        imagePresented[frame->imageIndex] = true;
+        if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) swapchainDirty = true;
+    }
+    currentFrame = (currentFrame + 1) % (uint32_t)frames.size();
+}
+
+void LittleGFXWindow::OnResize(uint32_t newWidth, uint32_t newHeight)
+{
+    if (newWidth == width && newHeight == height) return;
+    LittleWindow::OnResize(newWidth, newHeight);
+    // WM_SIZE可能在DispatchMessage的过程中到来，这里只做标记，交换链在下一帧开始前重建
+    swapchainDirty = true;
+}
+
+void LittleGFXWindow::SetPresentProfile(LittleGFXPresentProfile profile)
+{
+    if (profile == presentProfile) return;
+    presentProfile = profile;
+    RequestSwapchainRecreate();
+}
+
+bool LittleGFXWindow::recreateSwapchainIfNeeded()
+{
+    collectRetiredSwapchains();
+    if (!swapchainDirty) return true;
+    // 最小化的窗口没有可以呈现的区域，保持标记等窗口恢复后再重建
+    if (width == 0 || height == 0) return false;
+    if (IsOffscreen())
+    {
+        // 离屏图像链没有oldSwapchain可以传递，直接把旧图像整体挂到待回收列表上
+        RetiredSwapchain retired = {};
+        retired.swapchain = VK_NULL_HANDLE;
+        retired.offscreenImages = std::move(swapchainImages);
+        retired.offscreenMemories = std::move(offscreenMemories);
+        retired.retireFrame = submittedFrameCount;
+        // 离屏图像没有Present，只需要等帧完成
+        retired.presentsDone = true;
+        retiredSwapchains.emplace_back(std::move(retired));
+        swapchainImages.clear();
+        offscreenMemories.clear();
+        createOffscreenChain(gfxDevice, (uint32_t)retiredSwapchains.back().offscreenImages.size());
+    }
+    else if (!createSwapchainKHR(gfxDevice))
+    {
+        return false;
+    }
+    swapchainDirty = false;
+    return true;
+}
+
+void LittleGFXWindow::collectRetiredSwapchains(bool waitAll)
+{
+    auto& table = gfxDevice->volkTable;
+    for (auto iter = retiredSwapchains.begin(); iter != retiredSwapchains.end();)
+    {
+        // retireFrame之前提交的帧都已经执行完毕，说明不会再有命令引用这条交换链的图像了；
+        // 呈现引擎也处理完它的Present之后才能销毁交换链
+        if (!waitAll && (iter->retireFrame > completedFrameCount || !iter->presentsDone))
+        {
+            ++iter;
+            continue;
+        }
+        for (uint32_t i = 0; i < iter->offscreenImages.size(); i++)
+        {
+            gfxDevice->memoryAllocator.DestroyImage(iter->offscreenImages[i], iter->offscreenMemories[i]);
+        }
+        if (iter->swapchain != VK_NULL_HANDLE)
+        {
+            table.vkDestroySwapchainKHR(gfxDevice->vkDevice, iter->swapchain, nullptr);
+        }
+        iter = retiredSwapchains.erase(iter);
+    }
+}
+
 void LittleGFXWindow::createSurface(LittleGFXInstance* inst)
 {
-#if defined(_WIN32) || defined(_WIN64)
+    vkSurface = VK_NULL_HANDLE;
+    if (IsHeadless())
+    {
+        // 无头模式下优先使用VK_EXT_headless_surface，它不需要任何显示服务器
+        // 这样后面的交换链、Acquire和Present流程和有窗口时完全一样
+        if (inst->isExtensionEnabled(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME))
+        {
+            VkHeadlessSurfaceCreateInfoEXT create_info = {};
+            create_info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+            if (vkCreateHeadlessSurfaceEXT(inst->vkInstance, &create_info, nullptr, &vkSurface) != VK_SUCCESS)
+            {
+                vkSurface = VK_NULL_HANDLE;
+            }
+        }
+        // 扩展不可用时vkSurface保持为空，之后会退化为纯离屏的图像链
+        return;
+    }
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
     VkWin32SurfaceCreateInfoKHR create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
     create_info.pNext = NULL;
@@ -225,53 +997,187 @@ void LittleGFXWindow::createSurface(LittleGFXInstance* inst)
     assert(0 && "Platform not supported!");
 }
 
-/*
-VkPresentModeKHR preferredModeList[] = {
-    VK_PRESENT_MODE_IMMEDIATE_KHR,    // normal
-    VK_PRESENT_MODE_MAILBOX_KHR,      // low latency
-    VK_PRESENT_MODE_FIFO_RELAXED_KHR, // minimize stuttering
-    VK_PRESENT_MODE_FIFO_KHR          // low power consumption
+bool LittleGFXWindow::supportsPresent(LittleGFXDevice* device) const
+{
+    if (vkSurface == VK_NULL_HANDLE) return false;
+    // 纯计算的驱动可能根本没有交换链扩展
+    if (!device->gfxAdapter->isExtensionEnabled(VK_KHR_SWAPCHAIN_EXTENSION_NAME)) return false;
+    VkBool32 supported = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(device->gfxAdapter->vkPhysicalDevice,
+        (uint32_t)device->gfxAdapter->gfxQueueIndex, vkSurface, &supported);
+    return supported == VK_TRUE;
+}
+
+void LittleGFXWindow::createOffscreenChain(LittleGFXDevice* device, uint32_t imageCount)
+{
+    // 没有可以呈现的Surface时，自己创建一组和交换链等价的图像来承载每帧的渲染结果
+    swapchainFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    swapchainExtent = { width, height };
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = swapchainFormat;
+    imageInfo.extent = { width, height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    // 额外打开TRANSFER_SRC，方便把离屏的结果拷贝回CPU检查
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    swapchainImages.resize(imageCount);
+    offscreenMemories.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; i++)
+    {
+        // lavapipe这类软件驱动上可能不存在DEVICE_LOCAL的类型，所以只把它作为偏好
+        if (!device->memoryAllocator.CreateImage(imageInfo, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapchainImages[i], offscreenMemories[i]))
+        {
+            assert(0 && "fatal: create offscreen image failed!");
+        }
+    }
+}
+
+void LittleGFXWindow::destroyOffscreenChain()
+{
+    if (offscreenMemories.empty()) return;
+    for (uint32_t i = 0; i < offscreenMemories.size(); i++)
+    {
+        gfxDevice->memoryAllocator.DestroyImage(swapchainImages[i], offscreenMemories[i]);
+    }
+    offscreenMemories.clear();
+    swapchainImages.clear();
+}
+
+// 每个延迟档位对呈现模式的偏好顺序。FIFO是规范保证一定支持的，所以总是放在最后兜底
+static const VkPresentModeKHR lowestLatencyModes[] = {
+    VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR
+};
+static const VkPresentModeKHR noTearingLowLatencyModes[] = {
+    VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR
+};
+static const VkPresentModeKHR minimizeStutterModes[] = {
+    VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR
 };
-*/
+static const VkPresentModeKHR powerSaveModes[] = {
+    VK_PRESENT_MODE_FIFO_KHR
+};
+
+VkPresentModeKHR LittleGFXWindow::selectPresentMode(LittleGFXDevice* device) const
+{
+    uint32_t modeCount = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device->gfxAdapter->vkPhysicalDevice, vkSurface, &modeCount, nullptr);
+    std::vector<VkPresentModeKHR> supportedModes(modeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device->gfxAdapter->vkPhysicalDevice, vkSurface, &modeCount, supportedModes.data());
+    const VkPresentModeKHR* preferredModes = powerSaveModes;
+    uint32_t preferredCount = 1;
+    switch (presentProfile)
+    {
+        case LittleGFXPresentProfile::LowestLatency:
+            preferredModes = lowestLatencyModes;
+            preferredCount = sizeof(lowestLatencyModes) / sizeof(VkPresentModeKHR);
+            break;
+        case LittleGFXPresentProfile::NoTearingLowLatency:
+            preferredModes = noTearingLowLatencyModes;
+            preferredCount = sizeof(noTearingLowLatencyModes) / sizeof(VkPresentModeKHR);
+            break;
+        case LittleGFXPresentProfile::MinimizeStutter:
+            preferredModes = minimizeStutterModes;
+            preferredCount = sizeof(minimizeStutterModes) / sizeof(VkPresentModeKHR);
+            break;
+        default:
+            break;
+    }
+    for (uint32_t i = 0; i < preferredCount; i++)
+    {
+        for (auto supported : supportedModes)
+        {
+            if (supported == preferredModes[i]) return supported;
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
 #define clamp(x, min, max) (x) < (min) ? (min) : ((x) > (max) ? (max) : (x))
-void LittleGFXWindow::createSwapchainKHR(LittleGFXDevice* device, bool enableVsync)
+bool LittleGFXWindow::createSwapchainKHR(LittleGFXDevice* device)
 {
     // 获取surface支持的格式信息
     VkSurfaceCapabilitiesKHR caps = { 0 };
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device->gfxAdapter->vkPhysicalDevice, vkSurface, &caps);
     // 创建
     uint32_t presentQueueFamilyIndex = device->gfxAdapter->gfxQueueIndex;
-    VkExtent2D extent{
-        clamp(width, caps.minImageExtent.width, caps.maxImageExtent.width),
-        clamp(height, caps.minImageExtent.height, caps.maxImageExtent.height)
-    };
+    VkExtent2D extent = caps.currentExtent;
+    // 0xFFFFFFFF表示交换链的大小由我们决定（比如headless surface），否则必须和窗口一致
+    if (extent.width == 0xFFFFFFFF)
+    {
+        extent.width = clamp(width, caps.minImageExtent.width, caps.maxImageExtent.width);
+        extent.height = clamp(height, caps.minImageExtent.height, caps.maxImageExtent.height);
+    }
+    if (extent.width == 0 || extent.height == 0) return false;
     VkSwapchainCreateInfoKHR swapchainInfo = {};
     swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     swapchainInfo.pNext = NULL;
     swapchainInfo.flags = 0;
     swapchainInfo.surface = vkSurface;
-    swapchainInfo.minImageCount = enableVsync ? 3 : 2;
-    swapchainInfo.presentMode = enableVsync ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR;
+    // 图像数量从Surface的能力推导：MAILBOX和FIFO_RELAXED需要多一张图像，
+    // 这样GPU总有一张空闲图像可写，不会因为等待呈现引擎归还图像而阻塞
+    presentMode = selectPresentMode(device);
+    uint32_t imageCount = caps.minImageCount;
+    if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR || presentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+    {
+        imageCount = caps.minImageCount + 1;
+    }
+    if (imageCount < 2) imageCount = 2;
+    // maxImageCount为0表示没有上限
+    if (caps.maxImageCount > 0 && imageCount > caps.maxImageCount) imageCount = caps.maxImageCount;
+    swapchainInfo.minImageCount = imageCount;
+    swapchainInfo.presentMode = presentMode;
     // 因为OGL标准，此format和色彩空间一定是被现在的显卡支持的
-    swapchainInfo.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    swapchainInfo.imageFormat = swapchainFormat;
     swapchainInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
     swapchainInfo.imageExtent = extent;
     swapchainInfo.imageArrayLayers = 1;
     swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // 能用传输命令清屏或者拷贝到交换链图像上会方便很多，Surface支持的话就打开
+    swapchainInfo.imageUsage |= caps.supportedUsageFlags & (VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
     // 反转缓冲区呈现交换链是一种GPU行为，同样是被Queue执行的。这里指定可以执行Present操作的Queue。
     swapchainInfo.queueFamilyIndexCount = 1;
     swapchainInfo.pQueueFamilyIndices = &presentQueueFamilyIndex;
     swapchainInfo.clipped = VK_TRUE;
-    // 在这里指定一个老的交换链可以加速创建
-    swapchainInfo.oldSwapchain = VK_NULL_HANDLE;
+    // 在这里指定一个老的交换链可以加速创建，驱动还可以直接复用老交换链的资源
+    // 老交换链从此进入retired状态，已经acquire的图像仍然可以present，但不能再acquire新图像
+    VkSwapchainKHR oldSwapchain = vkSwapchain;
+    swapchainInfo.oldSwapchain = oldSwapchain;
     // 可以在呈现时指定某种变换，比如把图片逆时针旋转90度
     swapchainInfo.preTransform = caps.currentTransform;
     // 是否使用Alpha通道和其它的窗口混合，这里可以实现很多奇特的效果，但是我们不需要。所以设定为OPAQUE（不透明）模式
     swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    VkSwapchainKHR newSwapchain = VK_NULL_HANDLE;
     VkResult res = device->volkTable.vkCreateSwapchainKHR(
-        device->vkDevice, &swapchainInfo, nullptr, &vkSwapchain);
+        device->vkDevice, &swapchainInfo, nullptr, &newSwapchain);
     if (VK_SUCCESS != res)
     {
-        assert(0 && "fatal: vkCreateSwapchainKHR failed!");
+        assert(oldSwapchain != VK_NULL_HANDLE && "fatal: vkCreateSwapchainKHR failed!");
     }
+    // 不等待GPU空闲：老交换链进入回收列表，等引用它的帧都完成后再销毁
+    // 即使创建失败老交换链也已经被retire了，下一帧只能不带oldSwapchain重试
+    if (oldSwapchain != VK_NULL_HANDLE)
+    {
+        RetiredSwapchain retired = {};
+        retired.swapchain = oldSwapchain;
+        retired.retireFrame = submittedFrameCount;
+        retired.presentsDone = false;
+        retiredSwapchains.emplace_back(std::move(retired));
+    }
+    vkSwapchain = newSwapchain;
+    swapchainImages.clear();
+    if (VK_SUCCESS != res) return false;
+    swapchainExtent = extent;
+    // 取回交换链里的图像，之后每帧渲染的目标就是它们。驱动实际创建的数量可能比要求的多
+    imageCount = 0;
+    device->volkTable.vkGetSwapchainImagesKHR(device->vkDevice, vkSwapchain, &imageCount, nullptr);
+    swapchainImages.resize(imageCount);
+    device->volkTable.vkGetSwapchainImagesKHR(device->vkDevice, vkSwapchain, &imageCount, swapchainImages.data());
+    imagePresented.assign(imageCount, false);
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "gfx/gfx_pipeline_cache.h"
+#include "gfx/gfx_objects.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string.h>
+
+#define PIPELINE_CACHE_MAGIC 0x43504D4C // "LMPC"
+#define PIPELINE_CACHE_VERSION 1
+
+// FNV-1a，只用来发现截断或者损坏的文件
+static uint64_t hashBytes(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool LittleGFXPipelineCache::initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    const auto& props = device->gfxAdapter->vkPhysDeviceProps.properties;
+    // 文件名里带上完整的适配器身份，多块显卡、多个驱动版本的缓存可以共存
+    std::ostringstream name;
+    name << LITTLE_GFX_PIPELINE_CACHE_DIR << "/" << std::hex << std::setfill('0')
+         << std::setw(4) << props.vendorID << "_" << std::setw(4) << props.deviceID << "_"
+         << std::setw(8) << props.driverVersion << "_";
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+    {
+        name << std::setw(2) << (uint32_t)props.pipelineCacheUUID[i];
+    }
+    name << ".bin";
+    filePath = name.str();
+    std::vector<uint8_t> initialData = loadFile();
+    loadedFromDisk = !initialData.empty();
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialData.size();
+    cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+    if (device->volkTable.vkCreatePipelineCache(device->vkDevice, &cacheInfo, nullptr, &vkPipelineCache) != VK_SUCCESS)
+    {
+        // 驱动仍然拒绝这份数据时，退回到一个空的缓存
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        loadedFromDisk = false;
+        if (device->volkTable.vkCreatePipelineCache(device->vkDevice, &cacheInfo, nullptr, &vkPipelineCache) != VK_SUCCESS)
+        {
+            assert(0 && "fatal: create pipeline cache failed!");
+            return false;
+        }
+    }
+    return true;
+}
+
+void LittleGFXPipelineCache::destroy()
+{
+    if (vkPipelineCache == VK_NULL_HANDLE) return;
+    Save();
+    gfxDevice->volkTable.vkDestroyPipelineCache(gfxDevice->vkDevice, vkPipelineCache, nullptr);
+    vkPipelineCache = VK_NULL_HANDLE;
+}
+
+void LittleGFXPipelineCache::fillHeader(FileHeader& header) const
+{
+    const auto& props = gfxDevice->gfxAdapter->vkPhysDeviceProps.properties;
+    memset(&header, 0, sizeof(header));
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.version = PIPELINE_CACHE_VERSION;
+    header.vendorID = props.vendorID;
+    header.deviceID = props.deviceID;
+    header.driverVersion = props.driverVersion;
+    memcpy(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+bool LittleGFXPipelineCache::validate(const FileHeader& header, const uint8_t* data, size_t dataSize) const
+{
+    FileHeader expected;
+    fillHeader(expected);
+    if (header.magic != expected.magic || header.version != expected.version) return false;
+    if (header.vendorID != expected.vendorID || header.deviceID != expected.deviceID) return false;
+    if (header.driverVersion != expected.driverVersion) return false;
+    if (memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) return false;
+    if (header.dataSize != dataSize || header.dataHash != hashBytes(data, dataSize)) return false;
+    // 再检查驱动自己写的VkPipelineCacheHeaderVersionOne，它同样带有厂商、设备和UUID
+    if (dataSize < sizeof(VkPipelineCacheHeaderVersionOne)) return false;
+    VkPipelineCacheHeaderVersionOne cacheHeader;
+    memcpy(&cacheHeader, data, sizeof(cacheHeader));
+    if (cacheHeader.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || cacheHeader.headerSize > dataSize) return false;
+    if (cacheHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return false;
+    if (cacheHeader.vendorID != expected.vendorID || cacheHeader.deviceID != expected.deviceID) return false;
+    return memcmp(cacheHeader.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+std::vector<uint8_t> LittleGFXPipelineCache::loadFile() const
+{
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return {};
+    const auto fileSize = (size_t)file.tellg();
+    if (fileSize < sizeof(FileHeader)) return {};
+    file.seekg(0);
+    FileHeader header;
+    file.read((char*)&header, sizeof(header));
+    std::vector<uint8_t> data(fileSize - sizeof(FileHeader));
+    file.read((char*)data.data(), data.size());
+    if (!file || !validate(header, data.data(), data.size()))
+    {
+        // 不匹配或者损坏的文件直接忽略，退出时会被新的缓存覆盖
+        std::cout << "pipeline cache " << filePath << " is invalid, ignored" << std::endl;
+        return {};
+    }
+    return data;
+}
+
+bool LittleGFXPipelineCache::readData(std::vector<uint8_t>& outData)
+{
+    std::lock_guard<std::mutex> lock(mergeMutex);
+    size_t dataSize = 0;
+    auto& table = gfxDevice->volkTable;
+    outData.clear();
+    if (table.vkGetPipelineCacheData(gfxDevice->vkDevice, vkPipelineCache, &dataSize, nullptr) != VK_SUCCESS) return false;
+    outData.resize(dataSize);
+    if (table.vkGetPipelineCacheData(gfxDevice->vkDevice, vkPipelineCache, &dataSize, outData.data()) != VK_SUCCESS)
+    {
+        outData.clear();
+        return false;
+    }
+    outData.resize(dataSize);
+    return true;
+}
+
+VkPipelineCache LittleGFXPipelineCache::CreateThreadCache()
+{
+    // 用主缓存当前的内容做初始数据，工作线程编译时才能命中从磁盘加载的缓存
+    std::vector<uint8_t> data;
+    readData(data);
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+    VkPipelineCache threadCache = VK_NULL_HANDLE;
+    gfxDevice->volkTable.vkCreatePipelineCache(gfxDevice->vkDevice, &cacheInfo, nullptr, &threadCache);
+    return threadCache;
+}
+
+void LittleGFXPipelineCache::MergeThreadCache(VkPipelineCache threadCache)
+{
+    if (threadCache == VK_NULL_HANDLE) return;
+    {
+        // vkMergePipelineCaches要求目标缓存被外部同步
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        gfxDevice->volkTable.vkMergePipelineCaches(gfxDevice->vkDevice, vkPipelineCache, 1, &threadCache);
+    }
+    gfxDevice->volkTable.vkDestroyPipelineCache(gfxDevice->vkDevice, threadCache, nullptr);
+}
+
+bool LittleGFXPipelineCache::Save()
+{
+    std::vector<uint8_t> data;
+    if (!readData(data) || data.empty()) return false;
+    FileHeader header;
+    fillHeader(header);
+    header.dataSize = data.size();
+    header.dataHash = hashBytes(data.data(), data.size());
+    std::error_code ec;
+    std::filesystem::create_directories(LITTLE_GFX_PIPELINE_CACHE_DIR, ec);
+    // 先完整地写到临时文件再重命名，写到一半时崩溃或断电也不会留下半个缓存文件
+    const std::string tempPath = filePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)data.data(), data.size());
+        file.flush();
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tempPath, filePath, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "gfx/gfx_pipeline_compiler.h"
+#include "gfx/gfx_objects.h"
+#include <algorithm>
+
+bool LittleGFXPipelineCompiler::initialize(LittleGFXDevice* device, uint32_t threadCount)
+{
+    gfxDevice = device;
+    if (!workers.Initialize(threadCount)) return false;
+    threadCaches.resize(workers.GetThreadCount());
+    for (auto& cache : threadCaches)
+    {
+        cache = device->pipelineCache.CreateThreadCache();
+    }
+    return true;
+}
+
+void LittleGFXPipelineCompiler::destroy()
+{
+    workers.WaitIdle();
+    workers.Destroy();
+    // 把各个线程编译的成果合并进主缓存，随后主缓存会被写回磁盘
+    for (auto& cache : threadCaches)
+    {
+        gfxDevice->pipelineCache.MergeThreadCache(cache);
+    }
+    threadCaches.clear();
+    std::lock_guard<std::mutex> lock(statesMutex);
+    auto destroyState = [this](LittleGFXPipelineState& state) {
+        if (state.pipeline != VK_NULL_HANDLE)
+            gfxDevice->volkTable.vkDestroyPipeline(gfxDevice->vkDevice, state.pipeline, nullptr);
+        state.pipeline = VK_NULL_HANDLE;
+        state.status.store(LittleGFXPipelineStatus::Failed, std::memory_order_release);
+    };
+    for (auto& state : states)
+    {
+        destroyState(*state);
+    }
+    states.clear();
+    for (auto& state : releasedStates)
+    {
+        destroyState(*state);
+    }
+    releasedStates.clear();
+    for (auto& retired : retiredPipelines)
+    {
+        gfxDevice->volkTable.vkDestroyPipeline(gfxDevice->vkDevice, retired.pipeline, nullptr);
+    }
+    retiredPipelines.clear();
+}
+
+void LittleGFXPipelineCompiler::beginFrame()
+{
+    std::lock_guard<std::mutex> lock(statesMutex);
+    for (size_t i = 0; i < retiredPipelines.size();)
+    {
+        if (gfxDevice->gfxQueue.IsComplete(retiredPipelines[i].timelineValue))
+        {
+            gfxDevice->volkTable.vkDestroyPipeline(gfxDevice->vkDevice, retiredPipelines[i].pipeline, nullptr);
+            retiredPipelines[i] = retiredPipelines.back();
+            retiredPipelines.pop_back();
+        }
+        else
+            i++;
+    }
+}
+
+void LittleGFXPipelineCompiler::endFrame(uint64_t timelineValue)
+{
+    std::lock_guard<std::mutex> lock(statesMutex);
+    // 这一帧里释放的管线可能已经被录制进这一帧的命令，所以等这一帧执行完毕再销毁
+    for (size_t i = 0; i < releasedStates.size();)
+    {
+        auto& state = releasedStates[i];
+        if (state->status.load(std::memory_order_acquire) == LittleGFXPipelineStatus::Pending)
+        {
+            i++;
+            continue;
+        }
+        if (state->pipeline != VK_NULL_HANDLE) retiredPipelines.push_back({ state->pipeline, timelineValue });
+        releasedStates[i] = std::move(releasedStates.back());
+        releasedStates.pop_back();
+    }
+}
+
+void LittleGFXPipelineCompiler::Release(LittleGFXPipelineHandle& handle)
+{
+    if (!handle.IsValid()) return;
+    std::lock_guard<std::mutex> lock(statesMutex);
+    auto iter = std::find(states.begin(), states.end(), handle.state);
+    if (iter != states.end())
+    {
+        *iter = std::move(states.back());
+        states.pop_back();
+        releasedStates.emplace_back(std::move(handle.state));
+    }
+    handle.state.reset();
+}
+
+void LittleGFXPipelineCompiler::notifyFinished()
+{
+    // 先拿一次锁，Wait检查完状态、还没开始睡眠时不会错过这次通知
+    {
+        std::lock_guard<std::mutex> lock(finishMutex);
+    }
+    pipelineFinished.notify_all();
+}
+
+std::shared_ptr<LittleGFXPipelineState> LittleGFXPipelineCompiler::createState(VkPipeline fallback)
+{
+    auto state = std::make_shared<LittleGFXPipelineState>();
+    state->fallback = fallback;
+    std::lock_guard<std::mutex> lock(statesMutex);
+    states.emplace_back(state);
+    return state;
+}
+
+LittleGFXPipelineHandle LittleGFXPipelineCompiler::CompileGraphics(const LittleGFXGraphicsPipelineDesc& desc, VkPipeline fallback)
+{
+    auto state = createState(fallback);
+    auto device = gfxDevice;
+    auto caches = threadCaches.data();
+    // 描述按值捕获，调用方返回之后就可以释放自己的那一份
+    workers.Submit([this, device, caches, desc, state](uint32_t workerIndex) {
+        compileGraphics(device, caches[workerIndex], desc, *state);
+        compiledCount.fetch_add(1, std::memory_order_relaxed);
+        notifyFinished();
+    });
+    return LittleGFXPipelineHandle(state);
+}
+
+LittleGFXPipelineHandle LittleGFXPipelineCompiler::CompileCompute(const LittleGFXComputePipelineDesc& desc, VkPipeline fallback)
+{
+    auto state = createState(fallback);
+    auto device = gfxDevice;
+    auto caches = threadCaches.data();
+    workers.Submit([this, device, caches, desc, state](uint32_t workerIndex) {
+        compileCompute(device, caches[workerIndex], desc, *state);
+        compiledCount.fetch_add(1, std::memory_order_relaxed);
+        notifyFinished();
+    });
+    return LittleGFXPipelineHandle(state);
+}
+
+void LittleGFXPipelineCompiler::compileGraphics(LittleGFXDevice* device, VkPipelineCache cache,
+    const LittleGFXGraphicsPipelineDesc& desc, LittleGFXPipelineState& state)
+{
+    std::vector<VkPipelineShaderStageCreateInfo> stageInfos(desc.stages.size());
+    for (size_t i = 0; i < desc.stages.size(); i++)
+    {
+        stageInfos[i] = {};
+        stageInfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stageInfos[i].stage = desc.stages[i].stage;
+        stageInfos[i].module = desc.stages[i].module;
+        stageInfos[i].pName = desc.stages[i].entryPoint.c_str();
+    }
+    VkPipelineVertexInputStateCreateInfo vertexInput = {};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInput.vertexBindingDescriptionCount = (uint32_t)desc.vertexBindings.size();
+    vertexInput.pVertexBindingDescriptions = desc.vertexBindings.data();
+    vertexInput.vertexAttributeDescriptionCount = (uint32_t)desc.vertexAttributes.size();
+    vertexInput.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = desc.topology;
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+    VkPipelineRasterizationStateCreateInfo raster = {};
+    raster.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    raster.polygonMode = desc.polygonMode;
+    raster.cullMode = desc.cullMode;
+    raster.frontFace = desc.frontFace;
+    raster.lineWidth = 1.f;
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = desc.samples;
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = desc.depthCompare;
+    VkPipelineColorBlendStateCreateInfo blend = {};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = (uint32_t)desc.blendAttachments.size();
+    blend.pAttachments = desc.blendAttachments.data();
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = (uint32_t)desc.dynamicStates.size();
+    dynamic.pDynamicStates = desc.dynamicStates.data();
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = (uint32_t)stageInfos.size();
+    pipelineInfo.pStages = stageInfos.data();
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewport;
+    pipelineInfo.pRasterizationState = &raster;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &blend;
+    pipelineInfo.pDynamicState = &dynamic;
+    pipelineInfo.layout = desc.layout;
+    pipelineInfo.renderPass = desc.renderPass;
+    pipelineInfo.subpass = desc.subpass;
+    pipelineInfo.basePipelineIndex = -1;
+    VkResult res = device->volkTable.vkCreateGraphicsPipelines(device->vkDevice, cache, 1, &pipelineInfo, nullptr, &state.pipeline);
+    // 先写管线再发布状态，渲染线程看到Ready时一定能读到管线句柄
+    state.status.store(res == VK_SUCCESS ? LittleGFXPipelineStatus::Ready : LittleGFXPipelineStatus::Failed, std::memory_order_release);
+}
+
+void LittleGFXPipelineCompiler::compileCompute(LittleGFXDevice* device, VkPipelineCache cache,
+    const LittleGFXComputePipelineDesc& desc, LittleGFXPipelineState& state)
+{
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = desc.stage.module;
+    pipelineInfo.stage.pName = desc.stage.entryPoint.c_str();
+    pipelineInfo.layout = desc.layout;
+    pipelineInfo.basePipelineIndex = -1;
+    VkResult res = device->volkTable.vkCreateComputePipelines(device->vkDevice, cache, 1, &pipelineInfo, nullptr, &state.pipeline);
+    state.status.store(res == VK_SUCCESS ? LittleGFXPipelineStatus::Ready : LittleGFXPipelineStatus::Failed, std::memory_order_release);
+}
+
+VkPipeline LittleGFXPipelineCompiler::Wait(const LittleGFXPipelineHandle& handle)
+{
+    if (!handle.IsValid()) return VK_NULL_HANDLE;
+    // 排在几百个加载时的管线后面时可能要等很久，睡在条件变量上，不占用核
+    std::unique_lock<std::mutex> lock(finishMutex);
+    pipelineFinished.wait(lock, [&handle] { return handle.IsReady() || handle.IsFailed(); });
+    lock.unlock();
+    return handle.IsReady() ? handle.Get() : VK_NULL_HANDLE;
+}
+
+void LittleGFXPipelineCompiler::WaitIdle()
+{
+    workers.WaitIdle();
+    mergeThreadCaches();
+}
+
+void LittleGFXPipelineCompiler::mergeThreadCaches()
+{
+    // 线程空闲时才能替换它的缓存，合并之后换上一个以合并后的主缓存为初始数据的新缓存继续使用
+    for (auto& cache : threadCaches)
+    {
+        gfxDevice->pipelineCache.MergeThreadCache(cache);
+        cache = gfxDevice->pipelineCache.CreateThreadCache();
+    }
+}
\ No newline at end of file
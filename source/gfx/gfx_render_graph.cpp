@@ -0,0 +1,1519 @@
+#include "gfx/gfx_render_graph.h"
+#include "gfx/gfx_objects.h"
+#include "framework/thread_pool.h"
+#include <algorithm>
+
+// 每种用途对应的管线阶段、访问类型、图像布局和创建资源时需要的usage
+struct LittleGFXRGUsageInfo {
+    VkPipelineStageFlags2KHR stages;
+    VkAccessFlags2KHR readAccess;
+    VkAccessFlags2KHR writeAccess;
+    VkImageLayout readLayout;
+    VkImageLayout writeLayout;
+    VkImageUsageFlags imageUsage;
+    VkBufferUsageFlags bufferUsage;
+};
+
+static const LittleGFXRGUsageInfo usageInfos[(uint32_t)LittleGFXRGUsage::Count] = {
+    // ColorAttachment
+    { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+      VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0 },
+    // DepthStencilAttachment
+    { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+      VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 },
+    // SampledGraphics
+    { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+      VK_ACCESS_2_SHADER_READ_BIT_KHR, 0,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      VK_IMAGE_USAGE_SAMPLED_BIT, VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT },
+    // SampledCompute
+    { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+      VK_ACCESS_2_SHADER_READ_BIT_KHR, 0,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      VK_IMAGE_USAGE_SAMPLED_BIT, VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT },
+    // StorageGraphics
+    { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+      VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+      VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+      VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+    // StorageCompute
+    { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+      VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+      VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+      VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+    // Transfer
+    { VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+      VK_ACCESS_2_TRANSFER_READ_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT },
+    // UniformBuffer
+    { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+      VK_ACCESS_2_UNIFORM_READ_BIT_KHR, 0,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+      0, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT },
+    // VertexBuffer
+    { VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT_KHR,
+      VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR, 0,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+      0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT },
+    // IndexBuffer
+    { VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT_KHR,
+      VK_ACCESS_2_INDEX_READ_BIT_KHR, 0,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+      0, VK_BUFFER_USAGE_INDEX_BUFFER_BIT },
+    // IndirectBuffer
+    { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR,
+      VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR, 0,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+      0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT }
+};
+
+static VkImageAspectFlags formatAspect(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+LittleGFXRGPass& LittleGFXRGPass::Read(LittleGFXRGResource resource, LittleGFXRGUsage usage)
+{
+    accesses.push_back({ resource, usage, false });
+    return *this;
+}
+
+LittleGFXRGPass& LittleGFXRGPass::Write(LittleGFXRGResource resource, LittleGFXRGUsage usage)
+{
+    accesses.push_back({ resource, usage, true });
+    return *this;
+}
+
+LittleGFXRGPass& LittleGFXRGPass::SetExecute(LittleGFXRGExecuteFunc func)
+{
+    execute = std::move(func);
+    return *this;
+}
+
+LittleGFXRGPass& LittleGFXRGPass::SetSideEffect()
+{
+    sideEffect = true;
+    return *this;
+}
+
+LittleGFXRGPass& LittleGFXRGPass::SetAsyncCompute()
+{
+    asyncCompute = true;
+    return *this;
+}
+
+LittleGFXRGPass& LittleGFXRGPass::SetCost(float cost_)
+{
+    cost = cost_;
+    return *this;
+}
+
+bool LittleGFXRenderGraph::Initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    frameIndex = 0;
+    // 计算队列和图形队列属于同一个队列族时并行执行不了多少，只在有专用的计算队列族时才启用异步计算
+    asyncComputeEnabled = device->HasDedicatedComputeQueue() &&
+        device->GetComputeQueue()->GetFamilyIndex() != device->GetGraphicsQueue()->GetFamilyIndex();
+    return true;
+}
+
+void LittleGFXRenderGraph::SetThreadPool(LittleThreadPool* pool)
+{
+    // 任何一个工作线程都可能拿到录制任务，所以所有工作线程的序号都要有对应的命令池槽位
+    if (pool != nullptr) gfxDevice->GetCommandAllocator()->ReserveThreads(pool->GetThreadCount() + 1);
+    threadPool = pool;
+}
+
+bool LittleGFXRenderGraph::Destroy()
+{
+    // 堆里的资源可能还在在途的帧里使用
+    auto queue = gfxDevice->GetGraphicsQueue();
+    queue->Wait(queue->GetLastSubmittedValue());
+    if (asyncComputeEnabled)
+    {
+        auto computeQueue = getQueue(LittleGFXRGQueue::AsyncCompute);
+        computeQueue->Wait(computeQueue->GetLastSubmittedValue());
+    }
+    for (auto& iter : physicalResources)
+    {
+        destroyPhysical(iter.second);
+    }
+    physicalResources.clear();
+    for (auto& retired : retiredPhysicals)
+    {
+        destroyPhysical(retired.physical);
+    }
+    retiredPhysicals.clear();
+    auto allocator = gfxDevice->GetMemoryAllocator();
+    for (auto& heap : heaps)
+    {
+        allocator->Free(heap.allocation);
+    }
+    heaps.clear();
+    for (auto& retired : retiredHeaps)
+    {
+        allocator->Free(retired.allocation);
+    }
+    retiredHeaps.clear();
+    requirementsCache.clear();
+    lastFrame = nullptr;
+    Reset();
+    return true;
+}
+
+void LittleGFXRenderGraph::Reset()
+{
+    passes.clear();
+    resources.clear();
+    barrierBatches.clear();
+    postBarrierBatches.clear();
+    schedule.clear();
+    passQueues.clear();
+    passDependencies.clear();
+    passSegments.clear();
+    segments.clear();
+    recordChunks.clear();
+    finalSegment = UINT32_MAX;
+    compiled = false;
+}
+
+LittleGFXRGResource LittleGFXRenderGraph::ImportImage(const char* name, VkImage image, VkImageView view,
+    const LittleGFXRGImageDesc& desc, VkImageLayout initialLayout, VkImageLayout finalLayout)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isImage = true;
+    resource.imported = true;
+    resource.imageDesc = desc;
+    resource.aspect = formatAspect(desc.format);
+    resource.initialLayout = initialLayout;
+    resource.finalLayout = finalLayout;
+    resource.image = image;
+    resource.view = view;
+    resources.emplace_back(resource);
+    return (LittleGFXRGResource)resources.size() - 1;
+}
+
+LittleGFXRGResource LittleGFXRenderGraph::ImportBuffer(const char* name, VkBuffer buffer, VkDeviceSize size)
+{
+    Resource resource;
+    resource.name = name;
+    resource.imported = true;
+    resource.bufferDesc.size = size;
+    resource.buffer = buffer;
+    resources.emplace_back(resource);
+    return (LittleGFXRGResource)resources.size() - 1;
+}
+
+LittleGFXRGResource LittleGFXRenderGraph::CreateImage(const char* name, const LittleGFXRGImageDesc& desc)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isImage = true;
+    resource.imageDesc = desc;
+    resource.aspect = formatAspect(desc.format);
+    resources.emplace_back(resource);
+    return (LittleGFXRGResource)resources.size() - 1;
+}
+
+LittleGFXRGResource LittleGFXRenderGraph::CreateBuffer(const char* name, const LittleGFXRGBufferDesc& desc)
+{
+    Resource resource;
+    resource.name = name;
+    resource.bufferDesc = desc;
+    resources.emplace_back(resource);
+    return (LittleGFXRGResource)resources.size() - 1;
+}
+
+LittleGFXRGPass& LittleGFXRenderGraph::AddPass(const char* name)
+{
+    passes.emplace_back(std::make_unique<LittleGFXRGPass>());
+    passes.back()->name = name;
+    compiled = false;
+    return *passes.back();
+}
+
+VkImage LittleGFXRenderGraph::GetImage(LittleGFXRGResource resource) const
+{
+    return resource < resources.size() ? resources[resource].image : VK_NULL_HANDLE;
+}
+
+VkImageView LittleGFXRenderGraph::GetImageView(LittleGFXRGResource resource) const
+{
+    return resource < resources.size() ? resources[resource].view : VK_NULL_HANDLE;
+}
+
+VkBuffer LittleGFXRenderGraph::GetBuffer(LittleGFXRGResource resource) const
+{
+    return resource < resources.size() ? resources[resource].buffer : VK_NULL_HANDLE;
+}
+
+bool LittleGFXRenderGraph::Compile()
+{
+    stats = LittleGFXRGStats();
+    stats.passCount = (uint32_t)passes.size();
+    for (const auto& pass : passes)
+    {
+        for (const auto& access : pass->accesses)
+        {
+            if (access.resource >= resources.size())
+            {
+                assert(0 && "render graph pass uses an invalid resource!");
+                return false;
+            }
+        }
+    }
+    trimPhysicalResources();
+    cullPasses();
+    buildDependencies();
+    assignQueues();
+    buildRecordChunks();
+    realizeResources();
+    computeBarriers();
+    compiled = true;
+    return true;
+}
+
+void LittleGFXRenderGraph::cullPasses()
+{
+    // 同一份声明可以重复编译，先清掉上一次编译的结果
+    for (auto& resource : resources)
+    {
+        resource.used = false;
+        resource.imageUsage = 0;
+        resource.bufferUsage = 0;
+        resource.state = ResourceState();
+        resource.firstPass = UINT32_MAX;
+        resource.lastPass = 0;
+        resource.heapIndex = UINT32_MAX;
+        resource.aliasPredecessors.clear();
+        resource.asyncAccess = false;
+    }
+    // 从后往前遍历：有副作用、写入导入资源或者写入了后面被需要的资源的通道才存活，
+    // 存活的通道读取的资源又会让更早写入它们的通道存活
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t i = passes.size(); i-- > 0;)
+    {
+        auto& pass = *passes[i];
+        pass.alive = pass.sideEffect;
+        for (const auto& access : pass.accesses)
+        {
+            if (access.write && (resources[access.resource].imported || needed[access.resource])) pass.alive = true;
+        }
+        if (!pass.alive)
+        {
+            stats.culledPassCount++;
+            continue;
+        }
+        for (const auto& access : pass.accesses)
+        {
+            if (!access.write) needed[access.resource] = true;
+        }
+    }
+    schedule.clear();
+    for (auto& pass : passes)
+    {
+        if (pass->alive) schedule.emplace_back(pass.get());
+    }
+    // 只有存活的通道的访问才决定资源的usage和生命周期，被剔除的通道用到的临时资源根本不会分配显存
+    for (uint32_t p = 0; p < schedule.size(); p++)
+    {
+        for (const auto& access : schedule[p]->accesses)
+        {
+            auto& resource = resources[access.resource];
+            const auto& info = usageInfos[(uint32_t)access.usage];
+            resource.used = true;
+            resource.firstPass = std::min(resource.firstPass, p);
+            resource.lastPass = std::max(resource.lastPass, p);
+            resource.imageUsage |= info.imageUsage;
+            resource.bufferUsage |= info.bufferUsage;
+        }
+    }
+}
+
+void LittleGFXRenderGraph::buildDependencies()
+{
+    passDependencies.assign(schedule.size(), std::vector<uint32_t>());
+    std::vector<uint32_t> lastWriter(resources.size(), UINT32_MAX);
+    std::vector<std::vector<uint32_t>> readers(resources.size());
+    std::vector<uint32_t> lastAccessor(resources.size(), UINT32_MAX);
+    for (uint32_t p = 0; p < schedule.size(); p++)
+    {
+        auto& dependencies = passDependencies[p];
+        auto addDependency = [&dependencies](uint32_t pass) {
+            if (pass != UINT32_MAX && std::find(dependencies.begin(), dependencies.end(), pass) == dependencies.end())
+                dependencies.emplace_back(pass);
+        };
+        // 读依赖最近的写入者，写还要依赖这次写入之前的所有读者。
+        // 两次读之间本来没有依赖，但它们被放到不同的队列上时，上一个访问者之后的所有权释放必须先于这里的获取，
+        // 所以总是依赖最近的访问者：同一个队列上按顺序执行，这条边不会带来额外的等待
+        for (const auto& access : schedule[p]->accesses)
+        {
+            addDependency(lastWriter[access.resource]);
+            addDependency(lastAccessor[access.resource]);
+            if (!access.write) continue;
+            for (auto reader : readers[access.resource]) addDependency(reader);
+        }
+        for (const auto& access : schedule[p]->accesses)
+        {
+            lastAccessor[access.resource] = p;
+            if (access.write)
+            {
+                lastWriter[access.resource] = p;
+                readers[access.resource].clear();
+            }
+            else
+            {
+                readers[access.resource].emplace_back(p);
+            }
+        }
+    }
+}
+
+bool LittleGFXRenderGraph::isAsyncComputeCapable(const LittleGFXRGPass& pass) const
+{
+    if (!pass.asyncCompute) return false;
+    for (const auto& access : pass.accesses)
+    {
+        switch (access.usage)
+        {
+        case LittleGFXRGUsage::SampledCompute:
+        case LittleGFXRGUsage::StorageCompute:
+        case LittleGFXRGUsage::Transfer:
+        case LittleGFXRGUsage::UniformBuffer:
+        case LittleGFXRGUsage::IndirectBuffer:
+            break;
+        default:
+            return false;
+        }
+        // 交换链这类要在最后一段里转换布局的图像只在图形队列上访问
+        const auto& resource = resources[access.resource];
+        if (resource.imported && resource.isImage && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) return false;
+    }
+    return true;
+}
+
+void LittleGFXRenderGraph::assignQueues()
+{
+    passQueues.assign(schedule.size(), LittleGFXRGQueue::Graphics);
+    if (asyncComputeEnabled)
+    {
+        // 按调度顺序做一遍两个队列的列表调度：可以放到计算队列上的通道，如果在计算队列上能更早开始，
+        // 也就是能缩短到它为止的关键路径，就把它放过去。跨队列的依赖额外计入一次信号量等待的开销
+        std::vector<float> finishTimes(schedule.size(), 0.f);
+        float queueTimes[(uint32_t)LittleGFXRGQueue::Count] = {};
+        auto startTime = [&](uint32_t pass, LittleGFXRGQueue queue) {
+            float ready = queueTimes[(uint32_t)queue];
+            for (auto dependency : passDependencies[pass])
+            {
+                const float penalty = passQueues[dependency] != queue ? LITTLE_GFX_RG_CROSS_QUEUE_COST : 0.f;
+                ready = std::max(ready, finishTimes[dependency] + penalty);
+            }
+            return ready;
+        };
+        for (uint32_t p = 0; p < schedule.size(); p++)
+        {
+            float start = startTime(p, LittleGFXRGQueue::Graphics);
+            if (isAsyncComputeCapable(*schedule[p]))
+            {
+                const float computeStart = startTime(p, LittleGFXRGQueue::AsyncCompute);
+                if (computeStart < start)
+                {
+                    passQueues[p] = LittleGFXRGQueue::AsyncCompute;
+                    start = computeStart;
+                }
+            }
+            finishTimes[p] = start + schedule[p]->cost;
+            queueTimes[(uint32_t)passQueues[p]] = finishTimes[p];
+        }
+    }
+    // 切分不合法时把造成问题的计算通道退回图形队列，每次至少少一个计算通道，一定会停下来
+    uint32_t demoted = UINT32_MAX;
+    while ((demoted = buildSegments()) != UINT32_MAX)
+    {
+        passQueues[demoted] = LittleGFXRGQueue::Graphics;
+    }
+    for (uint32_t p = 0; p < schedule.size(); p++)
+    {
+        schedule[p]->queue = passQueues[p];
+        if (passQueues[p] == LittleGFXRGQueue::AsyncCompute) stats.asyncComputePassCount++;
+    }
+    stats.submissionCount = (uint32_t)segments.size();
+}
+
+uint32_t LittleGFXRenderGraph::buildSegments()
+{
+    const uint32_t passCount = (uint32_t)schedule.size();
+    segments.clear();
+    passSegments.assign(passCount, UINT32_MAX);
+    finalSegment = UINT32_MAX;
+    // 被另一个队列依赖的通道执行完就要signal，它所在的段在它之后结束
+    std::vector<bool> crossProducers(passCount, false);
+    for (uint32_t p = 0; p < passCount; p++)
+    {
+        for (auto dependency : passDependencies[p])
+        {
+            if (passQueues[dependency] != passQueues[p]) crossProducers[dependency] = true;
+        }
+    }
+    uint32_t openSegments[(uint32_t)LittleGFXRGQueue::Count] = { UINT32_MAX, UINT32_MAX };
+    // 每个队列已经等待过的另一个队列的最晚的段。等待操作对之后提交的命令同样生效，不用重复等待
+    uint32_t waitedSegments[(uint32_t)LittleGFXRGQueue::Count] = { UINT32_MAX, UINT32_MAX };
+    for (uint32_t p = 0; p < passCount; p++)
+    {
+        const uint32_t q = (uint32_t)passQueues[p];
+        uint32_t wait = UINT32_MAX;
+        for (auto dependency : passDependencies[p])
+        {
+            if (passQueues[dependency] == passQueues[p]) continue;
+            if (wait == UINT32_MAX || passSegments[dependency] > wait) wait = passSegments[dependency];
+        }
+        if (wait != UINT32_MAX && waitedSegments[q] != UINT32_MAX && wait <= waitedSegments[q]) wait = UINT32_MAX;
+        if (openSegments[q] == UINT32_MAX || wait != UINT32_MAX)
+        {
+            Segment segment;
+            segment.queue = passQueues[p];
+            segment.firstPass = p;
+            segment.lastPass = p;
+            segment.waitSegment = wait;
+            segments.emplace_back(segment);
+            openSegments[q] = (uint32_t)segments.size() - 1;
+            if (wait != UINT32_MAX) waitedSegments[q] = wait;
+        }
+        segments[openSegments[q]].lastPass = p;
+        passSegments[p] = openSegments[q];
+        if (crossProducers[p]) openSegments[q] = UINT32_MAX;
+    }
+    for (uint32_t s = 0; s < segments.size(); s++)
+    {
+        if (segments[s].queue == LittleGFXRGQueue::Graphics) finalSegment = s;
+    }
+    if (finalSegment == UINT32_MAX)
+    {
+        // 没有图形通道时也要有最后一段，最终的屏障和跨队列等待都放在帧的命令缓冲里
+        Segment segment;
+        segment.firstPass = passCount;
+        segment.lastPass = passCount;
+        segments.emplace_back(segment);
+        finalSegment = (uint32_t)segments.size() - 1;
+    }
+    // 最后一段会等待这一帧所有的计算段，所以计算通道不能再依赖最后一段里的通道，否则会互相等待
+    for (uint32_t p = 0; p < passCount; p++)
+    {
+        if (passQueues[p] != LittleGFXRGQueue::AsyncCompute) continue;
+        for (auto dependency : passDependencies[p])
+        {
+            if (passSegments[dependency] == finalSegment) return p;
+        }
+    }
+    // 访问交换链这类输出图像的通道必须在最后一段里：只有帧的命令缓冲会等待Acquire
+    uint32_t firstOutputPass = UINT32_MAX;
+    for (uint32_t p = 0; p < passCount && firstOutputPass == UINT32_MAX; p++)
+    {
+        for (const auto& access : schedule[p]->accesses)
+        {
+            const auto& resource = resources[access.resource];
+            if (resource.imported && resource.isImage && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) firstOutputPass = p;
+        }
+    }
+    const auto& last = segments[finalSegment];
+    if (firstOutputPass == UINT32_MAX || last.firstPass <= firstOutputPass) return UINT32_MAX;
+    // 最后一段开始得太晚：要么它开头要等待某个计算通道，要么前一段图形命令因为被计算通道依赖而提前结束了
+    if (last.waitSegment != UINT32_MAX)
+    {
+        for (auto dependency : passDependencies[last.firstPass])
+        {
+            if (passSegments[dependency] == last.waitSegment) return dependency;
+        }
+    }
+    for (uint32_t p = last.firstPass; p-- > 0;)
+    {
+        if (passQueues[p] != LittleGFXRGQueue::Graphics) continue;
+        for (uint32_t c = p + 1; c < passCount; c++)
+        {
+            if (passQueues[c] != LittleGFXRGQueue::AsyncCompute) continue;
+            const auto& dependencies = passDependencies[c];
+            if (std::find(dependencies.begin(), dependencies.end(), p) != dependencies.end()) return c;
+        }
+        break;
+    }
+    assert(0 && "render graph segmentation can not place output images in the final segment!");
+    return UINT32_MAX;
+}
+
+void LittleGFXRenderGraph::buildRecordChunks()
+{
+    recordChunks.clear();
+    // 调用Execute的线程也参与录制
+    uint32_t recordThreads = 1;
+    if (threadPool != nullptr) recordThreads += threadPool->GetThreadCount();
+    float totalCost = 0.f;
+    for (auto pass : schedule)
+    {
+        totalCost += pass->cost;
+    }
+    // 每块的开销接近平均值即可，块之间的顺序固定，所以线程数不变时每帧切出的块相同
+    const float chunkBudget = totalCost / recordThreads;
+    for (uint32_t s = 0; s < segments.size(); s++)
+    {
+        float chunkCost = 0.f;
+        bool chunkOpen = false;
+        for (uint32_t p = segments[s].firstPass; p <= segments[s].lastPass && p < schedule.size(); p++)
+        {
+            if (passSegments[p] != s) continue;
+            if (!chunkOpen || (recordThreads > 1 && chunkCost >= chunkBudget))
+            {
+                RecordChunk chunk;
+                chunk.segment = s;
+                recordChunks.emplace_back(chunk);
+                chunkOpen = true;
+                chunkCost = 0.f;
+            }
+            recordChunks.back().passes.emplace_back(p);
+            chunkCost += schedule[p]->cost;
+        }
+    }
+    stats.recordChunkCount = (uint32_t)recordChunks.size();
+}
+
+void LittleGFXRenderGraph::realizeResources()
+{
+    for (uint32_t p = 0; p < schedule.size(); p++)
+    {
+        if (passQueues[p] != LittleGFXRGQueue::AsyncCompute) continue;
+        for (const auto& access : schedule[p]->accesses) resources[access.resource].asyncAccess = true;
+    }
+    std::vector<LittleGFXRGResource> transients;
+    for (uint32_t i = 0; i < resources.size(); i++)
+    {
+        auto& resource = resources[i];
+        if (!resource.used) continue;
+        if (resource.imported)
+        {
+            // 导入的资源可能被图之外的任何命令写过，保守地等待之前的所有命令
+            resource.state.layout = resource.initialLayout;
+            resource.state.writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+            resource.state.writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+            resource.state.queue = LittleGFXRGQueue::Graphics;
+            continue;
+        }
+        if (!queryRequirements(resource))
+        {
+            assert(0 && "query render graph transient resource memory requirements failed!");
+            continue;
+        }
+        transients.emplace_back(i);
+        stats.transientResourceCount++;
+        stats.transientBytes += resource.memoryRequirements.size;
+    }
+    // 缓冲和图像放在不同的堆里，这样同一个堆里不会出现bufferImageGranularity的问题，
+    // 内存类型不兼容的资源也要分开。一般每帧只会有一两组
+    struct Group {
+        bool linear;
+        uint32_t memoryTypeBits;
+        VkDeviceSize alignment;
+        std::vector<LittleGFXRGResource> members;
+    };
+    std::vector<Group> groups;
+    for (auto index : transients)
+    {
+        const auto& resource = resources[index];
+        const bool linear = !resource.isImage;
+        const auto& requirements = resource.memoryRequirements;
+        Group* target = nullptr;
+        for (auto& group : groups)
+        {
+            if (group.linear == linear && group.memoryTypeBits == requirements.memoryTypeBits) target = &group;
+        }
+        if (!target)
+        {
+            groups.push_back({ linear, requirements.memoryTypeBits, 1, {} });
+            target = &groups.back();
+        }
+        target->alignment = std::max(target->alignment, requirements.alignment);
+        target->members.emplace_back(index);
+    }
+    std::vector<uint32_t> groupHeapIds(groups.size());
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        const VkDeviceSize heapSize = placeResources(groups[g].members);
+        stats.aliasedTransientBytes += heapSize;
+        const uint32_t heapIndex = acquireHeap(groups[g].linear, groups[g].memoryTypeBits, heapSize, groups[g].alignment);
+        groupHeapIds[g] = heapIndex == UINT32_MAX ? 0 : heaps[heapIndex].id;
+    }
+    // 同一组之前用过的、现在已经放不下的堆马上退役，不必等它过期
+    for (size_t i = heaps.size(); i-- > 0;)
+    {
+        if (heaps[i].lastUsedFrame == frameIndex) continue;
+        bool replaced = false;
+        for (const auto& group : groups)
+        {
+            if (group.linear == heaps[i].linear && group.memoryTypeBits == heaps[i].memoryTypeBits) replaced = true;
+        }
+        if (replaced) retireHeap(i);
+    }
+    stats.transientHeapCount = (uint32_t)heaps.size();
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        uint32_t heapIndex = UINT32_MAX;
+        for (uint32_t i = 0; i < heaps.size(); i++)
+        {
+            if (heaps[i].id == groupHeapIds[g]) heapIndex = i;
+        }
+        for (auto index : groups[g].members)
+        {
+            auto& resource = resources[index];
+            resource.heapIndex = heapIndex;
+            if (heapIndex == UINT32_MAX || !acquirePhysical(resource))
+            {
+                assert(0 && "create render graph transient resource failed!");
+                continue;
+            }
+            // 这一帧里没有别的资源先占用过这段显存时，要等待上一帧最后访问这个堆的阶段
+            if (resource.aliasPredecessors.empty())
+            {
+                resource.state.writeStages = heaps[heapIndex].lastStages;
+                resource.state.writeAccess = heaps[heapIndex].lastWriteAccess;
+            }
+        }
+    }
+}
+
+std::string LittleGFXRenderGraph::resourceKey(const Resource& resource) const
+{
+    std::string key;
+    auto append = [&key](const void* data, size_t size) { key.append((const char*)data, size); };
+    append(&resource.isImage, sizeof(resource.isImage));
+    if (resource.isImage)
+    {
+        const auto& desc = resource.imageDesc;
+        append(&desc.format, sizeof(desc.format));
+        append(&desc.extent, sizeof(desc.extent));
+        append(&desc.imageType, sizeof(desc.imageType));
+        append(&desc.mipLevels, sizeof(desc.mipLevels));
+        append(&desc.arrayLayers, sizeof(desc.arrayLayers));
+        append(&desc.samples, sizeof(desc.samples));
+        append(&resource.imageUsage, sizeof(resource.imageUsage));
+    }
+    else
+    {
+        append(&resource.bufferDesc.size, sizeof(resource.bufferDesc.size));
+        append(&resource.bufferUsage, sizeof(resource.bufferUsage));
+    }
+    return key;
+}
+
+static void fillImageInfo(const LittleGFXRGImageDesc& desc, VkImageUsageFlags usage, VkImageCreateInfo& imageInfo)
+{
+    imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = desc.imageType;
+    imageInfo.format = desc.format;
+    imageInfo.extent = desc.extent;
+    imageInfo.mipLevels = desc.mipLevels;
+    imageInfo.arrayLayers = desc.arrayLayers;
+    imageInfo.samples = desc.samples;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+static void fillBufferInfo(const LittleGFXRGBufferDesc& desc, VkBufferUsageFlags usage, VkBufferCreateInfo& bufferInfo)
+{
+    bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = desc.size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+}
+
+bool LittleGFXRenderGraph::queryRequirements(Resource& resource)
+{
+    const std::string key = resourceKey(resource);
+    auto iter = requirementsCache.find(key);
+    if (iter != requirementsCache.end())
+    {
+        resource.memoryRequirements = iter->second;
+        return true;
+    }
+    // 第一次遇到这种描述时创建一个不绑定内存的对象查询需求，之后直接查表
+    auto& table = gfxDevice->GetVolkTable();
+    auto device = gfxDevice->GetVkDevice();
+    if (resource.isImage)
+    {
+        VkImageCreateInfo imageInfo;
+        fillImageInfo(resource.imageDesc, resource.imageUsage, imageInfo);
+        VkImage image = VK_NULL_HANDLE;
+        if (table.vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) return false;
+        table.vkGetImageMemoryRequirements(device, image, &resource.memoryRequirements);
+        table.vkDestroyImage(device, image, nullptr);
+    }
+    else
+    {
+        VkBufferCreateInfo bufferInfo;
+        fillBufferInfo(resource.bufferDesc, resource.bufferUsage, bufferInfo);
+        VkBuffer buffer = VK_NULL_HANDLE;
+        if (table.vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) return false;
+        table.vkGetBufferMemoryRequirements(device, buffer, &resource.memoryRequirements);
+        table.vkDestroyBuffer(device, buffer, nullptr);
+    }
+    requirementsCache.emplace(key, resource.memoryRequirements);
+    return true;
+}
+
+VkDeviceSize LittleGFXRenderGraph::placeResources(const std::vector<LittleGFXRGResource>& group)
+{
+    // 从大到小依次放置，每个资源放在最低的、和已放置的生命周期重叠的资源都不冲突的偏移上。
+    // 大小相同时按声明顺序，保证同样的帧每次得到同样的布局，缓存的资源才能复用
+    std::vector<LittleGFXRGResource> order = group;
+    std::stable_sort(order.begin(), order.end(), [this](LittleGFXRGResource a, LittleGFXRGResource b) {
+        return resources[a].memoryRequirements.size > resources[b].memoryRequirements.size;
+    });
+    auto lifetimeOverlaps = [](const Resource& a, const Resource& b) {
+        if (a.asyncAccess || b.asyncAccess) return true;
+        return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+    };
+    auto memoryOverlaps = [](const Resource& a, const Resource& b) {
+        return a.heapOffset < b.heapOffset + b.memoryRequirements.size && b.heapOffset < a.heapOffset + a.memoryRequirements.size;
+    };
+    VkDeviceSize heapSize = 0;
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        auto& resource = resources[order[i]];
+        const VkDeviceSize alignment = std::max<VkDeviceSize>(resource.memoryRequirements.alignment, 1);
+        resource.heapOffset = 0;
+        bool moved = true;
+        while (moved)
+        {
+            moved = false;
+            for (size_t j = 0; j < i; j++)
+            {
+                const auto& placed = resources[order[j]];
+                if (!lifetimeOverlaps(resource, placed) || !memoryOverlaps(resource, placed)) continue;
+                resource.heapOffset = (placed.heapOffset + placed.memoryRequirements.size + alignment - 1) / alignment * alignment;
+                moved = true;
+            }
+        }
+        heapSize = std::max(heapSize, resource.heapOffset + resource.memoryRequirements.size);
+    }
+    // 占用同一段显存、生命周期更早结束的资源是后来者的前驱，后来者第一次使用前要等它们
+    for (auto a : group)
+    {
+        for (auto b : group)
+        {
+            if (a != b && resources[a].lastPass < resources[b].firstPass && memoryOverlaps(resources[a], resources[b]))
+                resources[b].aliasPredecessors.emplace_back(a);
+        }
+    }
+    return heapSize;
+}
+
+uint32_t LittleGFXRenderGraph::acquireHeap(bool linear, uint32_t memoryTypeBits, VkDeviceSize size, VkDeviceSize alignment)
+{
+    for (uint32_t i = 0; i < heaps.size(); i++)
+    {
+        auto& heap = heaps[i];
+        if (heap.linear != linear || heap.memoryTypeBits != memoryTypeBits || heap.allocation.size < size) continue;
+        // 偏移是相对堆起点算的，堆本身的偏移也要满足对齐
+        if (heap.allocation.offset % alignment != 0) continue;
+        heap.lastUsedFrame = frameIndex;
+        return i;
+    }
+    TransientHeap heap;
+    heap.id = nextHeapId++;
+    heap.linear = linear;
+    heap.memoryTypeBits = memoryTypeBits;
+    VkMemoryRequirements requirements = {};
+    requirements.size = size;
+    requirements.alignment = alignment;
+    requirements.memoryTypeBits = memoryTypeBits;
+    if (!gfxDevice->GetMemoryAllocator()->Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, linear, heap.allocation))
+        return UINT32_MAX;
+    heap.lastUsedFrame = frameIndex;
+    heaps.emplace_back(heap);
+    return (uint32_t)heaps.size() - 1;
+}
+
+bool LittleGFXRenderGraph::acquirePhysical(Resource& resource)
+{
+    const auto& heap = heaps[resource.heapIndex];
+    std::string key = resourceKey(resource);
+    key.append((const char*)&heap.id, sizeof(heap.id));
+    key.append((const char*)&resource.heapOffset, sizeof(resource.heapOffset));
+    auto iter = physicalResources.find(key);
+    if (iter != physicalResources.end())
+    {
+        // 同一帧里描述和位置都相同的两个资源生命周期一定不重叠，共用一个对象也没有问题
+        iter->second.lastUsedFrame = frameIndex;
+        resource.image = iter->second.image;
+        resource.view = iter->second.view;
+        resource.buffer = iter->second.buffer;
+        return true;
+    }
+    auto& table = gfxDevice->GetVolkTable();
+    auto device = gfxDevice->GetVkDevice();
+    const VkDeviceSize memoryOffset = heap.allocation.offset + resource.heapOffset;
+    PhysicalResource physical;
+    physical.isImage = resource.isImage;
+    physical.heapId = heap.id;
+    physical.lastUsedFrame = frameIndex;
+    if (resource.isImage)
+    {
+        const auto& desc = resource.imageDesc;
+        VkImageCreateInfo imageInfo;
+        fillImageInfo(desc, resource.imageUsage, imageInfo);
+        if (table.vkCreateImage(device, &imageInfo, nullptr, &physical.image) != VK_SUCCESS) return false;
+        table.vkBindImageMemory(device, physical.image, heap.allocation.memory, memoryOffset);
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = physical.image;
+        if (desc.imageType == VK_IMAGE_TYPE_3D)
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
+        else if (desc.imageType == VK_IMAGE_TYPE_1D)
+            viewInfo.viewType = desc.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_1D_ARRAY : VK_IMAGE_VIEW_TYPE_1D;
+        else
+            viewInfo.viewType = desc.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = desc.format;
+        viewInfo.subresourceRange.aspectMask = resource.aspect;
+        viewInfo.subresourceRange.levelCount = desc.mipLevels;
+        viewInfo.subresourceRange.layerCount = desc.arrayLayers;
+        table.vkCreateImageView(device, &viewInfo, nullptr, &physical.view);
+    }
+    else
+    {
+        VkBufferCreateInfo bufferInfo;
+        fillBufferInfo(resource.bufferDesc, resource.bufferUsage, bufferInfo);
+        if (table.vkCreateBuffer(device, &bufferInfo, nullptr, &physical.buffer) != VK_SUCCESS) return false;
+        table.vkBindBufferMemory(device, physical.buffer, heap.allocation.memory, memoryOffset);
+    }
+    resource.image = physical.image;
+    resource.view = physical.view;
+    resource.buffer = physical.buffer;
+    physicalResources.emplace(std::move(key), physical);
+    return true;
+}
+
+void LittleGFXRenderGraph::destroyPhysical(PhysicalResource& physical)
+{
+    auto& table = gfxDevice->GetVolkTable();
+    auto device = gfxDevice->GetVkDevice();
+    if (physical.view != VK_NULL_HANDLE) table.vkDestroyImageView(device, physical.view, nullptr);
+    if (physical.image != VK_NULL_HANDLE) table.vkDestroyImage(device, physical.image, nullptr);
+    if (physical.buffer != VK_NULL_HANDLE) table.vkDestroyBuffer(device, physical.buffer, nullptr);
+}
+
+void LittleGFXRenderGraph::retireHeap(size_t heapIndex)
+{
+    // 之前提交的帧可能还在使用这个堆，等它们执行完再释放
+    const uint64_t retireValue = gfxDevice->GetGraphicsQueue()->GetLastSubmittedValue();
+    const uint32_t heapId = heaps[heapIndex].id;
+    for (auto iter = physicalResources.begin(); iter != physicalResources.end();)
+    {
+        if (iter->second.heapId != heapId)
+        {
+            ++iter;
+            continue;
+        }
+        retiredPhysicals.push_back({ iter->second, retireValue });
+        iter = physicalResources.erase(iter);
+    }
+    retiredHeaps.push_back({ heaps[heapIndex].allocation, retireValue });
+    heaps.erase(heaps.begin() + heapIndex);
+}
+
+void LittleGFXRenderGraph::trimPhysicalResources()
+{
+    frameIndex++;
+    auto queue = gfxDevice->GetGraphicsQueue();
+    const uint64_t retireValue = queue->GetLastSubmittedValue();
+    for (auto iter = physicalResources.begin(); iter != physicalResources.end();)
+    {
+        if (frameIndex - iter->second.lastUsedFrame <= LITTLE_GFX_RG_POOL_FRAMES)
+        {
+            ++iter;
+            continue;
+        }
+        retiredPhysicals.push_back({ iter->second, retireValue });
+        iter = physicalResources.erase(iter);
+    }
+    for (size_t i = heaps.size(); i-- > 0;)
+    {
+        if (frameIndex - heaps[i].lastUsedFrame > LITTLE_GFX_RG_POOL_FRAMES) retireHeap(i);
+    }
+    // 退役的对象按提交顺序排列，遇到第一个还没执行完的就可以停下
+    size_t completed = 0;
+    while (completed < retiredPhysicals.size() && queue->IsComplete(retiredPhysicals[completed].retireValue))
+    {
+        destroyPhysical(retiredPhysicals[completed].physical);
+        completed++;
+    }
+    retiredPhysicals.erase(retiredPhysicals.begin(), retiredPhysicals.begin() + completed);
+    completed = 0;
+    while (completed < retiredHeaps.size() && queue->IsComplete(retiredHeaps[completed].retireValue))
+    {
+        gfxDevice->GetMemoryAllocator()->Free(retiredHeaps[completed].allocation);
+        completed++;
+    }
+    retiredHeaps.erase(retiredHeaps.begin(), retiredHeaps.begin() + completed);
+}
+
+// 计算队列上的屏障只能使用这些阶段
+static const VkPipelineStageFlags2KHR computeQueueStages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR |
+    VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR | VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+
+void LittleGFXRenderGraph::transition(Resource& resource, VkPipelineStageFlags2KHR stages, VkAccessFlags2KHR access,
+    VkImageLayout layout, bool write, LittleGFXRGQueue queue, uint32_t pass, BarrierBatch& batch)
+{
+    auto& state = resource.state;
+    // 计算队列不支持图形阶段，只裁剪目标一侧；换队列时的释放屏障仍然要用原队列上完整的阶段来构造
+    if (queue == LittleGFXRGQueue::AsyncCompute) stages &= computeQueueStages;
+    if (state.queue != LittleGFXRGQueue::Count && state.queue != queue)
+    {
+        transferOwnership(resource, stages, access, layout, write, queue, batch);
+        state.lastPass = pass;
+        return;
+    }
+    if (queue == LittleGFXRGQueue::AsyncCompute)
+    {
+        state.writeStages &= computeQueueStages;
+        state.readStages &= computeQueueStages;
+    }
+    state.queue = queue;
+    state.lastPass = pass;
+    const bool layoutChange = resource.isImage && layout != state.layout;
+    VkPipelineStageFlags2KHR srcStages = 0;
+    VkAccessFlags2KHR srcAccess = 0;
+    if (layoutChange || write)
+    {
+        // 写入和布局转换都要等待之前的写入和读取全部完成
+        srcStages = state.writeStages | state.readStages;
+        srcAccess = state.writeAccess;
+    }
+    else if (state.writeAccess != 0 || state.writeStages != 0)
+    {
+        // 读之后的读不需要屏障，只有还没有看到最近一次写入的阶段才需要
+        if ((stages & ~state.readStages) == 0) return;
+        srcStages = state.writeStages;
+        srcAccess = state.writeAccess;
+    }
+    if (srcStages != 0 || layoutChange)
+    {
+        if (resource.isImage)
+        {
+            VkImageMemoryBarrier2KHR barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+            barrier.srcStageMask = srcStages;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstStageMask = stages;
+            barrier.dstAccessMask = access;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = resource.image;
+            barrier.subresourceRange.aspectMask = resource.aspect;
+            barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+            batch.imageBarriers.emplace_back(barrier);
+        }
+        else
+        {
+            batch.memoryBarrier.srcStageMask |= srcStages;
+            batch.memoryBarrier.srcAccessMask |= srcAccess;
+            batch.memoryBarrier.dstStageMask |= stages;
+            batch.memoryBarrier.dstAccessMask |= access;
+        }
+    }
+    if (write)
+    {
+        state.writeStages = stages;
+        state.writeAccess = access;
+        state.readStages = 0;
+    }
+    else if (layoutChange)
+    {
+        // 布局转换本身相当于一次写入，转换对这次的阶段已经可见，之后别的阶段读取时仍然要等它
+        state.writeStages = stages;
+        state.writeAccess = 0;
+        state.readStages = stages;
+    }
+    else
+    {
+        state.readStages |= stages;
+    }
+    state.layout = layout;
+}
+
+void LittleGFXRenderGraph::transferOwnership(Resource& resource, VkPipelineStageFlags2KHR stages, VkAccessFlags2KHR access,
+    VkImageLayout layout, bool write, LittleGFXRGQueue queue, BarrierBatch& batch)
+{
+    auto& state = resource.state;
+    const uint32_t srcFamily = getQueue(state.queue)->GetFamilyIndex();
+    const uint32_t dstFamily = getQueue(queue)->GetFamilyIndex();
+    // 内容不需要保留的图像（这一帧还没写过）不用转移所有权，直接在新队列上从UNDEFINED转换
+    const bool keepContents = !resource.isImage || state.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+    const bool transfer = keepContents && srcFamily != dstFamily;
+    // 释放放在原队列上最后一次访问之后，图开始之前就属于原队列的导入资源放在开头的单独提交里
+    BarrierBatch& releaseBatch = state.lastPass < postBarrierBatches.size() ? postBarrierBatches[state.lastPass] : prologueBatch;
+    if (resource.isImage)
+    {
+        VkImageMemoryBarrier2KHR barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        barrier.oldLayout = keepContents ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = layout;
+        barrier.srcQueueFamilyIndex = transfer ? srcFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = transfer ? dstFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.image;
+        barrier.subresourceRange.aspectMask = resource.aspect;
+        barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        if (transfer)
+        {
+            // 释放和获取两边的布局必须一致，布局转换只会执行一次
+            VkImageMemoryBarrier2KHR release = barrier;
+            release.srcStageMask = state.writeStages | state.readStages;
+            release.srcAccessMask = state.writeAccess;
+            releaseBatch.imageBarriers.emplace_back(release);
+        }
+        barrier.dstStageMask = stages;
+        barrier.dstAccessMask = access;
+        batch.imageBarriers.emplace_back(barrier);
+    }
+    else if (transfer)
+    {
+        VkBufferMemoryBarrier2KHR barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+        barrier.srcQueueFamilyIndex = srcFamily;
+        barrier.dstQueueFamilyIndex = dstFamily;
+        barrier.buffer = resource.buffer;
+        barrier.size = VK_WHOLE_SIZE;
+        VkBufferMemoryBarrier2KHR release = barrier;
+        release.srcStageMask = state.writeStages | state.readStages;
+        release.srcAccessMask = state.writeAccess;
+        releaseBatch.bufferBarriers.emplace_back(release);
+        barrier.dstStageMask = stages;
+        barrier.dstAccessMask = access;
+        batch.bufferBarriers.emplace_back(barrier);
+    }
+    if (transfer) stats.ownershipTransferCount++;
+    // 信号量等待保证了原队列上的访问已经完成并且可见，获取屏障对这次的阶段相当于一次写入
+    state.queue = queue;
+    state.layout = layout;
+    state.writeStages = stages;
+    state.writeAccess = write ? access : 0;
+    state.readStages = write ? 0 : stages;
+}
+
+void LittleGFXRenderGraph::resetBatch(BarrierBatch& batch)
+{
+    batch.imageBarriers.clear();
+    batch.bufferBarriers.clear();
+    batch.memoryBarrier = {};
+    batch.memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+}
+
+void LittleGFXRenderGraph::computeBarriers()
+{
+    barrierBatches.resize(schedule.size() + 1);
+    postBarrierBatches.resize(schedule.size());
+    for (auto& batch : barrierBatches) resetBatch(batch);
+    for (auto& batch : postBarrierBatches) resetBatch(batch);
+    resetBatch(prologueBatch);
+    // 同一个通道对同一个资源的多次访问合并成一次转换
+    struct MergedAccess {
+        LittleGFXRGResource resource;
+        VkPipelineStageFlags2KHR stages;
+        VkAccessFlags2KHR access;
+        VkImageLayout layout;
+        bool write;
+    };
+    std::vector<MergedAccess> merged;
+    for (uint32_t p = 0; p < schedule.size(); p++)
+    {
+        auto& batch = barrierBatches[p];
+        merged.clear();
+        for (const auto& access : schedule[p]->accesses)
+        {
+            const auto& info = usageInfos[(uint32_t)access.usage];
+            const VkAccessFlags2KHR accessMask = access.write ? (info.readAccess | info.writeAccess) : info.readAccess;
+            const VkImageLayout layout = access.write ? info.writeLayout : info.readLayout;
+            MergedAccess* target = nullptr;
+            for (auto& m : merged)
+            {
+                if (m.resource == access.resource) target = &m;
+            }
+            if (!target)
+            {
+                merged.push_back({ access.resource, info.stages, accessMask, layout, access.write });
+                continue;
+            }
+            target->stages |= info.stages;
+            target->access |= accessMask;
+            target->write |= access.write;
+            // 一个通道里以两种布局使用同一张图像时只能用GENERAL
+            if (target->layout != layout) target->layout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+        for (const auto& m : merged)
+        {
+            auto& resource = resources[m.resource];
+            // 临时资源第一次使用时，先占用同一段显存的资源在这之前都已经走完了最后一次访问
+            if (!resource.imported && resource.firstPass == p)
+            {
+                for (auto predecessor : resource.aliasPredecessors)
+                {
+                    const auto& state = resources[predecessor].state;
+                    resource.state.writeStages |= state.writeStages | state.readStages;
+                    resource.state.writeAccess |= state.writeAccess;
+                }
+            }
+            transition(resource, m.stages, m.access, m.layout, m.write, passQueues[p], p, batch);
+        }
+    }
+    // 图执行完毕后导入的资源回到graphics queue，导入的图像转换到调用方要求的布局，之后的命令可以直接使用它们
+    auto& finalBatch = barrierBatches.back();
+    const uint32_t finalPass = (uint32_t)schedule.size();
+    for (auto& resource : resources)
+    {
+        if (!resource.used || !resource.imported) continue;
+        const bool hasFinalLayout = resource.isImage && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+        const VkImageLayout layout = hasFinalLayout ? resource.finalLayout : resource.state.layout;
+        if (resource.state.queue == LittleGFXRGQueue::AsyncCompute || hasFinalLayout)
+        {
+            transition(resource, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR,
+                VK_ACCESS_2_MEMORY_READ_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR, layout, false,
+                LittleGFXRGQueue::Graphics, finalPass, finalBatch);
+        }
+    }
+    // 记下每个堆最后被访问的阶段，下一帧第一次占用堆里显存的资源只需要等待这些阶段
+    for (auto& heap : heaps)
+    {
+        if (heap.lastUsedFrame != frameIndex) continue;
+        heap.lastStages = 0;
+        heap.lastWriteAccess = 0;
+    }
+    for (const auto& resource : resources)
+    {
+        if (!resource.used || resource.imported || resource.heapIndex == UINT32_MAX) continue;
+        auto& heap = heaps[resource.heapIndex];
+        heap.lastStages |= resource.state.writeStages | resource.state.readStages;
+        heap.lastWriteAccess |= resource.state.writeAccess;
+    }
+    auto countBatch = [this](const BarrierBatch& batch) {
+        const bool hasMemoryBarrier = batch.memoryBarrier.dstStageMask != 0;
+        if (batch.imageBarriers.empty() && batch.bufferBarriers.empty() && !hasMemoryBarrier) return;
+        stats.barrierBatchCount++;
+        stats.imageBarrierCount += (uint32_t)batch.imageBarriers.size();
+        stats.memoryBarrierCount += hasMemoryBarrier ? 1 : 0;
+    };
+    countBatch(prologueBatch);
+    for (const auto& batch : barrierBatches) countBatch(batch);
+    for (const auto& batch : postBarrierBatches) countBatch(batch);
+    if (!prologueBatch.imageBarriers.empty() || !prologueBatch.bufferBarriers.empty()) stats.submissionCount++;
+}
+
+void LittleGFXRenderGraph::recordBarriers(VkCommandBuffer cmd, const BarrierBatch& batch)
+{
+    const bool hasMemoryBarrier = batch.memoryBarrier.dstStageMask != 0;
+    if (batch.imageBarriers.empty() && batch.bufferBarriers.empty() && !hasMemoryBarrier) return;
+    auto& table = gfxDevice->GetVolkTable();
+    if (gfxDevice->IsSynchronization2Enabled())
+    {
+        VkDependencyInfoKHR dependencyInfo = {};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependencyInfo.memoryBarrierCount = hasMemoryBarrier ? 1 : 0;
+        dependencyInfo.pMemoryBarriers = &batch.memoryBarrier;
+        dependencyInfo.bufferMemoryBarrierCount = (uint32_t)batch.bufferBarriers.size();
+        dependencyInfo.pBufferMemoryBarriers = batch.bufferBarriers.data();
+        dependencyInfo.imageMemoryBarrierCount = (uint32_t)batch.imageBarriers.size();
+        dependencyInfo.pImageMemoryBarriers = batch.imageBarriers.data();
+        table.vkCmdPipelineBarrier2KHR(cmd, &dependencyInfo);
+        return;
+    }
+    // 没有synchronization2时退回到老的屏障。用到的阶段和访问位在两套枚举里的值相同，
+    // 只是老接口的阶段是整个调用共用的，所以合并成一组
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    if (hasMemoryBarrier)
+    {
+        srcStages |= (VkPipelineStageFlags)batch.memoryBarrier.srcStageMask;
+        dstStages |= (VkPipelineStageFlags)batch.memoryBarrier.dstStageMask;
+        memoryBarrier.srcAccessMask = (VkAccessFlags)batch.memoryBarrier.srcAccessMask;
+        memoryBarrier.dstAccessMask = (VkAccessFlags)batch.memoryBarrier.dstAccessMask;
+    }
+    std::vector<VkBufferMemoryBarrier> bufferBarriers(batch.bufferBarriers.size());
+    for (size_t i = 0; i < batch.bufferBarriers.size(); i++)
+    {
+        const auto& src = batch.bufferBarriers[i];
+        auto& dst = bufferBarriers[i];
+        dst = {};
+        dst.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        dst.srcAccessMask = (VkAccessFlags)src.srcAccessMask;
+        dst.dstAccessMask = (VkAccessFlags)src.dstAccessMask;
+        dst.srcQueueFamilyIndex = src.srcQueueFamilyIndex;
+        dst.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+        dst.buffer = src.buffer;
+        dst.offset = src.offset;
+        dst.size = src.size;
+        srcStages |= (VkPipelineStageFlags)src.srcStageMask;
+        dstStages |= (VkPipelineStageFlags)src.dstStageMask;
+    }
+    std::vector<VkImageMemoryBarrier> imageBarriers(batch.imageBarriers.size());
+    for (size_t i = 0; i < batch.imageBarriers.size(); i++)
+    {
+        const auto& src = batch.imageBarriers[i];
+        auto& dst = imageBarriers[i];
+        dst = {};
+        dst.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        dst.srcAccessMask = (VkAccessFlags)src.srcAccessMask;
+        dst.dstAccessMask = (VkAccessFlags)src.dstAccessMask;
+        dst.oldLayout = src.oldLayout;
+        dst.newLayout = src.newLayout;
+        dst.srcQueueFamilyIndex = src.srcQueueFamilyIndex;
+        dst.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+        dst.image = src.image;
+        dst.subresourceRange = src.subresourceRange;
+        srcStages |= (VkPipelineStageFlags)src.srcStageMask;
+        dstStages |= (VkPipelineStageFlags)src.dstStageMask;
+    }
+    if (srcStages == 0) srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    if (dstStages == 0) dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    table.vkCmdPipelineBarrier(cmd, srcStages, dstStages, 0, hasMemoryBarrier ? 1 : 0, &memoryBarrier,
+        (uint32_t)bufferBarriers.size(), bufferBarriers.data(), (uint32_t)imageBarriers.size(), imageBarriers.data());
+}
+
+LittleGFXQueue* LittleGFXRenderGraph::getQueue(LittleGFXRGQueue queue)
+{
+    return queue == LittleGFXRGQueue::AsyncCompute ? gfxDevice->GetComputeQueue() : gfxDevice->GetGraphicsQueue();
+}
+
+void LittleGFXRenderGraph::recordChunk(RecordChunk& chunk, uint32_t threadIndex)
+{
+    auto allocator = gfxDevice->GetCommandAllocator();
+    VkCommandBuffer cmd = allocator->AllocatePrimary(threadIndex, getQueue(segments[chunk.segment].queue));
+    chunk.commandBuffer = cmd;
+    if (cmd == VK_NULL_HANDLE) return;
+    for (auto p : chunk.passes)
+    {
+        recordBarriers(cmd, barrierBatches[p]);
+        if (schedule[p]->execute) schedule[p]->execute(*this, cmd);
+        recordBarriers(cmd, postBarrierBatches[p]);
+    }
+    gfxDevice->GetVolkTable().vkEndCommandBuffer(cmd);
+}
+
+void LittleGFXRenderGraph::gatherSegmentResources(uint32_t segment, std::vector<LittleGFXRGResource>& outResources) const
+{
+    outResources.clear();
+    for (uint32_t p = segments[segment].firstPass; p <= segments[segment].lastPass; p++)
+    {
+        if (passSegments[p] != segment) continue;
+        for (const auto& access : schedule[p]->accesses)
+        {
+            if (std::find(outResources.begin(), outResources.end(), access.resource) == outResources.end())
+                outResources.emplace_back(access.resource);
+        }
+    }
+}
+
+void LittleGFXRenderGraph::updateGraphicsUses()
+{
+    auto gfxQueue = getQueue(LittleGFXRGQueue::Graphics);
+    // 上一帧没有提交（比如中途失败）时，录制进它的访问也不会执行
+    const bool frameSubmitted = lastFrame != nullptr && lastFrame->frameNumber > lastFrameNumber;
+    for (auto& heap : heaps)
+    {
+        for (auto iter = heap.graphicsUses.begin(); iter != heap.graphicsUses.end();)
+        {
+            if (iter->value == 0)
+            {
+                if (!frameSubmitted)
+                {
+                    iter = heap.graphicsUses.erase(iter);
+                    continue;
+                }
+                iter->value = lastFrame->timelineValue;
+            }
+            if (gfxQueue->IsComplete(iter->value))
+                iter = heap.graphicsUses.erase(iter);
+            else
+                ++iter;
+        }
+    }
+    lastFrame = nullptr;
+}
+
+void LittleGFXRenderGraph::Execute(LittleGFXFrame* frame)
+{
+    if (!compiled)
+    {
+        assert(0 && "render graph must be compiled before execution!");
+        return;
+    }
+    auto& table = gfxDevice->GetVolkTable();
+    auto allocator = gfxDevice->GetCommandAllocator();
+    auto gfxQueue = getQueue(LittleGFXRGQueue::Graphics);
+    // 先录制所有的块：第一块留给调用线程自己，其余的交给线程池，全部录完之后再按顺序提交
+    if (threadPool != nullptr && recordChunks.size() > 1)
+    {
+        for (uint32_t c = 1; c < recordChunks.size(); c++)
+        {
+            threadPool->Submit([this, c](uint32_t workerIndex) {
+                recordChunk(recordChunks[c], workerIndex + 1);
+            });
+        }
+        recordChunk(recordChunks[0], LITTLE_GFX_COMMAND_MAIN_THREAD);
+        threadPool->WaitIdle();
+    }
+    else
+    {
+        for (auto& chunk : recordChunks)
+        {
+            recordChunk(chunk, LITTLE_GFX_COMMAND_MAIN_THREAD);
+        }
+    }
+    auto submit = [&](LittleGFXRGQueue queue, const VkCommandBuffer* cmds, uint32_t cmdCount,
+        const LittleGFXQueueWait* waits, uint32_t waitCount) {
+        LittleGFXSubmitDesc submitDesc = {};
+        submitDesc.commandBuffers = cmds;
+        submitDesc.commandBufferCount = cmdCount;
+        submitDesc.waits = waits;
+        submitDesc.waitCount = waitCount;
+        return getQueue(queue)->Enqueue(submitDesc);
+    };
+    // 导入资源的所有权释放要在任何计算段之前提交
+    if (!prologueBatch.imageBarriers.empty() || !prologueBatch.bufferBarriers.empty())
+    {
+        VkCommandBuffer cmd = allocator->AllocatePrimary(LITTLE_GFX_COMMAND_MAIN_THREAD, gfxQueue);
+        if (cmd != VK_NULL_HANDLE)
+        {
+            recordBarriers(cmd, prologueBatch);
+            table.vkEndCommandBuffer(cmd);
+            submit(LittleGFXRGQueue::Graphics, &cmd, 1, nullptr, 0);
+        }
+    }
+    updateGraphicsUses();
+    // 导入的资源可能被图之外的任何图形命令写过，访问它们的计算段要等待这之前提交的所有图形命令
+    const uint64_t previousGraphicsValue = gfxQueue->GetLastSubmittedValue();
+    // 计算队列按顺序执行，等待过的值之后的计算段不必再等
+    uint64_t computeWaitedValue = 0;
+    uint64_t lastComputeValue = 0;
+    // 这一帧图形段访问的显存，所有段提交完之后再记到堆上，同一帧里的跨队列依赖已经由段之间的等待保证了
+    std::vector<std::pair<uint32_t, GraphicsUse>> frameGraphicsUses;
+    std::vector<LittleGFXRGResource> segmentResources;
+    std::vector<uint64_t> segmentValues(segments.size(), 0);
+    std::vector<VkCommandBuffer> segmentCommandBuffers;
+    uint32_t chunkIndex = 0;
+    for (uint32_t s = 0; s < segments.size(); s++)
+    {
+        const auto& segment = segments[s];
+        // 块按段的顺序排列，这一段的块就是接下来连续的几个
+        segmentCommandBuffers.clear();
+        for (; chunkIndex < recordChunks.size() && recordChunks[chunkIndex].segment == s; chunkIndex++)
+        {
+            // 分配失败的块已经断言过了，不能把空句柄交给队列
+            if (recordChunks[chunkIndex].commandBuffer == VK_NULL_HANDLE) continue;
+            segmentCommandBuffers.emplace_back(recordChunks[chunkIndex].commandBuffer);
+        }
+        LittleGFXQueueWait waits[2];
+        uint32_t waitCount = 0;
+        if (segment.waitSegment != UINT32_MAX)
+        {
+            waits[waitCount].queue = getQueue(segments[segment.waitSegment].queue);
+            waits[waitCount].value = segmentValues[segment.waitSegment];
+            waitCount++;
+        }
+        gatherSegmentResources(s, segmentResources);
+        if (segment.queue == LittleGFXRGQueue::AsyncCompute)
+        {
+            // 只等待真正和这一段有关的图形命令：之前的帧最后访问同一段临时显存的提交，以及访问导入资源时之前的所有图形命令
+            uint64_t graphicsValue = 0;
+            for (auto index : segmentResources)
+            {
+                const auto& resource = resources[index];
+                if (resource.imported)
+                {
+                    graphicsValue = std::max(graphicsValue, previousGraphicsValue);
+                    continue;
+                }
+                if (resource.heapIndex == UINT32_MAX) continue;
+                for (const auto& use : heaps[resource.heapIndex].graphicsUses)
+                {
+                    if (use.offset < resource.heapOffset + resource.memoryRequirements.size &&
+                        resource.heapOffset < use.offset + use.size)
+                        graphicsValue = std::max(graphicsValue, use.value);
+                }
+            }
+            if (graphicsValue > computeWaitedValue)
+            {
+                waits[waitCount].queue = gfxQueue;
+                waits[waitCount].value = graphicsValue;
+                waitCount++;
+                computeWaitedValue = graphicsValue;
+            }
+            segmentValues[s] = submit(segment.queue, segmentCommandBuffers.data(), (uint32_t)segmentCommandBuffers.size(),
+                waits, waitCount);
+            lastComputeValue = segmentValues[s];
+            continue;
+        }
+        if (s == finalSegment)
+        {
+            // 最后一段由窗口和帧的命令缓冲一起提交，它的等待交给frame，时间线值留到下一次Execute再确定
+            frame->commandBuffers.insert(frame->commandBuffers.end(), segmentCommandBuffers.begin(), segmentCommandBuffers.end());
+            recordBarriers(frame->commandBuffer, barrierBatches.back());
+            frame->waits.insert(frame->waits.end(), waits, waits + waitCount);
+        }
+        else
+        {
+            segmentValues[s] = submit(segment.queue, segmentCommandBuffers.data(), (uint32_t)segmentCommandBuffers.size(),
+                waits, waitCount);
+        }
+        for (auto index : segmentResources)
+        {
+            const auto& resource = resources[index];
+            if (resource.imported || resource.heapIndex == UINT32_MAX) continue;
+            GraphicsUse use;
+            use.offset = resource.heapOffset;
+            use.size = resource.memoryRequirements.size;
+            use.value = segmentValues[s];
+            frameGraphicsUses.emplace_back(resource.heapIndex, use);
+        }
+    }
+    for (const auto& use : frameGraphicsUses)
+    {
+        heaps[use.first].graphicsUses.emplace_back(use.second);
+    }
+    lastFrame = frame;
+    lastFrameNumber = frame->frameNumber;
+    // 帧的命令缓冲等待这一帧所有的计算段，之后的帧和释放临时显存只需要看graphics queue的时间线
+    if (lastComputeValue > 0)
+    {
+        LittleGFXQueueWait wait;
+        wait.queue = getQueue(LittleGFXRGQueue::AsyncCompute);
+        wait.value = lastComputeValue;
+        frame->waits.emplace_back(wait);
+    }
+}
\ No newline at end of file
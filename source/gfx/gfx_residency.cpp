@@ -0,0 +1,202 @@
+#include "gfx/gfx_residency.h"
+#include "gfx/gfx_objects.h"
+#include <algorithm>
+
+bool LittleGFXResidencyManager::initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    budgetExtension = device->gfxAdapter->isExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    const auto& memProps = device->gfxAdapter->vkMemoryProps;
+    heapBudgets.resize(memProps.memoryHeapCount);
+    for (uint32_t heap = 0; heap < memProps.memoryHeapCount; heap++)
+    {
+        heapBudgets[heap].heapSize = memProps.memoryHeaps[heap].size;
+        heapBudgets[heap].deviceLocal = (memProps.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+    queryBudgets();
+    return true;
+}
+
+void LittleGFXResidencyManager::destroy()
+{
+    entries.clear();
+    freeHandles.clear();
+    pendingReclaims.clear();
+}
+
+LittleGFXResidencyHandle LittleGFXResidencyManager::Register(const LittleGFXResidencyDesc& desc)
+{
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    LittleGFXResidencyHandle handle;
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    else
+    {
+        handle = (LittleGFXResidencyHandle)entries.size();
+        entries.emplace_back();
+    }
+    auto& entry = entries[handle];
+    entry.desc = desc;
+    entry.lastUsedFrame = frameIndex;
+    entry.resident = true;
+    entry.alive = true;
+    return handle;
+}
+
+void LittleGFXResidencyManager::Unregister(LittleGFXResidencyHandle handle)
+{
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    if (handle >= entries.size() || !entries[handle].alive) return;
+    entries[handle] = Entry();
+    freeHandles.emplace_back(handle);
+}
+
+void LittleGFXResidencyManager::Touch(LittleGFXResidencyHandle handle)
+{
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    if (handle < entries.size()) entries[handle].lastUsedFrame = frameIndex;
+}
+
+void LittleGFXResidencyManager::SetResident(LittleGFXResidencyHandle handle, VkDeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    if (handle >= entries.size() || !entries[handle].alive) return;
+    entries[handle].desc.size = size;
+    entries[handle].resident = size > 0;
+    entries[handle].lastUsedFrame = frameIndex;
+}
+
+bool LittleGFXResidencyManager::IsResident(LittleGFXResidencyHandle handle)
+{
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    return handle < entries.size() && entries[handle].resident;
+}
+
+void LittleGFXResidencyManager::queryBudgets()
+{
+    if (budgetExtension)
+    {
+        // 预算由操作系统根据所有进程的情况动态调整，所以要每帧重新查询
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = {};
+        budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 memProps2 = {};
+        memProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memProps2.pNext = &budgetProps;
+        vkGetPhysicalDeviceMemoryProperties2(gfxDevice->gfxAdapter->vkPhysicalDevice, &memProps2);
+        for (uint32_t heap = 0; heap < heapBudgets.size(); heap++)
+        {
+            heapBudgets[heap].budget = budgetProps.heapBudget[heap];
+            heapBudgets[heap].usage = budgetProps.heapUsage[heap];
+        }
+    }
+    else
+    {
+        // 没有扩展时只能知道我们自己分配了多少，预算按堆大小的固定比例估计
+        const auto stats = gfxDevice->memoryAllocator.GetStats();
+        for (uint32_t heap = 0; heap < heapBudgets.size(); heap++)
+        {
+            heapBudgets[heap].budget = (VkDeviceSize)(heapBudgets[heap].heapSize * LITTLE_GFX_RESIDENCY_FALLBACK_BUDGET);
+            heapBudgets[heap].usage = stats.heapCommittedBytes[heap];
+        }
+    }
+    // 释放它们的帧执行完之后回调才会销毁资源，这之后的查询结果里已经不再包含它们
+    auto& gfxQueue = gfxDevice->gfxQueue;
+    for (size_t i = 0; i < pendingReclaims.size();)
+    {
+        if (gfxQueue.IsComplete(pendingReclaims[i].timelineValue))
+        {
+            pendingReclaims[i] = pendingReclaims.back();
+            pendingReclaims.pop_back();
+            continue;
+        }
+        auto& heapBudget = heapBudgets[pendingReclaims[i].heapIndex];
+        heapBudget.usage -= std::min(pendingReclaims[i].bytes, heapBudget.usage);
+        i++;
+    }
+}
+
+void LittleGFXResidencyManager::endFrame(uint64_t timelineValue)
+{
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    for (auto& pending : pendingReclaims)
+    {
+        if (pending.timelineValue == UINT64_MAX) pending.timelineValue = timelineValue;
+    }
+}
+
+void LittleGFXResidencyManager::update()
+{
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    frameIndex++;
+    queryBudgets();
+    lastReclaimedBytes = 0;
+    for (uint32_t heap = 0; heap < heapBudgets.size(); heap++)
+    {
+        auto& heapBudget = heapBudgets[heap];
+        const VkDeviceSize target = (VkDeviceSize)(heapBudget.budget * targetFraction);
+        if (heapBudget.usage <= target) continue;
+        const VkDeviceSize reclaimed = reclaimHeap(heap, heapBudget.usage - target);
+        if (reclaimed == 0) continue;
+        // 释放的内存要等回调延迟销毁之后才会反映在查询结果里，在那之前每次查询都把它扣掉
+        heapBudget.usage -= std::min(reclaimed, heapBudget.usage);
+        lastReclaimedBytes += reclaimed;
+        PendingReclaim pending;
+        pending.heapIndex = heap;
+        pending.bytes = reclaimed;
+        pendingReclaims.emplace_back(pending);
+    }
+}
+
+VkDeviceSize LittleGFXResidencyManager::reclaimHeap(uint32_t heapIndex, VkDeviceSize bytesWanted)
+{
+    candidates.clear();
+    for (uint32_t i = 0; i < entries.size(); i++)
+    {
+        const auto& entry = entries[i];
+        if (!entry.alive || !entry.resident || entry.desc.heapIndex != heapIndex) continue;
+        if (entry.desc.priority == LittleGFXResidencyPriority::Critical) continue;
+        candidates.emplace_back(i);
+    }
+    // 优先级低的在前，同优先级里最久没有使用的在前
+    std::sort(candidates.begin(), candidates.end(), [this](LittleGFXResidencyHandle a, LittleGFXResidencyHandle b) {
+        const auto& ea = entries[a];
+        const auto& eb = entries[b];
+        if (ea.desc.priority != eb.desc.priority) return ea.desc.priority < eb.desc.priority;
+        return ea.lastUsedFrame < eb.lastUsedFrame;
+    });
+    VkDeviceSize reclaimed = 0;
+    // 按优先级分档处理，一档里先降级、再驱逐，都不够时才轮到更高的一档，
+    // 这样不会为了腾出空间去降级Normal/High的资源，而让很久没用的Low资源还完整地留在显存里
+    for (size_t tierBegin = 0; tierBegin < candidates.size();)
+    {
+        const auto priority = entries[candidates[tierBegin]].desc.priority;
+        size_t tierEnd = tierBegin;
+        while (tierEnd < candidates.size() && entries[candidates[tierEnd]].desc.priority == priority) tierEnd++;
+        // 先只降级，资源仍然可以被使用，画面只是暂时变模糊
+        for (size_t i = tierBegin; i < tierEnd; i++)
+        {
+            if (reclaimed >= bytesWanted) return reclaimed;
+            auto& entry = entries[candidates[i]];
+            if (!entry.desc.demote) continue;
+            const VkDeviceSize freed = entry.desc.demote(bytesWanted - reclaimed);
+            entry.desc.size -= std::min(freed, entry.desc.size);
+            reclaimed += freed;
+        }
+        // 再驱逐整个资源，上一帧和这一帧用到的资源不驱逐，否则下一帧马上又要重新加载
+        for (size_t i = tierBegin; i < tierEnd; i++)
+        {
+            if (reclaimed >= bytesWanted) return reclaimed;
+            auto& entry = entries[candidates[i]];
+            if (!entry.desc.evict || entry.lastUsedFrame + 1 >= frameIndex) continue;
+            const VkDeviceSize freed = entry.desc.evict(bytesWanted - reclaimed);
+            reclaimed += freed;
+            entry.desc.size = 0;
+            entry.resident = false;
+        }
+        tierBegin = tierEnd;
+    }
+    return reclaimed;
+}
\ No newline at end of file
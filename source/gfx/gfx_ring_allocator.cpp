@@ -0,0 +1,119 @@
+#include "gfx/gfx_ring_allocator.h"
+#include "gfx/gfx_objects.h"
+#include <string.h>
+
+#define ALIGN_UP(value, alignment) (((value) + (alignment) - 1) / (alignment) * (alignment))
+
+bool LittleGFXRingAllocator::initialize(LittleGFXDevice* device, uint32_t partitionCount)
+{
+    gfxDevice = device;
+    // 同一段内存可能被当作uniform或storage缓冲绑定，取两者中更严格的对齐
+    const auto& limits = device->gfxAdapter->vkPhysDeviceProps.properties.limits;
+    minAlignment = limits.minUniformBufferOffsetAlignment;
+    if (limits.minStorageBufferOffsetAlignment > minAlignment) minAlignment = limits.minStorageBufferOffsetAlignment;
+    if (minAlignment == 0) minAlignment = 1;
+    partitions.resize(partitionCount);
+    for (auto& partition : partitions)
+    {
+        partition.chunks.emplace_back();
+        if (!createChunk(LITTLE_GFX_RING_CHUNK_SIZE, partition.chunks.back()))
+        {
+            assert(0 && "fatal: create ring buffer failed!");
+            return false;
+        }
+    }
+    currentPartition = 0;
+    currentChunk = 0;
+    cursor = 0;
+    return true;
+}
+
+void LittleGFXRingAllocator::destroy()
+{
+    for (auto& partition : partitions)
+    {
+        for (auto& chunk : partition.chunks)
+        {
+            gfxDevice->memoryAllocator.DestroyBuffer(chunk.buffer, chunk.allocation);
+        }
+    }
+    partitions.clear();
+}
+
+bool LittleGFXRingAllocator::createChunk(VkDeviceSize capacity, Chunk& outChunk)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // 有ReBAR/SAM或者集成显卡时会选到DEVICE_LOCAL的主机可见内存，GPU读取更快
+    if (!gfxDevice->memoryAllocator.CreateBuffer(bufferInfo,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, outChunk.buffer, outChunk.allocation))
+    {
+        return false;
+    }
+    outChunk.capacity = capacity;
+    return true;
+}
+
+void LittleGFXRingAllocator::beginFrame()
+{
+    std::lock_guard<std::mutex> lock(ringMutex);
+    currentPartition = (currentPartition + 1) % (uint32_t)partitions.size();
+    auto& partition = partitions[currentPartition];
+    // 分区数和帧环的槽位数相同，窗口在BeginFrame里已经等过这个值了，这里不会阻塞
+    gfxDevice->gfxQueue.Wait(partition.timelineValue);
+    currentChunk = 0;
+    cursor = 0;
+    frameUsage = 0;
+}
+
+void LittleGFXRingAllocator::endFrame(uint64_t timelineValue)
+{
+    std::lock_guard<std::mutex> lock(ringMutex);
+    partitions[currentPartition].timelineValue = timelineValue;
+}
+
+bool LittleGFXRingAllocator::Allocate(VkDeviceSize size, LittleGFXRingSlice& outSlice, VkDeviceSize alignment)
+{
+    if (alignment < minAlignment) alignment = minAlignment;
+    std::lock_guard<std::mutex> lock(ringMutex);
+    auto& partition = partitions[currentPartition];
+    VkDeviceSize offset = ALIGN_UP(cursor, alignment);
+    // 当前缓冲放不下时换到分区里的下一个缓冲，都放不下就追加一个，追加的缓冲之后的帧会继续复用
+    while (offset + size > partition.chunks[currentChunk].capacity)
+    {
+        currentChunk++;
+        offset = 0;
+        if (currentChunk == partition.chunks.size())
+        {
+            VkDeviceSize capacity = LITTLE_GFX_RING_CHUNK_SIZE;
+            while (capacity < size) capacity *= 2;
+            partition.chunks.emplace_back();
+            if (!createChunk(capacity, partition.chunks.back()))
+            {
+                partition.chunks.pop_back();
+                currentChunk--;
+                return false;
+            }
+        }
+    }
+    const auto& chunk = partition.chunks[currentChunk];
+    cursor = offset + size;
+    frameUsage += size;
+    outSlice.buffer = chunk.buffer;
+    outSlice.offset = offset;
+    outSlice.size = size;
+    outSlice.mappedData = (uint8_t*)chunk.allocation.mappedData + offset;
+    return true;
+}
+
+bool LittleGFXRingAllocator::Upload(const void* data, VkDeviceSize size, LittleGFXRingSlice& outSlice, VkDeviceSize alignment)
+{
+    if (!Allocate(size, outSlice, alignment)) return false;
+    memcpy(outSlice.mappedData, data, (size_t)size);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,789 @@
+#include "gfx/gfx_shader_cache.h"
+#include "gfx/gfx_objects.h"
+#include <algorithm>
+#include <string.h>
+
+#define SPIRV_MAGIC 0x07230203
+#define SPIRV_HEADER_WORDS 5
+
+// 反射只需要用到的一小部分SPIR-V操作码和枚举值，取自SPIR-V规范
+enum SpirvOp
+{
+    SpvOpName = 5,
+    SpvOpEntryPoint = 15,
+    SpvOpTypeInt = 21,
+    SpvOpTypeFloat = 22,
+    SpvOpTypeVector = 23,
+    SpvOpTypeMatrix = 24,
+    SpvOpTypeImage = 25,
+    SpvOpTypeSampler = 26,
+    SpvOpTypeSampledImage = 27,
+    SpvOpTypeArray = 28,
+    SpvOpTypeRuntimeArray = 29,
+    SpvOpTypeStruct = 30,
+    SpvOpTypePointer = 32,
+    SpvOpTypeForwardPointer = 39,
+    SpvOpConstant = 43,
+    SpvOpSpecConstant = 50,
+    SpvOpFunction = 54,
+    SpvOpFunctionEnd = 56,
+    SpvOpFunctionCall = 57,
+    SpvOpVariable = 59,
+    SpvOpDecorate = 71,
+    SpvOpMemberDecorate = 72,
+    SpvOpTypeAccelerationStructureKHR = 5341
+};
+
+enum SpirvDecoration
+{
+    SpvDecorationBufferBlock = 3,
+    SpvDecorationArrayStride = 6,
+    SpvDecorationMatrixStride = 7,
+    SpvDecorationBuiltIn = 11,
+    SpvDecorationLocation = 30,
+    SpvDecorationBinding = 33,
+    SpvDecorationDescriptorSet = 34,
+    SpvDecorationOffset = 35
+};
+
+enum SpirvStorageClass
+{
+    SpvStorageClassUniformConstant = 0,
+    SpvStorageClassInput = 1,
+    SpvStorageClassUniform = 2,
+    SpvStorageClassPushConstant = 9,
+    SpvStorageClassStorageBuffer = 12
+};
+
+#define SPV_DIM_BUFFER 5
+#define SPV_DIM_SUBPASS_DATA 6
+
+// 一个SPIR-V id的定义以及作用在它上面的修饰
+struct SpirvId {
+    uint32_t opcode = 0;
+    // 指向定义它的指令，operands[0]是指令的第一个操作数
+    const uint32_t* operands = nullptr;
+    uint32_t operandCount = 0;
+    uint32_t set = UINT32_MAX;
+    uint32_t binding = UINT32_MAX;
+    uint32_t location = UINT32_MAX;
+    uint32_t arrayStride = 0;
+    bool builtIn = false;
+    bool bufferBlock = false;
+    // 被OpTypeForwardPointer声明过，结构体可以在它定义之前引用它
+    bool forwardPointer = false;
+    // 在定义之前就被别的类型引用过
+    bool referencedEarly = false;
+    std::vector<uint32_t> memberOffsets;
+    std::vector<uint32_t> memberMatrixStrides;
+    std::string name;
+};
+
+// FNV-1a
+static uint64_t hashCode(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// SPIR-V的字符串按小端序打包在字里，以0结尾
+static std::string readString(const uint32_t* words, uint32_t wordCount)
+{
+    std::string str;
+    for (uint32_t i = 0; i < wordCount; i++)
+    {
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            const char ch = (char)((words[i] >> (c * 8)) & 0xFF);
+            if (ch == 0) return str;
+            str.push_back(ch);
+        }
+    }
+    return str;
+}
+
+static void recordMember(std::vector<uint32_t>& members, uint32_t index, uint32_t value)
+{
+    if (members.size() <= index) members.resize(index + 1, 0);
+    members[index] = value;
+}
+
+// 常量的值，用作数组长度。特化常量取它的默认值
+static uint32_t constantValue(const std::vector<SpirvId>& ids, uint32_t id)
+{
+    const auto& def = ids[id];
+    if ((def.opcode != SpvOpConstant && def.opcode != SpvOpSpecConstant) || def.operandCount < 3) return 1;
+    return def.operands[2];
+}
+
+// 类型在内存中占用的字节数，只用来计算push constant块的大小
+static uint32_t typeSize(const std::vector<SpirvId>& ids, uint32_t typeId, uint32_t matrixStride)
+{
+    const auto& type = ids[typeId];
+    switch (type.opcode)
+    {
+    case SpvOpTypeInt:
+    case SpvOpTypeFloat:
+        return type.operands[1] / 8;
+    case SpvOpTypeVector:
+        return type.operands[2] * typeSize(ids, type.operands[1], 0);
+    case SpvOpTypeMatrix:
+        return type.operands[2] * (matrixStride ? matrixStride : typeSize(ids, type.operands[1], 0));
+    case SpvOpTypeArray:
+    {
+        const uint32_t stride = type.arrayStride ? type.arrayStride : typeSize(ids, type.operands[1], matrixStride);
+        return constantValue(ids, type.operands[2]) * stride;
+    }
+    case SpvOpTypeStruct:
+    {
+        uint32_t size = 0;
+        for (uint32_t m = 1; m < type.operandCount; m++)
+        {
+            const uint32_t member = m - 1;
+            const uint32_t offset = member < type.memberOffsets.size() ? type.memberOffsets[member] : 0;
+            const uint32_t stride = member < type.memberMatrixStrides.size() ? type.memberMatrixStrides[member] : 0;
+            size = std::max(size, offset + typeSize(ids, type.operands[m], stride));
+        }
+        return size;
+    }
+    case SpvOpTypePointer:
+        // PhysicalStorageBuffer的指针是64位的设备地址
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static bool descriptorType(const std::vector<SpirvId>& ids, uint32_t typeId, uint32_t storageClass, VkDescriptorType& outType)
+{
+    const auto& type = ids[typeId];
+    if (storageClass == SpvStorageClassStorageBuffer)
+    {
+        outType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        return true;
+    }
+    if (storageClass == SpvStorageClassUniform)
+    {
+        // 老版本的SPIR-V用BufferBlock修饰的Uniform变量表示存储缓冲
+        outType = type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        return true;
+    }
+    if (storageClass != SpvStorageClassUniformConstant) return false;
+    switch (type.opcode)
+    {
+    case SpvOpTypeSampler:
+        outType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        return true;
+    case SpvOpTypeSampledImage:
+        outType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        return true;
+    case SpvOpTypeAccelerationStructureKHR:
+        outType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        return true;
+    case SpvOpTypeImage:
+    {
+        // operands: result, sampled type, dim, depth, arrayed, ms, sampled(1为采样, 2为读写)
+        const uint32_t dim = type.operands[2];
+        const uint32_t sampled = type.operands[6];
+        if (dim == SPV_DIM_SUBPASS_DATA)
+            outType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        else if (dim == SPV_DIM_BUFFER)
+            outType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        else
+            outType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static VkFormat vertexFormat(const std::vector<SpirvId>& ids, uint32_t typeId)
+{
+    uint32_t components = 1;
+    const SpirvId* scalar = &ids[typeId];
+    if (scalar->opcode == SpvOpTypeVector)
+    {
+        components = scalar->operands[2];
+        scalar = &ids[scalar->operands[1]];
+    }
+    if (components < 1 || components > 4) return VK_FORMAT_UNDEFINED;
+    // 矩阵、结构体等输入需要拆成多个location，这里不推导它们的格式
+    if (scalar->opcode != SpvOpTypeFloat && scalar->opcode != SpvOpTypeInt) return VK_FORMAT_UNDEFINED;
+    const uint32_t width = scalar->operands[1];
+    static const VkFormat floatFormats[3][4] = {
+        { VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT },
+        { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+        { VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT }
+    };
+    static const VkFormat sintFormats[3][4] = {
+        { VK_FORMAT_R16_SINT, VK_FORMAT_R16G16_SINT, VK_FORMAT_R16G16B16_SINT, VK_FORMAT_R16G16B16A16_SINT },
+        { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT },
+        { VK_FORMAT_R64_SINT, VK_FORMAT_R64G64_SINT, VK_FORMAT_R64G64B64_SINT, VK_FORMAT_R64G64B64A64_SINT }
+    };
+    static const VkFormat uintFormats[3][4] = {
+        { VK_FORMAT_R16_UINT, VK_FORMAT_R16G16_UINT, VK_FORMAT_R16G16B16_UINT, VK_FORMAT_R16G16B16A16_UINT },
+        { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT },
+        { VK_FORMAT_R64_UINT, VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64A64_UINT }
+    };
+    uint32_t row = 0;
+    if (width == 16) row = 0;
+    else if (width == 32) row = 1;
+    else if (width == 64) row = 2;
+    else return VK_FORMAT_UNDEFINED;
+    if (scalar->opcode == SpvOpTypeFloat) return floatFormats[row][components - 1];
+    return scalar->operands[2] ? sintFormats[row][components - 1] : uintFormats[row][components - 1];
+}
+
+// 检查类型指令的操作数个数和它引用的id。反射不认识的类型（比如bool）不会被记录，可以被引用；
+// 记录下来的类型如果在定义之前就被引用过，说明类型之间可能成环，只有前向声明的指针允许这样。
+// 这样之后递归计算大小和格式时不会越界，也不会无限递归
+static bool validateType(std::vector<SpirvId>& ids, uint32_t opcode, const uint32_t* operands, uint32_t operandCount)
+{
+    const uint32_t bound = (uint32_t)ids.size();
+    const auto& result = ids[operands[0]];
+    if (result.referencedEarly && !(result.forwardPointer && opcode == SpvOpTypePointer)) return false;
+    auto reference = [&](uint32_t id) {
+        if (id >= bound || id == operands[0]) return false;
+        if (ids[id].opcode == 0) ids[id].referencedEarly = true;
+        return true;
+    };
+    switch (opcode)
+    {
+    case SpvOpTypeInt:
+        return operandCount >= 3;
+    case SpvOpTypeFloat:
+    case SpvOpTypeSampledImage:
+        return operandCount >= 2;
+    case SpvOpTypeVector:
+    case SpvOpTypeMatrix:
+        return operandCount >= 3 && reference(operands[1]);
+    case SpvOpTypeImage:
+        // 读取到sampled，也就是第7个操作数
+        return operandCount >= 7;
+    case SpvOpTypeArray:
+        // 长度可能是反射不认识的特化常量运算，只检查范围，取值时按1处理
+        return operandCount >= 3 && reference(operands[1]) && operands[2] < bound;
+    case SpvOpTypeRuntimeArray:
+        return operandCount >= 2 && reference(operands[1]);
+    case SpvOpTypeStruct:
+        for (uint32_t m = 1; m < operandCount; m++)
+        {
+            if (!reference(operands[m])) return false;
+        }
+        return true;
+    case SpvOpTypePointer:
+        return operandCount >= 3 && operands[2] < bound;
+    default:
+        return true;
+    }
+}
+
+static bool shaderStage(uint32_t executionModel, VkShaderStageFlagBits& outStage)
+{
+    static const VkShaderStageFlagBits stages[] = {
+        VK_SHADER_STAGE_VERTEX_BIT,
+        VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+        VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+        VK_SHADER_STAGE_GEOMETRY_BIT,
+        VK_SHADER_STAGE_FRAGMENT_BIT,
+        VK_SHADER_STAGE_COMPUTE_BIT
+    };
+    if (executionModel >= sizeof(stages) / sizeof(stages[0])) return false;
+    outStage = stages[executionModel];
+    return true;
+}
+
+bool LittleGFXShaderCache::Reflect(const uint32_t* code, size_t wordCount, LittleGFXShaderReflection& outReflection)
+{
+    if (wordCount < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) return false;
+    // 头部的第4个字是id的上界，所有的id都小于它
+    const uint32_t bound = code[3];
+    std::vector<SpirvId> ids(bound);
+    outReflection = LittleGFXShaderReflection();
+    bool hasEntryPoint = false;
+    uint32_t entryFunction = UINT32_MAX;
+    // 第一遍：记录每个id的定义和修饰
+    for (size_t offset = SPIRV_HEADER_WORDS; offset < wordCount;)
+    {
+        const uint32_t opcode = code[offset] & 0xFFFF;
+        const uint32_t instWords = code[offset] >> 16;
+        if (instWords == 0 || offset + instWords > wordCount) return false;
+        const uint32_t* operands = code + offset + 1;
+        const uint32_t operandCount = instWords - 1;
+        offset += instWords;
+        switch (opcode)
+        {
+        case SpvOpEntryPoint:
+            // 一个模块里有多个入口时只反射第一个
+            if (hasEntryPoint || operandCount < 3) break;
+            if (!shaderStage(operands[0], outReflection.stage)) return false;
+            outReflection.entryPoint = readString(operands + 2, operandCount - 2);
+            entryFunction = operands[1];
+            hasEntryPoint = true;
+            break;
+        case SpvOpName:
+            if (operandCount >= 2 && operands[0] < bound) ids[operands[0]].name = readString(operands + 1, operandCount - 1);
+            break;
+        case SpvOpDecorate:
+        {
+            if (operandCount < 2 || operands[0] >= bound) break;
+            auto& target = ids[operands[0]];
+            const uint32_t literal = operandCount > 2 ? operands[2] : 0;
+            switch (operands[1])
+            {
+            case SpvDecorationDescriptorSet: target.set = literal; break;
+            case SpvDecorationBinding: target.binding = literal; break;
+            case SpvDecorationLocation: target.location = literal; break;
+            case SpvDecorationArrayStride: target.arrayStride = literal; break;
+            case SpvDecorationBuiltIn: target.builtIn = true; break;
+            case SpvDecorationBufferBlock: target.bufferBlock = true; break;
+            default: break;
+            }
+            break;
+        }
+        case SpvOpMemberDecorate:
+        {
+            if (operandCount < 4 || operands[0] >= bound) break;
+            auto& target = ids[operands[0]];
+            if (operands[2] == SpvDecorationOffset) recordMember(target.memberOffsets, operands[1], operands[3]);
+            if (operands[2] == SpvDecorationMatrixStride) recordMember(target.memberMatrixStrides, operands[1], operands[3]);
+            break;
+        }
+        case SpvOpTypeInt:
+        case SpvOpTypeFloat:
+        case SpvOpTypeVector:
+        case SpvOpTypeMatrix:
+        case SpvOpTypeImage:
+        case SpvOpTypeSampler:
+        case SpvOpTypeSampledImage:
+        case SpvOpTypeArray:
+        case SpvOpTypeRuntimeArray:
+        case SpvOpTypeStruct:
+        case SpvOpTypePointer:
+        case SpvOpTypeAccelerationStructureKHR:
+            // 同一个id定义两次的模块是损坏的，放任它会让类型之间成环
+            if (operandCount < 1 || operands[0] >= bound || ids[operands[0]].opcode != 0) return false;
+            if (!validateType(ids, opcode, operands, operandCount)) return false;
+            ids[operands[0]].opcode = opcode;
+            ids[operands[0]].operands = operands;
+            ids[operands[0]].operandCount = operandCount;
+            break;
+        case SpvOpConstant:
+        case SpvOpSpecConstant:
+        case SpvOpVariable:
+            // 这几条指令的结果id是第二个操作数
+            if (operandCount < 2 || operands[0] >= bound || operands[1] >= bound || ids[operands[1]].opcode != 0) return false;
+            ids[operands[1]].opcode = opcode;
+            ids[operands[1]].operands = operands;
+            ids[operands[1]].operandCount = operandCount;
+            break;
+        case SpvOpFunction:
+            // 函数体就是紧跟在这条指令后面、直到OpFunctionEnd的那些指令
+            if (operandCount < 4 || operands[1] >= bound || ids[operands[1]].opcode != 0) return false;
+            ids[operands[1]].opcode = opcode;
+            ids[operands[1]].operands = operands;
+            ids[operands[1]].operandCount = operandCount;
+            break;
+        case SpvOpTypeForwardPointer:
+            if (operandCount < 1 || operands[0] >= bound) return false;
+            ids[operands[0]].forwardPointer = true;
+            break;
+        default:
+            break;
+        }
+    }
+    if (!hasEntryPoint || entryFunction >= bound || ids[entryFunction].opcode != SpvOpFunction) return false;
+    // 从入口函数出发遍历它调用到的所有函数，函数体里出现过的id就是这个入口静态使用的。
+    // 一个模块里有多个入口时，别的入口才用到的资源不会出现在这个入口的反射结果里。
+    // 字面量碰巧等于某个变量的id时会多反射出一个绑定，这只会让布局偏大，不会出错
+    std::vector<bool> used(bound, false);
+    std::vector<bool> visited(bound, false);
+    std::vector<uint32_t> functionStack(1, entryFunction);
+    visited[entryFunction] = true;
+    const uint32_t* codeEnd = code + wordCount;
+    while (!functionStack.empty())
+    {
+        const auto& function = ids[functionStack.back()];
+        functionStack.pop_back();
+        // 第一遍已经检查过每条指令的长度，这里不会越界
+        for (const uint32_t* inst = function.operands + function.operandCount; inst < codeEnd; inst += inst[0] >> 16)
+        {
+            const uint32_t opcode = inst[0] & 0xFFFF;
+            if (opcode == SpvOpFunctionEnd) break;
+            const uint32_t operandCount = (inst[0] >> 16) - 1;
+            for (uint32_t i = 1; i <= operandCount; i++)
+            {
+                if (inst[i] < bound) used[inst[i]] = true;
+            }
+            if (opcode != SpvOpFunctionCall || operandCount < 3) continue;
+            const uint32_t callee = inst[3];
+            if (callee < bound && !visited[callee] && ids[callee].opcode == SpvOpFunction)
+            {
+                visited[callee] = true;
+                functionStack.emplace_back(callee);
+            }
+        }
+    }
+    // 第二遍：遍历入口静态使用的全局变量，按存储类别归类
+    uint32_t pushBegin = UINT32_MAX;
+    uint32_t pushEnd = 0;
+    for (uint32_t id = 0; id < bound; id++)
+    {
+        const auto& var = ids[id];
+        if (var.opcode != SpvOpVariable || var.operandCount < 3 || !used[id]) continue;
+        const auto& pointer = ids[var.operands[0]];
+        if (pointer.opcode != SpvOpTypePointer) continue;
+        const uint32_t storageClass = var.operands[2];
+        uint32_t typeId = pointer.operands[2];
+        if (storageClass == SpvStorageClassPushConstant)
+        {
+            const auto& block = ids[typeId];
+            for (uint32_t m = 0; m < block.memberOffsets.size(); m++)
+            {
+                pushBegin = std::min(pushBegin, block.memberOffsets[m]);
+            }
+            pushEnd = std::max(pushEnd, typeSize(ids, typeId, 0));
+            continue;
+        }
+        if (storageClass == SpvStorageClassInput)
+        {
+            if (outReflection.stage != VK_SHADER_STAGE_VERTEX_BIT || var.builtIn || var.location == UINT32_MAX) continue;
+            LittleGFXVertexInput input;
+            input.location = var.location;
+            input.format = vertexFormat(ids, typeId);
+            input.name = var.name;
+            outReflection.vertexInputs.emplace_back(input);
+            continue;
+        }
+        if (var.binding == UINT32_MAX) continue;
+        LittleGFXDescriptorBinding binding;
+        binding.set = var.set == UINT32_MAX ? 0 : var.set;
+        binding.binding = var.binding;
+        binding.stages = outReflection.stage;
+        binding.name = var.name;
+        // 剥掉数组得到元素类型，多维数组的元素个数相乘
+        while (ids[typeId].opcode == SpvOpTypeArray || ids[typeId].opcode == SpvOpTypeRuntimeArray)
+        {
+            const auto& array = ids[typeId];
+            binding.count = array.opcode == SpvOpTypeArray ? binding.count * constantValue(ids, array.operands[2]) : 0;
+            typeId = array.operands[1];
+        }
+        if (!descriptorType(ids, typeId, storageClass, binding.type)) continue;
+        outReflection.bindings.emplace_back(binding);
+    }
+    if (pushEnd > 0)
+    {
+        if (pushBegin == UINT32_MAX) pushBegin = 0;
+        outReflection.pushConstants.stageFlags = outReflection.stage;
+        outReflection.pushConstants.offset = pushBegin;
+        outReflection.pushConstants.size = pushEnd - pushBegin;
+    }
+    std::sort(outReflection.bindings.begin(), outReflection.bindings.end(),
+        [](const LittleGFXDescriptorBinding& a, const LittleGFXDescriptorBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+    std::sort(outReflection.vertexInputs.begin(), outReflection.vertexInputs.end(),
+        [](const LittleGFXVertexInput& a, const LittleGFXVertexInput& b) { return a.location < b.location; });
+    return true;
+}
+
+bool LittleGFXShaderCache::initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    return true;
+}
+
+void LittleGFXShaderCache::destroy()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto& table = gfxDevice->volkTable;
+    for (auto& iter : pipelineLayouts)
+    {
+        table.vkDestroyPipelineLayout(gfxDevice->vkDevice, iter.second->layout, nullptr);
+    }
+    pipelineLayouts.clear();
+    for (auto& iter : setLayouts)
+    {
+        table.vkDestroyDescriptorSetLayout(gfxDevice->vkDevice, iter.second.layout, nullptr);
+    }
+    setLayouts.clear();
+    externalSetLayouts.clear();
+    for (auto& iter : shaders)
+    {
+        table.vkDestroyShaderModule(gfxDevice->vkDevice, iter.second->module, nullptr);
+    }
+    shaders.clear();
+}
+
+const LittleGFXShader* LittleGFXShaderCache::findShaderLocked(uint64_t hash, const uint32_t* code, size_t codeSize)
+{
+    auto range = shaders.equal_range(hash);
+    for (auto iter = range.first; iter != range.second; ++iter)
+    {
+        const auto& shader = iter->second;
+        if (shader->codeSize == codeSize && memcmp(shader->code.data(), code, codeSize) == 0) return shader.get();
+    }
+    return nullptr;
+}
+
+const LittleGFXShader* LittleGFXShaderCache::LoadShader(const uint32_t* code, size_t codeSize)
+{
+    if (code == nullptr || codeSize % 4 != 0) return nullptr;
+    const uint64_t hash = hashCode((const uint8_t*)code, codeSize);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (auto existing = findShaderLocked(hash, code, codeSize)) return existing;
+    }
+    // 反射和创建模块都在锁外进行，不同的着色器可以在多个线程上同时加载
+    auto shader = std::make_unique<LittleGFXShader>();
+    shader->hash = hash;
+    shader->codeSize = codeSize;
+    shader->code.assign(code, code + codeSize / 4);
+    if (!Reflect(code, codeSize / 4, shader->reflection))
+    {
+        assert(0 && "invalid SPIR-V!");
+        return nullptr;
+    }
+    VkShaderModuleCreateInfo moduleInfo = {};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = codeSize;
+    moduleInfo.pCode = code;
+    if (gfxDevice->volkTable.vkCreateShaderModule(gfxDevice->vkDevice, &moduleInfo, nullptr, &shader->module) != VK_SUCCESS)
+    {
+        assert(0 && "create shader module failed!");
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (auto existing = findShaderLocked(hash, code, codeSize))
+    {
+        // 另一个线程先加载了同一份代码，用它的模块
+        gfxDevice->volkTable.vkDestroyShaderModule(gfxDevice->vkDevice, shader->module, nullptr);
+        return existing;
+    }
+    return shaders.emplace(hash, std::move(shader))->second.get();
+}
+
+const LittleGFXShaderCache::SetLayoutEntry* LittleGFXShaderCache::getSetLayoutLocked(
+    std::vector<VkDescriptorSetLayoutBinding> bindings, VkDescriptorSetLayoutCreateFlags flags,
+    const std::vector<uint32_t>& partiallyBound)
+{
+    std::sort(bindings.begin(), bindings.end(),
+        [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+    std::vector<VkDescriptorBindingFlags> bindingFlags(bindings.size(), 0);
+    for (size_t i = 0; i < bindings.size(); i++)
+    {
+        if (std::find(partiallyBound.begin(), partiallyBound.end(), bindings[i].binding) != partiallyBound.end())
+            bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    }
+    std::string key((const char*)&flags, sizeof(flags));
+    for (size_t i = 0; i < bindings.size(); i++)
+    {
+        const auto& binding = bindings[i];
+        const uint32_t words[5] = { binding.binding, (uint32_t)binding.descriptorType, binding.descriptorCount, binding.stageFlags,
+            bindingFlags[i] };
+        key.append((const char*)words, sizeof(words));
+        // 不可变采样器是布局的一部分，它们的句柄也要进入键
+        if (binding.pImmutableSamplers)
+            key.append((const char*)binding.pImmutableSamplers, sizeof(VkSampler) * binding.descriptorCount);
+    }
+    auto iter = setLayouts.find(key);
+    if (iter != setLayouts.end()) return &iter->second;
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.flags = flags;
+    layoutInfo.bindingCount = (uint32_t)bindings.size();
+    layoutInfo.pBindings = bindings.data();
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flagsInfo.bindingCount = (uint32_t)bindingFlags.size();
+    flagsInfo.pBindingFlags = bindingFlags.data();
+    if (!partiallyBound.empty()) layoutInfo.pNext = &flagsInfo;
+    SetLayoutEntry entry;
+    if (gfxDevice->volkTable.vkCreateDescriptorSetLayout(gfxDevice->vkDevice, &layoutInfo, nullptr, &entry.layout) != VK_SUCCESS)
+    {
+        assert(0 && "create descriptor set layout failed!");
+        return nullptr;
+    }
+    // 调用方的采样器数组不归我们所有，缓存的绑定里不保留这个指针
+    for (auto& binding : bindings)
+    {
+        binding.pImmutableSamplers = nullptr;
+    }
+    entry.bindings = std::move(bindings);
+    return &setLayouts.emplace(std::move(key), std::move(entry)).first->second;
+}
+
+VkDescriptorSetLayout LittleGFXShaderCache::GetSetLayout(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount,
+    VkDescriptorSetLayoutCreateFlags flags)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto entry = getSetLayoutLocked(std::vector<VkDescriptorSetLayoutBinding>(bindings, bindings + bindingCount), flags);
+    return entry ? entry->layout : VK_NULL_HANDLE;
+}
+
+// push descriptor集合不能包含动态缓冲，描述符总数也有上限
+static bool canPushDescriptors(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    uint32_t descriptorCount = 0;
+    for (const auto& binding : bindings)
+    {
+        if (binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+            binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC || binding.descriptorCount == 0)
+            return false;
+        descriptorCount += binding.descriptorCount;
+    }
+    return descriptorCount <= LITTLE_GFX_MAX_PUSH_DESCRIPTORS;
+}
+
+const LittleGFXPipelineLayout* LittleGFXShaderCache::GetPipelineLayout(const LittleGFXShader* const* shaders_, uint32_t shaderCount,
+    uint32_t pushSet)
+{
+    // 把各个阶段的绑定按set合并，同一个绑定在多个阶段出现时合并stageFlags
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+    VkPushConstantRange pushConstants = {};
+    for (uint32_t i = 0; i < shaderCount; i++)
+    {
+        const auto& reflection = shaders_[i]->reflection;
+        for (const auto& binding : reflection.bindings)
+        {
+            if (binding.set >= sets.size()) sets.resize(binding.set + 1);
+            auto& setBindings = sets[binding.set];
+            auto iter = std::find_if(setBindings.begin(), setBindings.end(),
+                [&](const VkDescriptorSetLayoutBinding& b) { return b.binding == binding.binding; });
+            if (iter == setBindings.end())
+            {
+                VkDescriptorSetLayoutBinding layoutBinding = {};
+                layoutBinding.binding = binding.binding;
+                layoutBinding.descriptorType = binding.type;
+                layoutBinding.descriptorCount = binding.count;
+                layoutBinding.stageFlags = binding.stages;
+                setBindings.emplace_back(layoutBinding);
+                continue;
+            }
+            if (iter->descriptorType != binding.type)
+            {
+                assert(0 && "descriptor type mismatch between shader stages!");
+                return nullptr;
+            }
+            iter->stageFlags |= binding.stages;
+            iter->descriptorCount = std::max(iter->descriptorCount, binding.count);
+        }
+        // 所有阶段共用一个覆盖全部范围的push constant区间
+        const auto& range = reflection.pushConstants;
+        if (range.size == 0) continue;
+        if (pushConstants.size == 0)
+        {
+            pushConstants = range;
+            continue;
+        }
+        const uint32_t end = std::max(pushConstants.offset + pushConstants.size, range.offset + range.size);
+        pushConstants.offset = std::min(pushConstants.offset, range.offset);
+        pushConstants.size = end - pushConstants.offset;
+        pushConstants.stageFlags |= range.stageFlags;
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    // 外部指定的集合即使编号比这组着色器用到的都大，也要出现在布局里
+    for (const auto& external : externalSetLayouts)
+    {
+        if (external.first >= sets.size()) sets.resize(external.first + 1);
+    }
+    auto layout = std::make_unique<LittleGFXPipelineLayout>();
+    layout->pushConstants = pushConstants;
+    for (uint32_t set = 0; set < (uint32_t)sets.size(); set++)
+    {
+        // 外部指定的集合即使这组着色器没有用到也放进布局，这样它在所有管线之间保持兼容
+        auto external = externalSetLayouts.find(set);
+        if (external != externalSetLayouts.end())
+        {
+            // 着色器在这个集合里的绑定会被外部布局整个替换掉，所以它们必须都能在外部布局里找到
+            const auto& externalBindings = external->second.bindings;
+            for (const auto& binding : sets[set])
+            {
+                auto match = std::find_if(externalBindings.begin(), externalBindings.end(),
+                    [&](const VkDescriptorSetLayoutBinding& b) { return b.binding == binding.binding; });
+                if (match == externalBindings.end() || match->descriptorType != binding.descriptorType ||
+                    match->descriptorCount < binding.descriptorCount)
+                {
+                    assert(0 && "shader binding does not match the external set layout!");
+                    return nullptr;
+                }
+            }
+            layout->setLayouts.emplace_back(external->second.layout);
+            layout->setBindings.emplace_back(external->second.bindings);
+            continue;
+        }
+        VkDescriptorSetLayoutCreateFlags flags = 0;
+        if (set == pushSet && gfxDevice->pushDescriptorEnabled && canPushDescriptors(sets[set]))
+        {
+            flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+            layout->pushSet = set;
+        }
+        // 不定长数组在布局里的元素个数不能为0（那样的绑定不可使用），按调用者给的上限创建
+        std::vector<uint32_t> partiallyBound;
+        for (auto& binding : sets[set])
+        {
+            if (binding.descriptorCount != 0) continue;
+            if (runtimeArrayLimit == 0 || !gfxDevice->descriptorIndexingEnabled)
+            {
+                assert(0 && "runtime descriptor arrays need descriptor indexing and SetRuntimeArrayLimit!");
+                return nullptr;
+            }
+            binding.descriptorCount = runtimeArrayLimit;
+            partiallyBound.emplace_back(binding.binding);
+        }
+        auto entry = getSetLayoutLocked(std::move(sets[set]), flags, partiallyBound);
+        if (!entry) return nullptr;
+        layout->setLayouts.emplace_back(entry->layout);
+        layout->setBindings.emplace_back(entry->bindings);
+    }
+    // 集合布局已经去过重，用它们的句柄加上push constant区间作为管线布局的键
+    std::string key((const char*)layout->setLayouts.data(), layout->setLayouts.size() * sizeof(VkDescriptorSetLayout));
+    key.append((const char*)&pushConstants, sizeof(pushConstants));
+    auto iter = pipelineLayouts.find(key);
+    if (iter != pipelineLayouts.end()) return iter->second.get();
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = (uint32_t)layout->setLayouts.size();
+    layoutInfo.pSetLayouts = layout->setLayouts.data();
+    layoutInfo.pushConstantRangeCount = pushConstants.size ? 1 : 0;
+    layoutInfo.pPushConstantRanges = &pushConstants;
+    if (gfxDevice->volkTable.vkCreatePipelineLayout(gfxDevice->vkDevice, &layoutInfo, nullptr, &layout->layout) != VK_SUCCESS)
+    {
+        assert(0 && "create pipeline layout failed!");
+        return nullptr;
+    }
+    return pipelineLayouts.emplace(std::move(key), std::move(layout)).first->second.get();
+}
+
+void LittleGFXShaderCache::SetRuntimeArrayLimit(uint32_t count)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    runtimeArrayLimit = count;
+}
+
+void LittleGFXShaderCache::SetExternalSetLayout(uint32_t set, VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto& entry = externalSetLayouts[set];
+    entry.layout = layout;
+    entry.bindings = bindings;
+}
+
+uint32_t LittleGFXShaderCache::GetShaderCount()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return (uint32_t)shaders.size();
+}
+
+uint32_t LittleGFXShaderCache::GetPipelineLayoutCount()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return (uint32_t)pipelineLayouts.size();
+}
\ No newline at end of file
@@ -0,0 +1,526 @@
+#include "gfx/gfx_upload.h"
+#include "gfx/gfx_objects.h"
+#include <string.h>
+#include <algorithm>
+
+#define ALIGN_UP(value, alignment) (((value) + (alignment) - 1) / (alignment) * (alignment))
+
+bool LittleGFXUploadManager::initialize(LittleGFXDevice* device)
+{
+    gfxDevice = device;
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = LITTLE_GFX_STAGING_RING_SIZE;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // 暂存缓冲只会被CPU顺序写入、GPU读取一次，放在普通的主机内存里即可
+    if (!device->memoryAllocator.CreateBuffer(bufferInfo,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, stagingBuffer, stagingAllocation))
+    {
+        assert(0 && "fatal: create staging ring failed!");
+        return false;
+    }
+    stagingCapacity = LITTLE_GFX_STAGING_RING_SIZE;
+    stagingHead = 0;
+    stagingTail = 0;
+    return true;
+}
+
+void LittleGFXUploadManager::destroy()
+{
+    auto& table = gfxDevice->volkTable;
+    // 还没有Flush的上传直接丢弃，已经提交的要等它们执行完才能销毁命令池和暂存缓冲
+    pendingCopies.clear();
+    gfxDevice->gfxQueue.Wait(lastGraphicsValue);
+    for (auto& submission : submissions)
+    {
+        if (submission.transferPool) table.vkDestroyCommandPool(gfxDevice->vkDevice, submission.transferPool, nullptr);
+        table.vkDestroyCommandPool(gfxDevice->vkDevice, submission.graphicsPool, nullptr);
+    }
+    submissions.clear();
+    for (auto& temporary : pendingTemporaries)
+    {
+        gfxDevice->memoryAllocator.DestroyBuffer(temporary.buffer, temporary.allocation);
+    }
+    for (auto& temporary : inflightTemporaries)
+    {
+        gfxDevice->memoryAllocator.DestroyBuffer(temporary.buffer, temporary.allocation);
+    }
+    pendingTemporaries.clear();
+    inflightTemporaries.clear();
+    graphicsBuffers.clear();
+    graphicsImages.clear();
+    gfxDevice->memoryAllocator.DestroyBuffer(stagingBuffer, stagingAllocation);
+    stagingBuffer = VK_NULL_HANDLE;
+}
+
+LittleGFXUploadTicket LittleGFXUploadManager::UploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    PendingCopy copy = {};
+    if (!stageLocked(data, size, copy.srcBuffer, copy.srcOffset))
+    {
+        assert(0 && "failed to allocate staging memory!");
+        return 0;
+    }
+    copy.dstBuffer = dst;
+    copy.dstOffset = dstOffset;
+    copy.size = size;
+    copy.onGraphics = !gfxDevice->HasDedicatedTransferQueue() || graphicsBuffers.count(dst) > 0;
+    pendingCopies.emplace_back(copy);
+    return currentTicket;
+}
+
+LittleGFXUploadTicket LittleGFXUploadManager::UploadImage(VkImage dst, const void* data, VkDeviceSize size,
+    const VkBufferImageCopy& region, VkImageLayout finalLayout)
+{
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    PendingCopy copy = {};
+    if (!stageLocked(data, size, copy.srcBuffer, copy.srcOffset))
+    {
+        assert(0 && "failed to allocate staging memory!");
+        return 0;
+    }
+    copy.dstImage = dst;
+    copy.size = size;
+    copy.region = region;
+    copy.region.bufferOffset = copy.srcOffset;
+    copy.finalLayout = finalLayout;
+    copy.onGraphics = !gfxDevice->HasDedicatedTransferQueue();
+    pendingCopies.emplace_back(copy);
+    return currentTicket;
+}
+
+bool LittleGFXUploadManager::stageLocked(const void* data, VkDeviceSize size, VkBuffer& outBuffer, VkDeviceSize& outOffset)
+{
+    if (size > stagingCapacity)
+    {
+        // 超过整个暂存环的数据单独创建一个暂存缓冲，传输完成后销毁
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        TemporaryBuffer temporary = {};
+        if (!gfxDevice->memoryAllocator.CreateBuffer(bufferInfo,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, temporary.buffer, temporary.allocation))
+        {
+            return false;
+        }
+        memcpy(temporary.allocation.mappedData, data, (size_t)size);
+        outBuffer = temporary.buffer;
+        outOffset = 0;
+        pendingTemporaries.emplace_back(temporary);
+        return true;
+    }
+    VkDeviceSize offset = 0;
+    while (!tryAllocateStaging(size, offset))
+    {
+        reclaimLocked();
+        if (tryAllocateStaging(size, offset)) break;
+        // 暂存环满了：先把积攒的上传提交出去，再等待最老的一段区域被传输队列用完
+        if (stagingPendingBytes > 0)
+        {
+            LittleGFXQueueWait wait;
+            flushLocked(wait);
+        }
+        if (!stagingRetires.empty())
+        {
+            stagingRetires.front().queue->Wait(stagingRetires.front().value);
+        }
+    }
+    memcpy((uint8_t*)stagingAllocation.mappedData + offset, data, (size_t)size);
+    outBuffer = stagingBuffer;
+    outOffset = offset;
+    return true;
+}
+
+bool LittleGFXUploadManager::tryAllocateStaging(VkDeviceSize size, VkDeviceSize& outOffset)
+{
+    // head是下一次写入的位置，tail之前（环绕意义上）的数据还可能被GPU读取
+    const bool empty = stagingRetires.empty() && stagingPendingBytes == 0;
+    if (empty)
+    {
+        stagingHead = 0;
+        stagingTail = 0;
+    }
+    VkDeviceSize offset = ALIGN_UP(stagingHead, LITTLE_GFX_STAGING_ALIGNMENT);
+    if (empty || stagingHead > stagingTail)
+    {
+        // 空闲区域是[head, capacity)和[0, tail)两段，末尾放不下时绕回开头
+        if (offset + size > stagingCapacity)
+        {
+            if (empty || size > stagingTail) return false;
+            offset = 0;
+        }
+    }
+    else if (stagingHead < stagingTail)
+    {
+        if (offset + size > stagingTail) return false;
+    }
+    else
+    {
+        // head和tail重合又不是空的，说明环已经满了
+        return false;
+    }
+    stagingHead = offset + size;
+    stagingPendingBytes += size;
+    outOffset = offset;
+    return true;
+}
+
+void LittleGFXUploadManager::reclaimLocked()
+{
+    while (!stagingRetires.empty() && stagingRetires.front().queue->IsComplete(stagingRetires.front().value))
+    {
+        stagingTail = stagingRetires.front().end;
+        stagingRetires.pop_front();
+    }
+    for (auto iter = inflightTemporaries.begin(); iter != inflightTemporaries.end();)
+    {
+        if (!iter->queue->IsComplete(iter->value))
+        {
+            ++iter;
+            continue;
+        }
+        gfxDevice->memoryAllocator.DestroyBuffer(iter->buffer, iter->allocation);
+        iter = inflightTemporaries.erase(iter);
+    }
+    // 已经完成的ticket不需要再记录，查询时找不到就当作时间线值0
+    while (!flushedTickets.empty() && gfxDevice->gfxQueue.IsComplete(flushedTickets.front().graphicsValue))
+    {
+        flushedTickets.pop_front();
+    }
+    // 图形使用已经结束的图像，之后的上传不需要再等待
+    for (auto iter = graphicsImages.begin(); iter != graphicsImages.end();)
+    {
+        if (gfxDevice->gfxQueue.IsComplete(iter->second))
+            iter = graphicsImages.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+LittleGFXUploadManager::Submission& LittleGFXUploadManager::acquireSubmission()
+{
+    auto& table = gfxDevice->volkTable;
+    for (auto& submission : submissions)
+    {
+        if (gfxDevice->gfxQueue.IsComplete(submission.graphicsValue))
+        {
+            if (submission.transferPool) table.vkResetCommandPool(gfxDevice->vkDevice, submission.transferPool, 0);
+            table.vkResetCommandPool(gfxDevice->vkDevice, submission.graphicsPool, 0);
+            return submission;
+        }
+    }
+    submissions.emplace_back();
+    auto& submission = submissions.back();
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    VkCommandBufferAllocateInfo cmdInfo = {};
+    cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdInfo.commandBufferCount = 1;
+    if (gfxDevice->HasDedicatedTransferQueue())
+    {
+        poolInfo.queueFamilyIndex = gfxDevice->transferQueue.familyIndex;
+        table.vkCreateCommandPool(gfxDevice->vkDevice, &poolInfo, nullptr, &submission.transferPool);
+        cmdInfo.commandPool = submission.transferPool;
+        table.vkAllocateCommandBuffers(gfxDevice->vkDevice, &cmdInfo, &submission.transferCommands);
+    }
+    poolInfo.queueFamilyIndex = gfxDevice->gfxQueue.familyIndex;
+    table.vkCreateCommandPool(gfxDevice->vkDevice, &poolInfo, nullptr, &submission.graphicsPool);
+    cmdInfo.commandPool = submission.graphicsPool;
+    table.vkAllocateCommandBuffers(gfxDevice->vkDevice, &cmdInfo, &submission.graphicsCommands);
+    return submission;
+}
+
+void LittleGFXUploadManager::recordBarriers(VkCommandBuffer cmd, BarrierPhase phase, bool graphicsCopies)
+{
+    bufferBarriers.clear();
+    imageBarriers.clear();
+    const bool ownershipTransfer = phase == BarrierPhase::Release || phase == BarrierPhase::Acquire;
+    const uint32_t srcFamily = ownershipTransfer ? gfxDevice->transferQueue.familyIndex : VK_QUEUE_FAMILY_IGNORED;
+    const uint32_t dstFamily = ownershipTransfer ? gfxDevice->gfxQueue.familyIndex : VK_QUEUE_FAMILY_IGNORED;
+    // 释放一侧的dstAccessMask和获取一侧的srcAccessMask会被忽略，可见性由两边的信号量和屏障共同保证
+    VkAccessFlags srcAccess = 0, dstAccess = 0;
+    VkPipelineStageFlags srcStage = 0, dstStage = 0;
+    switch (phase)
+    {
+    case BarrierPhase::PreCopy:
+        // 同一个队列上之前的读取和写入也要在覆盖之前结束
+        srcStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        srcAccess = VK_ACCESS_MEMORY_WRITE_BIT;
+        dstAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+        break;
+    case BarrierPhase::Release:
+        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        srcAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+        break;
+    case BarrierPhase::Acquire:
+        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        dstAccess = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        break;
+    case BarrierPhase::Complete:
+        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        srcAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+        dstAccess = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        break;
+    }
+    for (const auto& copy : pendingCopies)
+    {
+        if (copy.onGraphics != graphicsCopies) continue;
+        if (copy.dstImage != VK_NULL_HANDLE)
+        {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = dstAccess;
+            // 布局转换在释放和获取两侧必须写成一样的，实际只执行一次
+            barrier.oldLayout = phase == BarrierPhase::PreCopy ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = phase == BarrierPhase::PreCopy ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : copy.finalLayout;
+            barrier.srcQueueFamilyIndex = srcFamily;
+            barrier.dstQueueFamilyIndex = dstFamily;
+            barrier.image = copy.dstImage;
+            barrier.subresourceRange.aspectMask = copy.region.imageSubresource.aspectMask;
+            barrier.subresourceRange.baseMipLevel = copy.region.imageSubresource.mipLevel;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.baseArrayLayer = copy.region.imageSubresource.baseArrayLayer;
+            barrier.subresourceRange.layerCount = copy.region.imageSubresource.layerCount;
+            imageBarriers.emplace_back(barrier);
+        }
+        else
+        {
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = dstAccess;
+            barrier.srcQueueFamilyIndex = srcFamily;
+            barrier.dstQueueFamilyIndex = dstFamily;
+            barrier.buffer = copy.dstBuffer;
+            barrier.offset = copy.dstOffset;
+            barrier.size = copy.size;
+            if (ownershipTransfer)
+            {
+                // 所有权属于整个缓冲，同一个缓冲的多次上传只转移一次
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                bool duplicated = false;
+                for (const auto& existing : bufferBarriers)
+                {
+                    if (existing.buffer == copy.dstBuffer) duplicated = true;
+                }
+                if (duplicated) continue;
+            }
+            bufferBarriers.emplace_back(barrier);
+        }
+    }
+    if (bufferBarriers.empty() && imageBarriers.empty()) return;
+    gfxDevice->volkTable.vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, nullptr,
+        (uint32_t)bufferBarriers.size(), bufferBarriers.data(), (uint32_t)imageBarriers.size(), imageBarriers.data());
+}
+
+void LittleGFXUploadManager::recordCopies(VkCommandBuffer cmd, bool graphicsCopies)
+{
+    auto& table = gfxDevice->volkTable;
+    for (const auto& copy : pendingCopies)
+    {
+        if (copy.onGraphics != graphicsCopies) continue;
+        if (copy.dstImage != VK_NULL_HANDLE)
+        {
+            table.vkCmdCopyBufferToImage(cmd, copy.srcBuffer, copy.dstImage,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+        }
+        else
+        {
+            VkBufferCopy region = {};
+            region.srcOffset = copy.srcOffset;
+            region.dstOffset = copy.dstOffset;
+            region.size = copy.size;
+            table.vkCmdCopyBuffer(cmd, copy.srcBuffer, copy.dstBuffer, 1, &region);
+        }
+    }
+}
+
+void LittleGFXUploadManager::flushLocked(LittleGFXQueueWait& outWait)
+{
+    auto& table = gfxDevice->volkTable;
+    auto gfxQueue = &gfxDevice->gfxQueue;
+    auto transferQueue = &gfxDevice->transferQueue;
+    outWait.queue = gfxQueue;
+    outWait.stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    if (pendingCopies.empty())
+    {
+        outWait.value = lastGraphicsValue;
+        return;
+    }
+    bool hasTransferCopies = false;
+    bool hasGraphicsCopies = false;
+    // 传输队列只需要等待它要覆盖的图像最后一次被图形队列使用的值，新资源不等待
+    uint64_t graphicsWaitValue = 0;
+    for (const auto& copy : pendingCopies)
+    {
+        if (copy.onGraphics)
+        {
+            hasGraphicsCopies = true;
+            continue;
+        }
+        hasTransferCopies = true;
+        if (copy.dstImage == VK_NULL_HANDLE) continue;
+        auto iter = graphicsImages.find(copy.dstImage);
+        if (iter != graphicsImages.end() && !gfxQueue->IsComplete(iter->second))
+            graphicsWaitValue = std::max(graphicsWaitValue, iter->second);
+    }
+    auto& submission = acquireSubmission();
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    LittleGFXSubmitDesc submitDesc = {};
+    uint64_t transferValue = 0;
+    if (hasTransferCopies)
+    {
+        table.vkBeginCommandBuffer(submission.transferCommands, &beginInfo);
+        recordBarriers(submission.transferCommands, BarrierPhase::PreCopy, false);
+        recordCopies(submission.transferCommands, false);
+        // 传输队列上释放所有权，graphics queue上等待传输完成并获取所有权
+        recordBarriers(submission.transferCommands, BarrierPhase::Release, false);
+        table.vkEndCommandBuffer(submission.transferCommands);
+        LittleGFXQueueWait graphicsWait;
+        graphicsWait.queue = gfxQueue;
+        graphicsWait.value = graphicsWaitValue;
+        graphicsWait.stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        // 传输队列等待的值必须已经提交，否则这里之后在CPU上等待传输完成时会卡住
+        if (graphicsWaitValue > 0) gfxQueue->Flush();
+        submitDesc.commandBuffers = &submission.transferCommands;
+        submitDesc.commandBufferCount = 1;
+        submitDesc.waits = graphicsWaitValue > 0 ? &graphicsWait : nullptr;
+        submitDesc.waitCount = graphicsWaitValue > 0 ? 1 : 0;
+        transferValue = transferQueue->Enqueue(submitDesc);
+        // 传输的批次立刻提交，graphics queue上的等待就不会被卡在一个还没有提交的signal上
+        transferQueue->Flush();
+    }
+    // graphics queue上先做原地更新的拷贝，再获取传输队列交过来的资源
+    table.vkBeginCommandBuffer(submission.graphicsCommands, &beginInfo);
+    if (hasGraphicsCopies)
+    {
+        recordBarriers(submission.graphicsCommands, BarrierPhase::PreCopy, true);
+        recordCopies(submission.graphicsCommands, true);
+        recordBarriers(submission.graphicsCommands, BarrierPhase::Complete, true);
+    }
+    if (hasTransferCopies) recordBarriers(submission.graphicsCommands, BarrierPhase::Acquire, false);
+    table.vkEndCommandBuffer(submission.graphicsCommands);
+    LittleGFXQueueWait transferWait;
+    transferWait.queue = transferQueue;
+    transferWait.value = transferValue;
+    transferWait.stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    submitDesc.commandBuffers = &submission.graphicsCommands;
+    submitDesc.commandBufferCount = 1;
+    submitDesc.waits = hasTransferCopies ? &transferWait : nullptr;
+    submitDesc.waitCount = hasTransferCopies ? 1 : 0;
+    submission.graphicsValue = gfxQueue->Enqueue(submitDesc);
+    // 屏障的作用范围覆盖同一队列上之后提交的所有命令，所以渲染不需要显式等待这个值。
+    // 暂存数据在graphics queue上也被读取过时，要等graphics那次提交完成才能复用
+    LittleGFXQueue* retireQueue = hasGraphicsCopies ? gfxQueue : transferQueue;
+    const uint64_t retireValue = hasGraphicsCopies ? submission.graphicsValue : transferValue;
+    if (stagingPendingBytes > 0)
+    {
+        stagingRetires.push_back({ stagingHead, retireQueue, retireValue });
+        stagingPendingBytes = 0;
+    }
+    for (auto& temporary : pendingTemporaries)
+    {
+        temporary.queue = retireQueue;
+        temporary.value = retireValue;
+        inflightTemporaries.emplace_back(temporary);
+    }
+    // 上传完成后资源归graphics queue所有，之后的上传要排在这次获取之后
+    for (const auto& copy : pendingCopies)
+    {
+        if (copy.dstImage != VK_NULL_HANDLE)
+        {
+            auto& value = graphicsImages[copy.dstImage];
+            value = std::max(value, submission.graphicsValue);
+        }
+        else
+            graphicsBuffers.insert(copy.dstBuffer);
+    }
+    pendingTemporaries.clear();
+    pendingCopies.clear();
+    lastGraphicsValue = submission.graphicsValue;
+    flushedTickets.push_back({ currentTicket, lastGraphicsValue });
+    lastFlushedTicket = currentTicket++;
+    outWait.value = lastGraphicsValue;
+}
+
+void LittleGFXUploadManager::Flush(LittleGFXQueueWait& outWait)
+{
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    reclaimLocked();
+    flushLocked(outWait);
+}
+
+void LittleGFXUploadManager::Flush()
+{
+    LittleGFXQueueWait wait;
+    Flush(wait);
+}
+
+bool LittleGFXUploadManager::GetWait(LittleGFXUploadTicket ticket, LittleGFXQueueWait& outWait)
+{
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    if (ticket > lastFlushedTicket) return false;
+    outWait.queue = &gfxDevice->gfxQueue;
+    outWait.value = 0;
+    outWait.stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    for (const auto& flushed : flushedTickets)
+    {
+        if (flushed.ticket == ticket)
+        {
+            outWait.value = flushed.graphicsValue;
+            break;
+        }
+    }
+    return true;
+}
+
+bool LittleGFXUploadManager::IsComplete(LittleGFXUploadTicket ticket)
+{
+    LittleGFXQueueWait wait;
+    if (!GetWait(ticket, wait)) return false;
+    return wait.queue->IsComplete(wait.value);
+}
+
+void LittleGFXUploadManager::Wait(LittleGFXUploadTicket ticket)
+{
+    LittleGFXQueueWait wait;
+    if (!GetWait(ticket, wait))
+    {
+        Flush();
+        GetWait(ticket, wait);
+    }
+    wait.queue->Wait(wait.value);
+}
+
+void LittleGFXUploadManager::MarkGraphicsUse(VkBuffer buffer)
+{
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    graphicsBuffers.insert(buffer);
+}
+
+void LittleGFXUploadManager::MarkGraphicsUse(VkImage image, uint64_t graphicsValue)
+{
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    auto& value = graphicsImages[image];
+    value = std::max(value, graphicsValue);
+}
+
+void LittleGFXUploadManager::ForgetBuffer(VkBuffer buffer)
+{
+    std::lock_guard<std::mutex> lock(uploadMutex);
+    graphicsBuffers.erase(buffer);
+}
\ No newline at end of file
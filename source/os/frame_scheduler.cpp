@@ -0,0 +1,162 @@
+#include "os/frame_scheduler.h"
+#if defined(LITTLE_HEADLESS_ONLY)
+    #include <time.h>
+    #include <errno.h>
+#endif
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+    #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// 滑动平均的权重，越小越平滑
+#define STATS_SMOOTHING 0.05
+
+bool LittleFrameScheduler::Initialize(LittleFrameMode mode_, double targetFPS, bool wakeOnMessages_, bool presentBlocks)
+{
+    mode = mode_;
+    wakeOnMessages = wakeOnMessages_;
+    // 没有Present可以阻塞时垂直同步也要自己节流，否则主循环会空转
+    paced = mode == LittleFrameMode::TargetFPS || (mode == LittleFrameMode::VSync && !presentBlocks);
+    if (paced)
+    {
+        if (targetFPS <= 0.0) return false;
+        period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFPS));
+    }
+#if !defined(LITTLE_HEADLESS_ONLY)
+    if (paced)
+    {
+        // 高精度的可等待计时器（Win10 1803+）能把唤醒误差压到0.5ms以内，不需要timeBeginPeriod
+        waitableTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        highResolutionTimer = waitableTimer != nullptr;
+        if (!waitableTimer)
+        {
+            waitableTimer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+        }
+        if (!waitableTimer) return false;
+    }
+#endif
+    nextDeadline = Clock::now();
+    lastFrameBegin = nextDeadline;
+    stats = LittleFrameStats();
+    return true;
+}
+
+bool LittleFrameScheduler::Destroy()
+{
+#if !defined(LITTLE_HEADLESS_ONLY)
+    if (waitableTimer) CloseHandle(waitableTimer);
+    waitableTimer = nullptr;
+#endif
+    return true;
+}
+
+bool LittleFrameScheduler::WaitForNextFrame()
+{
+    // 不限帧和垂直同步模式下不在这里等待：
+    // 前者全速运行，后者会阻塞在Acquire/Present以及帧的Fence上
+    if (!paced) return true;
+    auto waitBegin = Clock::now();
+    bool due = sleepUntil(nextDeadline);
+    pendingWaitMs += std::chrono::duration<double, std::milli>(Clock::now() - waitBegin).count();
+    if (!due) return false;
+    // 按固定的节奏推进截止时间，这样单帧的唤醒误差不会累积
+    nextDeadline += period;
+    // 落后超过一帧时（比如窗口被拖动、断点）直接重新对齐，避免连续补帧
+    auto now = Clock::now();
+    if (nextDeadline < now) nextDeadline = now + period;
+    return true;
+}
+
+void LittleFrameScheduler::BeginFrame()
+{
+    frameBegin = Clock::now();
+    frameBeginCpuMs = threadCpuTimeMs();
+    stats.frameMs = std::chrono::duration<double, std::milli>(frameBegin - lastFrameBegin).count();
+    stats.waitMs = pendingWaitMs;
+    pendingWaitMs = 0.0;
+    lastFrameBegin = frameBegin;
+}
+
+void LittleFrameScheduler::EndFrame()
+{
+    stats.workMs = std::chrono::duration<double, std::milli>(Clock::now() - frameBegin).count();
+    stats.cpuMs = threadCpuTimeMs() - frameBeginCpuMs;
+    if (stats.frameIndex == 0)
+    {
+        stats.avgFrameMs = stats.frameMs;
+        stats.avgWorkMs = stats.workMs;
+        stats.avgCpuMs = stats.cpuMs;
+    }
+    else
+    {
+        stats.avgFrameMs += (stats.frameMs - stats.avgFrameMs) * STATS_SMOOTHING;
+        stats.avgWorkMs += (stats.workMs - stats.avgWorkMs) * STATS_SMOOTHING;
+        stats.avgCpuMs += (stats.cpuMs - stats.avgCpuMs) * STATS_SMOOTHING;
+    }
+    stats.frameIndex++;
+}
+
+bool LittleFrameScheduler::sleepUntil(Clock::time_point deadline)
+{
+    auto remaining = deadline - Clock::now();
+    if (remaining <= Clock::duration::zero()) return true;
+#if !defined(LITTLE_HEADLESS_ONLY)
+    // 普通精度的计时器会晚醒最多一个调度周期，所以提前1ms醒来再让出剩下的一点时间
+    auto slack = highResolutionTimer ? Clock::duration::zero() : std::chrono::duration_cast<Clock::duration>(std::chrono::milliseconds(1));
+    if (remaining > slack)
+    {
+        LARGE_INTEGER dueTime;
+        // 负数表示相对时间，单位是100ns
+        dueTime.QuadPart = -(LONGLONG)(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - slack).count() / 100);
+        SetWaitableTimerEx(waitableTimer, &dueTime, 0, NULL, NULL, NULL, 0);
+        DWORD result = wakeOnMessages ?
+            MsgWaitForMultipleObjectsEx(1, &waitableTimer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE) :
+            WaitForSingleObject(waitableTimer, INFINITE);
+        if (result == WAIT_OBJECT_0 + 1)
+        {
+            // 消息队列里有消息，把计时器取消掉，下一轮重新设置
+            CancelWaitableTimer(waitableTimer);
+            return false;
+        }
+    }
+    while (Clock::now() < deadline)
+    {
+        SwitchToThread();
+    }
+    return true;
+#else
+    // steady_clock在Linux上就是CLOCK_MONOTONIC，用绝对时间睡眠可以避免被信号打断后重复计算
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+    timespec target;
+    target.tv_sec = now.tv_sec + (time_t)(ns / 1000000000);
+    target.tv_nsec = now.tv_nsec + (long)(ns % 1000000000);
+    if (target.tv_nsec >= 1000000000)
+    {
+        target.tv_sec++;
+        target.tv_nsec -= 1000000000;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, nullptr) == EINTR) {}
+    return true;
+#endif
+}
+
+double LittleFrameScheduler::threadCpuTimeMs()
+{
+#if !defined(LITTLE_HEADLESS_ONLY)
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime);
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    // FILETIME的单位是100ns
+    return (double)(kernel.QuadPart + user.QuadPart) / 10000.0;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+#endif
+}
\ No newline at end of file
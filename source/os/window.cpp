@@ -4,23 +4,82 @@
 #define DEFAULT_WIDTH 600
 #define DEFAULT_HEIGHT 600
 
-bool LittleWindow::Initialize(const wchar_t* title_)
+bool LittleWindow::Initialize(const wchar_t* title_, bool headless_)
 {
     title = title_;
     width = DEFAULT_WIDTH;
     height = DEFAULT_HEIGHT;
+#if defined(LITTLE_HEADLESS_ONLY)
+    (void)headless_;
+    headless = true;
+    return true;
+#else
+    headless = headless_;
+    if (headless) return true;
     hWnd = createWin32Window(title.c_str());
     return hWnd;
+#endif
 }
 bool LittleWindow::Destroy()
 {
-    return DestroyWindow(hWnd);
+#if !defined(LITTLE_HEADLESS_ONLY)
+    if (!headless) return DestroyWindow(hWnd);
+#endif
+    return true;
 }
 
+void LittleWindow::OnResize(uint32_t newWidth, uint32_t newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+}
+
+bool LittleWindow::PumpMessages()
+{
+    if (quitRequested) return false;
+#if !defined(LITTLE_HEADLESS_ONLY)
+    if (!headless)
+    {
+        MSG msg = { 0 };
+        while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
+        {
+            // 如果收到了WM_QUIT消息，通知Run循环退出
+            if (msg.message == WM_QUIT)
+            {
+                quitRequested = true;
+                return false;
+            }
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+    }
+#endif
+    return true;
+}
+
+void LittleWindow::WaitMessages()
+{
+#if !defined(LITTLE_HEADLESS_ONLY)
+    if (!headless) WaitMessage();
+#endif
+}
+
+#if !defined(LITTLE_HEADLESS_ONLY)
 LRESULT CALLBACK WindowProcedure(HWND window, UINT msg, WPARAM wp, LPARAM lp)
 {
     switch (msg)
     {
+        case WM_NCCREATE:
+            // 把CreateWindowEx传进来的LittleWindow指针记在窗口上，之后的消息才能找到它
+            SetWindowLongPtr(window, GWLP_USERDATA, (LONG_PTR)((CREATESTRUCT*)lp)->lpCreateParams);
+            return DefWindowProc(window, msg, wp, lp);
+        case WM_SIZE:
+            if (auto self = (LittleWindow*)GetWindowLongPtr(window, GWLP_USERDATA))
+            {
+                // 最小化时这里会收到0x0的大小
+                self->OnResize(LOWORD(lp), HIWORD(lp));
+            }
+            return 0L;
         case WM_DESTROY:
             std::cout << "destroying window\n";
             PostQuitMessage(0);
@@ -47,7 +106,7 @@ HWND LittleWindow::createWin32Window(const wchar_t* title)
     {
         HWND window = CreateWindowEx(0, myclass, title,
             WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT,
-            DEFAULT_WIDTH, DEFAULT_HEIGHT, 0, 0, GetModuleHandle(0), 0);
+            DEFAULT_WIDTH, DEFAULT_HEIGHT, 0, 0, GetModuleHandle(0), this);
         if (window)
         {
             ShowWindow(window, SW_SHOWDEFAULT);
@@ -56,3 +115,4 @@ HWND LittleWindow::createWin32Window(const wchar_t* title)
     }
     return nullptr;
 }
+#endif
\ No newline at end of file